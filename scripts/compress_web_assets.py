@@ -0,0 +1,28 @@
+# Gzips the web page before it gets embedded, so the web server can send it straight out of flash,
+# and works out an ETag for it from what's in it.
+# Run by PlatformIO before the build; see extra_scripts in platformio.ini.
+
+import gzip
+import hashlib
+import os
+
+Import("env")
+
+ASSETS = [
+    # (source, define for its hash)
+    ("src/greenhouse_index.html", "GREENHOUSE_INDEX_HASH"),
+]
+
+for source, hashDefine in ASSETS:
+    sourcePath = os.path.join(env.subst("$PROJECT_DIR"), source)
+    compressedPath = sourcePath + ".gz"
+    with open(sourcePath, "rb") as f:
+        content = f.read()
+
+    if not os.path.exists(compressedPath) or os.path.getmtime(compressedPath) < os.path.getmtime(sourcePath):
+        # mtime=0 so that the same page always compresses to the same bytes.
+        with open(compressedPath, "wb") as f:
+            f.write(gzip.compress(content, compresslevel=9, mtime=0))
+        print("Compressed %s: %d -> %d bytes" % (source, len(content), os.path.getsize(compressedPath)))
+
+    env.Append(CPPDEFINES=[(hashDefine, env.StringifyMacro(hashlib.sha1(content).hexdigest()[:16]))])
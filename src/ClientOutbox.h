@@ -0,0 +1,78 @@
+#ifndef RHEOSCAPE_CLIENT_OUTBOX_H
+#define RHEOSCAPE_CLIENT_OUTBOX_H
+
+#include <cstdint>
+#include <vector>
+
+// The fields that are waiting to go out to one client, by slot (see FrameUpdate::slot).
+// Every client gets the latest value of a field, so that's kept elsewhere and shared;
+// all a client's outbox needs to know is which fields it's owed.
+//
+// If a field changes again while it's still waiting, it stays in the outbox once,
+// and the client gets the newer value when it's ready; the older one counts as superseded.
+// So a slow client gets fewer, fresher updates,
+// and its outbox can never hold more than one entry per field however far behind it falls.
+class ClientOutbox {
+  private:
+    std::vector<bool> _pending;
+    size_t _depth;
+    size_t _maxDepth;
+    uint32_t _superseded;
+    uint32_t _messagesSent;
+
+  public:
+    // Give every client's outbox the same number of slots, so that their pending() compare properly.
+    ClientOutbox(size_t slotCount = 0)
+    :
+      _pending(slotCount, false),
+      _depth(0),
+      _maxDepth(0),
+      _superseded(0),
+      _messagesSent(0)
+    { }
+
+    void push(size_t slot) {
+      if (slot >= _pending.size()) {
+        _pending.resize(slot + 1, false);
+      }
+      if (_pending[slot]) {
+        _superseded ++;
+        return;
+      }
+      _pending[slot] = true;
+      _depth ++;
+      if (_depth > _maxDepth) {
+        _maxDepth = _depth;
+      }
+    }
+
+    bool empty() const {
+      return _depth == 0;
+    }
+
+    // One flag per slot. Two outboxes with the same fields waiting have equal pending(),
+    // so the clients can be sent the same message.
+    const std::vector<bool>& pending() const {
+      return _pending;
+    }
+
+    // Call it once the pending fields have been sent.
+    void clear() {
+      if (_depth == 0) {
+        return;
+      }
+      _pending.assign(_pending.size(), false);
+      _depth = 0;
+      _messagesSent ++;
+    }
+
+    // How many fields are waiting right now.
+    size_t getDepth() const { return _depth; }
+    // The most there have ever been waiting at once.
+    size_t getMaxDepth() const { return _maxDepth; }
+    // How many values got replaced by a newer one before they could be sent.
+    uint32_t getSupersededCount() const { return _superseded; }
+    uint32_t getMessagesSent() const { return _messagesSent; }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef RHEOSCAPE_FIELD_SUBSCRIPTION_H
+#define RHEOSCAPE_FIELD_SUBSCRIPTION_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Which fields a client wants to hear about, resolved against the list of keys once,
+// when it subscribes, so that checking an update is just looking up its slot (see FrameUpdate::slot).
+// Two clients that asked for the same fields end up with equal subscriptions, however they asked for them,
+// so they can be grouped and sent the same message.
+class FieldSubscription {
+  private:
+    // One flag per slot. Empty means everything, including fields tracked after subscribing.
+    std::vector<bool> _slots;
+
+  public:
+    // What a client gets until it says otherwise.
+    FieldSubscription() { }
+
+    // The fields whose keys are in `keys` or start with one of `prefixes`.
+    // With neither, it's everything.
+    FieldSubscription(const std::vector<const char*>& allKeys, const std::vector<std::string>& keys, const std::vector<std::string>& prefixes) {
+      if (keys.empty() && prefixes.empty()) {
+        return;
+      }
+      _slots.resize(allKeys.size(), false);
+      for (size_t slot = 0; slot < allKeys.size(); slot ++) {
+        for (const std::string& key : keys) {
+          if (key == allKeys[slot]) {
+            _slots[slot] = true;
+          }
+        }
+        for (const std::string& prefix : prefixes) {
+          if (strncmp(allKeys[slot], prefix.c_str(), prefix.size()) == 0) {
+            _slots[slot] = true;
+          }
+        }
+      }
+    }
+
+    bool isEverything() const {
+      return _slots.empty();
+    }
+
+    bool wants(size_t slot) const {
+      return _slots.empty() || (slot < _slots.size() && _slots[slot]);
+    }
+
+    bool operator==(const FieldSubscription& other) const {
+      return _slots == other._slots;
+    }
+
+    bool operator<(const FieldSubscription& other) const {
+      return _slots < other._slots;
+    }
+};
+
+#endif
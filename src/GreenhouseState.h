@@ -45,6 +45,24 @@ struct GreenhouseState {
     InputToEventStream<std::optional<float>>* mat_2_temp;
     StateInput<TwoPointCalibration<float>>* mat_2_temp_calibration;
     StateInput<SetpointAndHysteresis<float>>* mat_2;
+    InputToEventStream<size_t>* free_heap;
+    InputToEventStream<size_t>* min_free_heap;
+    InputToEventStream<size_t>* largest_free_block;
+    InputToEventStream<std::optional<size_t>>* loop_task_stack_free;
+    InputToEventStream<std::optional<size_t>>* web_server_task_stack_free;
+    InputToEventStream<unsigned long>* loop_duration_p50;
+    InputToEventStream<unsigned long>* loop_duration_p99;
+    InputToEventStream<unsigned long>* loop_duration_max;
+    InputToEventStream<unsigned long>* loop_jitter_p50;
+    InputToEventStream<unsigned long>* loop_jitter_p99;
+    InputToEventStream<unsigned long>* loop_jitter_max;
+    InputToEventStream<unsigned long>* loop_interval_max;
+    InputToEventStream<uint32_t>* event_queue_high_water_mark;
+    InputToEventStream<uint32_t>* event_queue_dropped;
+    InputToEventStream<uint32_t>* alarm_messages_dropped;
+    InputToEventStream<uint32_t>* state_updates_per_minute;
+    InputToEventStream<uint32_t>* websocket_frames_per_minute;
+    InputToEventStream<uint32_t>* websocket_bytes_per_minute;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef RHEOSCAPE_HISTOGRAM_H
+#define RHEOSCAPE_HISTOGRAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// A fixed-size histogram for durations and other unsigned values that span many orders of magnitude.
+// Each power of two is split into four buckets, so any percentile it reports
+// is at most 25% higher than the true value, and it never allocates after construction.
+// Values from 0 to 3 get a bucket each.
+class LogBucketHistogram {
+  private:
+    static constexpr uint8_t _subBucketBits = 2;
+    static constexpr uint32_t _subBuckets = 1 << _subBucketBits;
+    static constexpr size_t _bucketCount = (32 - _subBucketBits + 1) * _subBuckets;
+
+    std::array<uint32_t, _bucketCount> _counts;
+    uint32_t _count;
+    uint32_t _min;
+    uint32_t _max;
+    uint64_t _sum;
+
+    static size_t _bucketIndex(uint32_t value) {
+      if (value < _subBuckets) {
+        return value;
+      }
+      uint8_t highestBit = 31 - __builtin_clz(value);
+      uint8_t shift = highestBit - _subBucketBits;
+      // The value's top three bits, i.e., which quarter of its power of two it falls into.
+      return (shift + 1) * _subBuckets + ((value >> shift) - _subBuckets);
+    }
+
+    // The biggest value that would land in this bucket.
+    static uint32_t _bucketUpperBound(size_t index) {
+      if (index < _subBuckets) {
+        return index;
+      }
+      uint8_t shift = index / _subBuckets - 1;
+      uint64_t subBucket = index % _subBuckets;
+      return (uint32_t)(((_subBuckets + subBucket + 1) << shift) - 1);
+    }
+
+  public:
+    LogBucketHistogram() {
+      reset();
+    }
+
+    void record(uint32_t value) {
+      _counts[_bucketIndex(value)] ++;
+      if (_count == 0 || value < _min) {
+        _min = value;
+      }
+      if (value > _max) {
+        _max = value;
+      }
+      _count ++;
+      _sum += value;
+    }
+
+    void reset() {
+      _counts.fill(0);
+      _count = 0;
+      _min = 0;
+      _max = 0;
+      _sum = 0;
+    }
+
+    // The value that `fraction` of all recorded values are at or below, e.g., 0.99 for the p99.
+    // Returns 0 if nothing's been recorded yet.
+    uint32_t percentile(float fraction) const {
+      if (_count == 0) {
+        return 0;
+      }
+      uint32_t rank = (uint32_t)(fraction * _count + 0.5f);
+      if (rank < 1) {
+        rank = 1;
+      }
+      uint32_t seen = 0;
+      for (size_t i = 0; i < _bucketCount; i ++) {
+        seen += _counts[i];
+        if (seen >= rank) {
+          // The bucket's upper bound can overshoot the real max; the max is exact, so use it instead.
+          uint32_t upperBound = _bucketUpperBound(i);
+          return upperBound < _max ? upperBound : _max;
+        }
+      }
+      return _max;
+    }
+
+    uint32_t count() const { return _count; }
+    uint32_t min() const { return _min; }
+    uint32_t max() const { return _max; }
+    uint32_t mean() const { return _count ? (uint32_t)(_sum / _count) : 0; }
+};
+
+#endif
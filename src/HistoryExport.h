@@ -0,0 +1,252 @@
+#ifndef RHEOSCAPE_HISTORY_EXPORT_H
+#define RHEOSCAPE_HISTORY_EXPORT_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <SampleHistory.h>
+
+enum class HistoryFormat {
+  // A header line of keys, then one line of values per row; missing values are left empty.
+  csv,
+  // One JSON object per row, with missing values as null.
+  ndjson
+};
+
+// Turns a SampleHistory into CSV or NDJSON a bit at a time, for a chunked HTTP response.
+// It only ever holds one row and one line of output,
+// so it takes the same memory whether it's exporting five minutes or the whole history.
+//
+// With a step, rows get averaged into buckets that start at multiples of the step, e.g., every 15 minutes;
+// a boolean's average is the fraction of the bucket it was on for. Missing values are left out of the average.
+//
+// Times are in the history's milliseconds, i.e., the same uptime timestamps as /history.
+// Rows recorded after the export starts don't get included,
+// and rows that get overwritten before the export reaches them get skipped.
+class HistoryExport {
+  private:
+    SampleHistory* _history;
+    HistoryFormat _format;
+    std::vector<size_t> _fields;
+    unsigned long _from;
+    unsigned long _to;
+    unsigned long _step;
+
+    uint64_t _nextRow;
+    uint64_t _endRow;
+    bool _startedOutput;
+    bool _finished;
+
+    // The whole row, as it comes out of the history, then just the fields that are wanted.
+    std::vector<float> _allValues;
+    std::vector<float> _rowValues;
+    std::optional<unsigned long> _bucketStart;
+    std::vector<double> _sums;
+    std::vector<uint32_t> _counts;
+
+    std::string _line;
+    size_t _lineSent;
+
+    void _appendValue(float value) {
+      if (std::isnan(value)) {
+        if (_format == HistoryFormat::ndjson) {
+          _line += "null";
+        }
+        return;
+      }
+      char text[24];
+      int length = snprintf(text, sizeof(text), "%.7g", (double)value);
+      _line.append(text, length);
+    }
+
+    void _writeLine(unsigned long timestamp, const float* values) {
+      char text[24];
+      int length = snprintf(text, sizeof(text), "%lu", timestamp);
+      const std::vector<const char*>& keys = _history->getKeys();
+      if (_format == HistoryFormat::ndjson) {
+        _line += "{\"timestamp\":";
+        _line.append(text, length);
+        for (size_t i = 0; i < _fields.size(); i ++) {
+          _line += ",\"";
+          _line += keys[_fields[i]];
+          _line += "\":";
+          _appendValue(values[i]);
+        }
+        _line += "}\n";
+      } else {
+        _line.append(text, length);
+        for (size_t i = 0; i < _fields.size(); i ++) {
+          _line += ',';
+          _appendValue(values[i]);
+        }
+        _line += '\n';
+      }
+    }
+
+    void _writeHeader() {
+      if (_format != HistoryFormat::csv) {
+        return;
+      }
+      _line += "timestamp";
+      for (size_t field : _fields) {
+        _line += ',';
+        _line += _history->getKeys()[field];
+      }
+      _line += '\n';
+    }
+
+    // Writes out the bucket that's being averaged, if there is one.
+    bool _flushBucket() {
+      if (!_bucketStart.has_value()) {
+        return false;
+      }
+      // Reuses the row's space, since the row's already been added to the sums.
+      for (size_t i = 0; i < _fields.size(); i ++) {
+        _rowValues[i] = _counts[i] ? (float)(_sums[i] / _counts[i]) : NAN;
+        _sums[i] = 0;
+        _counts[i] = 0;
+      }
+      _writeLine(_bucketStart.value(), _rowValues.data());
+      _bucketStart.reset();
+      return true;
+    }
+
+    // Fills _line with the next line of output. Returns false when there isn't one.
+    bool _nextLine() {
+      _line.clear();
+      _lineSent = 0;
+      if (!_startedOutput) {
+        _startedOutput = true;
+        _writeHeader();
+        if (!_line.empty()) {
+          return true;
+        }
+      }
+
+      while (!_finished) {
+        if (_nextRow >= _endRow) {
+          _finished = true;
+          break;
+        }
+        unsigned long timestamp;
+        SampleHistoryRead result = _history->readRow(_nextRow, timestamp, _allValues.data());
+        if (result == SampleHistoryRead::evicted) {
+          // It got overwritten while we weren't looking; skip ahead to the oldest one that's left.
+          _nextRow = _history->getFirstRow();
+          continue;
+        }
+        if (result == SampleHistoryRead::notRecorded) {
+          _finished = true;
+          break;
+        }
+        _nextRow ++;
+        if (timestamp < _from) {
+          continue;
+        }
+        if (timestamp > _to) {
+          _finished = true;
+          break;
+        }
+        for (size_t i = 0; i < _fields.size(); i ++) {
+          _rowValues[i] = _allValues[_fields[i]];
+        }
+        if (_step == 0) {
+          _writeLine(timestamp, _rowValues.data());
+          return true;
+        }
+
+        unsigned long bucketStart = timestamp - timestamp % _step;
+        bool flushed = _bucketStart.has_value() && _bucketStart.value() != bucketStart && _flushBucket();
+        _bucketStart = bucketStart;
+        for (size_t i = 0; i < _fields.size(); i ++) {
+          if (!std::isnan(_allValues[_fields[i]])) {
+            _sums[i] += _allValues[_fields[i]];
+            _counts[i] ++;
+          }
+        }
+        if (flushed) {
+          return true;
+        }
+      }
+      return _flushBucket();
+    }
+
+  public:
+    // Fields are indexes into the history's keys; see fieldsFromList().
+    HistoryExport(SampleHistory* history, HistoryFormat format, const std::vector<size_t>& fields, unsigned long from = 0, unsigned long to = ULONG_MAX, unsigned long step = 0)
+    :
+      _history(history),
+      _format(format),
+      _fields(fields),
+      _from(from),
+      _to(to),
+      _step(step),
+      _nextRow(history->getFirstRow()),
+      _endRow(history->getEndRow()),
+      _startedOutput(false),
+      _finished(false),
+      _allValues(history->getKeys().size()),
+      _rowValues(fields.size()),
+      _sums(fields.size(), 0),
+      _counts(fields.size(), 0),
+      _lineSent(0)
+    {
+      // Enough for any line, so that writing one doesn't allocate.
+      size_t lineLength = 32;
+      for (size_t field : _fields) {
+        lineLength += strlen(history->getKeys()[field]) + 24;
+      }
+      _line.reserve(lineLength);
+    }
+
+    // Turns a comma-separated list of keys, e.g., from a query parameter, into fields.
+    // Keys that aren't being recorded get ignored. No list, or an empty one, means all of them;
+    // a list with nothing but unknown keys means none of them, so the caller can say so.
+    static std::vector<size_t> fieldsFromList(const std::vector<const char*>& keys, const char* list) {
+      std::vector<size_t> fields;
+      if (list != nullptr && *list) {
+        const char* start = list;
+        while (*start) {
+          const char* end = strchr(start, ',');
+          size_t length = end ? end - start : strlen(start);
+          for (size_t i = 0; i < keys.size(); i ++) {
+            if (strlen(keys[i]) == length && strncmp(keys[i], start, length) == 0) {
+              fields.push_back(i);
+              break;
+            }
+          }
+          start += end ? length + 1 : length;
+        }
+        return fields;
+      }
+      for (size_t i = 0; i < keys.size(); i ++) {
+        fields.push_back(i);
+      }
+      return fields;
+    }
+
+    // Fills the buffer with as much of the export as fits, and returns how much that was.
+    // 0 means it's done.
+    size_t read(uint8_t* buffer, size_t maxLength) {
+      size_t written = 0;
+      while (written < maxLength) {
+        if (_lineSent == _line.size() && !_nextLine()) {
+          break;
+        }
+        size_t length = std::min(maxLength - written, _line.size() - _lineSent);
+        memcpy(buffer + written, _line.data() + _lineSent, length);
+        written += length;
+        _lineSent += length;
+      }
+      return written;
+    }
+};
+
+#endif
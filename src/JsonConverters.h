@@ -175,6 +175,23 @@ void convertToJson(const CoverAction& value, JsonVariant dest) {
   }
 }
 
+void convertToJson(const EventStreamStats& stats, JsonVariant dest) {
+  dest["name"] = stats.name;
+  dest["emits_per_second"] = stats.emitsPerSecond();
+  dest["emit_count"] = stats.emitCount;
+  dest["subscriber_count"] = stats.subscriberCount;
+  dest["total_subscriber_micros"] = stats.totalSubscriberTime;
+  dest["max_subscriber_micros"] = stats.maxSubscriberTime;
+}
+
+void convertToJson(const OutputStaleness& staleness, JsonVariant dest) {
+  dest["name"] = staleness.name;
+  dest["switch_count"] = staleness.micros.count();
+  dest["p50_micros"] = staleness.micros.percentile(0.5f);
+  dest["p99_micros"] = staleness.micros.percentile(0.99f);
+  dest["max_micros"] = staleness.micros.max();
+}
+
 template <typename T>
 void convertToJson(const EventStream<T>& eventStream, JsonVariant dest) {
   std::optional<Event<T>> maybeEvent = eventStream.getLastEvent();
@@ -231,12 +248,30 @@ void convertToJson(GreenhouseState* const& ghState, JsonVariant dest) {
   dest["roof_vents"] = ghState->roof_vents->read();
   dest["mat_1_status"] = unwrapEventStream(ghState->mat_1_status);
   dest["mat_1_temp"] = unwrapOptionalEventStream(ghState->mat_1_temp);
-  dest["mat_1_temp_calibration"] = ghState->shelf_temp_calibration->read();
+  dest["mat_1_temp_calibration"] = ghState->mat_1_temp_calibration->read();
   dest["mat_1"] = ghState->mat_1->read();
   dest["mat_2_status"] = unwrapEventStream(ghState->mat_2_status);
   dest["mat_2_temp"] = unwrapOptionalEventStream(ghState->mat_2_temp);
-  dest["mat_2_temp_calibration"] = ghState->shelf_temp_calibration->read();
-  dest["mat_2"] = ghState->mat_1->read();
+  dest["mat_2_temp_calibration"] = ghState->mat_2_temp_calibration->read();
+  dest["mat_2"] = ghState->mat_2->read();
+  dest["free_heap"] = unwrapEventStream(ghState->free_heap);
+  dest["min_free_heap"] = unwrapEventStream(ghState->min_free_heap);
+  dest["largest_free_block"] = unwrapEventStream(ghState->largest_free_block);
+  dest["loop_task_stack_free"] = unwrapOptionalEventStream(ghState->loop_task_stack_free);
+  dest["web_server_task_stack_free"] = unwrapOptionalEventStream(ghState->web_server_task_stack_free);
+  dest["loop_duration_p50"] = unwrapEventStream(ghState->loop_duration_p50);
+  dest["loop_duration_p99"] = unwrapEventStream(ghState->loop_duration_p99);
+  dest["loop_duration_max"] = unwrapEventStream(ghState->loop_duration_max);
+  dest["loop_jitter_p50"] = unwrapEventStream(ghState->loop_jitter_p50);
+  dest["loop_jitter_p99"] = unwrapEventStream(ghState->loop_jitter_p99);
+  dest["loop_jitter_max"] = unwrapEventStream(ghState->loop_jitter_max);
+  dest["loop_interval_max"] = unwrapEventStream(ghState->loop_interval_max);
+  dest["event_queue_high_water_mark"] = unwrapEventStream(ghState->event_queue_high_water_mark);
+  dest["event_queue_dropped"] = unwrapEventStream(ghState->event_queue_dropped);
+  dest["alarm_messages_dropped"] = unwrapEventStream(ghState->alarm_messages_dropped);
+  dest["state_updates_per_minute"] = unwrapEventStream(ghState->state_updates_per_minute);
+  dest["websocket_frames_per_minute"] = unwrapEventStream(ghState->websocket_frames_per_minute);
+  dest["websocket_bytes_per_minute"] = unwrapEventStream(ghState->websocket_bytes_per_minute);
 }
 
 #endif
\ No newline at end of file
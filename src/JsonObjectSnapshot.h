@@ -0,0 +1,99 @@
+#ifndef RHEOSCAPE_JSON_OBJECT_SNAPSHOT_H
+#define RHEOSCAPE_JSON_OBJECT_SNAPSHOT_H
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A JSON object that's kept already serialised, so that handing it out is a copy rather than a serialisation.
+// Each field is kept as its own "key":value fragment, and only the fragments that changed get rewritten;
+// publish() then strings the fragments together into a new snapshot.
+//
+// Fields are addressed by slot, e.g., FrameUpdate::slot, and come out in slot order.
+// Keys go in as they are, so they mustn't need escaping.
+//
+// Snapshots are handed out as shared pointers, so one that's still being sent stays alive
+// even after a newer one has been published. Publishing reuses the last snapshot but one
+// if nobody's holding it anymore, so once things have settled down it doesn't allocate.
+class JsonObjectSnapshot {
+  private:
+    std::mutex _mutex;
+    std::vector<std::string> _fragments;
+    std::shared_ptr<std::string> _published;
+    std::shared_ptr<std::string> _spare;
+    bool _dirty;
+    uint32_t _publishCount;
+
+  public:
+    JsonObjectSnapshot()
+    :
+      _published(std::make_shared<std::string>("{}")),
+      _dirty(false),
+      _publishCount(0)
+    { }
+
+    // The value has to be serialised JSON already.
+    void set(size_t slot, const char* key, const char* valueJson, size_t valueLength) {
+      if (slot >= _fragments.size()) {
+        _fragments.resize(slot + 1);
+      }
+      std::string& fragment = _fragments[slot];
+      fragment.clear();
+      fragment += '"';
+      fragment += key;
+      fragment += "\":";
+      fragment.append(valueJson, valueLength);
+      _dirty = true;
+    }
+
+    void set(size_t slot, const char* key, const std::string& valueJson) {
+      set(slot, key, valueJson.c_str(), valueJson.size());
+    }
+
+    // Make the changes since the last publish visible to get().
+    // Call it from the same task that calls set().
+    void publish() {
+      if (!_dirty) {
+        return;
+      }
+      std::shared_ptr<std::string> next = _spare && _spare.use_count() == 1
+        ? _spare
+        : std::make_shared<std::string>();
+      next->clear();
+      *next += '{';
+      bool first = true;
+      for (const std::string& fragment : _fragments) {
+        if (fragment.empty()) {
+          continue;
+        }
+        if (!first) {
+          *next += ',';
+        }
+        *next += fragment;
+        first = false;
+      }
+      *next += '}';
+
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _spare = _published;
+        _published = next;
+      }
+      _dirty = false;
+      _publishCount ++;
+    }
+
+    // Safe to call from any task.
+    std::shared_ptr<const std::string> get() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _published;
+    }
+
+    uint32_t getPublishCount() const {
+      return _publishCount;
+    }
+};
+
+#endif
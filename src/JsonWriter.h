@@ -0,0 +1,181 @@
+#ifndef RHEOSCAPE_JSON_WRITER_H
+#define RHEOSCAPE_JSON_WRITER_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Writes JSON text in one pass, straight into a string it keeps around between messages,
+// so once it's grown to fit the biggest message it doesn't allocate anymore.
+// It takes care of the commas; you take care of calling begin/end in the right order.
+//
+//   writer.clear();
+//   writer.beginObject();
+//   writer.key("type");
+//   writer.value("stateUpdated");
+//   writer.endObject();
+//   send(writer.data(), writer.size());
+class JsonWriter {
+  private:
+    std::string _buffer;
+    // One bit per level of nesting: does the next thing at this level need a comma before it?
+    uint32_t _needsComma;
+    uint8_t _depth;
+    bool _afterKey;
+
+    void _beforeValue() {
+      if (_afterKey) {
+        _afterKey = false;
+        return;
+      }
+      if (_needsComma & (1u << _depth)) {
+        _buffer += ',';
+      }
+      _needsComma |= 1u << _depth;
+    }
+
+    void _writeEscaped(const char* value, size_t length) {
+      _buffer += '"';
+      for (size_t i = 0; i < length; i ++) {
+        char c = value[i];
+        switch (c) {
+          case '"': _buffer += "\\\""; break;
+          case '\\': _buffer += "\\\\"; break;
+          case '\n': _buffer += "\\n"; break;
+          case '\r': _buffer += "\\r"; break;
+          case '\t': _buffer += "\\t"; break;
+          default:
+            if ((unsigned char)c < 0x20) {
+              char escaped[7];
+              snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+              _buffer += escaped;
+            } else {
+              _buffer += c;
+            }
+        }
+      }
+      _buffer += '"';
+    }
+
+    void _begin(char bracket) {
+      _beforeValue();
+      _buffer += bracket;
+      _depth ++;
+      _needsComma &= ~(1u << _depth);
+    }
+
+    void _end(char bracket) {
+      _buffer += bracket;
+      _depth --;
+    }
+
+  public:
+    JsonWriter(size_t initialCapacity = 0)
+    :
+      _needsComma(0),
+      _depth(0),
+      _afterKey(false)
+    {
+      _buffer.reserve(initialCapacity);
+    }
+
+    // Start a new message, keeping the memory from the last one.
+    void clear() {
+      _buffer.clear();
+      _needsComma = 0;
+      _depth = 0;
+      _afterKey = false;
+    }
+
+    const char* data() const { return _buffer.data(); }
+    size_t size() const { return _buffer.size(); }
+    const std::string& str() const { return _buffer; }
+
+    // Nesting more than 31 deep isn't supported; nothing here gets close.
+    void beginObject() { _begin('{'); }
+    void endObject() { _end('}'); }
+    void beginArray() { _begin('['); }
+    void endArray() { _end(']'); }
+
+    void key(const char* name) {
+      _beforeValue();
+      _writeEscaped(name, strlen(name));
+      _buffer += ':';
+      _afterKey = true;
+    }
+
+    void value(std::nullptr_t) {
+      _beforeValue();
+      _buffer += "null";
+    }
+
+    void value(bool value) {
+      _beforeValue();
+      _buffer += value ? "true" : "false";
+    }
+
+    void value(long value) {
+      char digits[24];
+      snprintf(digits, sizeof(digits), "%ld", value);
+      raw(digits);
+    }
+
+    void value(unsigned long value) {
+      char digits[24];
+      snprintf(digits, sizeof(digits), "%lu", value);
+      raw(digits);
+    }
+
+    void value(int value) { this->value((long)value); }
+    void value(unsigned int value) { this->value((unsigned long)value); }
+
+    // JSON hasn't got NaN or infinity, so they come out as null, same as ArduinoJson does it.
+    void value(double value) {
+      if (!std::isfinite(value)) {
+        this->value(nullptr);
+        return;
+      }
+      char digits[32];
+      snprintf(digits, sizeof(digits), "%.9g", value);
+      raw(digits);
+    }
+
+    void value(float value) {
+      if (!std::isfinite(value)) {
+        this->value(nullptr);
+        return;
+      }
+      // Seven significant digits is all a float has; any more just prints the rounding error.
+      char digits[32];
+      snprintf(digits, sizeof(digits), "%.7g", value);
+      raw(digits);
+    }
+
+    void value(const char* value) {
+      _beforeValue();
+      _writeEscaped(value, strlen(value));
+    }
+
+    void value(const std::string& value) {
+      _beforeValue();
+      _writeEscaped(value.data(), value.size());
+    }
+
+    // A value that's already JSON, e.g., something serialised by ArduinoJson.
+    void raw(const char* json, size_t length) {
+      _beforeValue();
+      _buffer.append(json, length);
+    }
+
+    void raw(const char* json) {
+      raw(json, strlen(json));
+    }
+
+    void raw(const std::string& json) {
+      raw(json.data(), json.size());
+    }
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef RHEOSCAPE_LOOP_MONITOR_H
+#define RHEOSCAPE_LOOP_MONITOR_H
+
+#include <optional>
+
+#include <Histogram.h>
+#include <Runnable.h>
+#include <Timer.h>
+#include <input/Input.h>
+#include <event_stream/EventStream.h>
+
+// All in microseconds.
+enum class LoopStat {
+  // How long one pass through all the runnables takes.
+  tickDurationP50,
+  tickDurationP99,
+  tickDurationMax,
+  // How long between the starts of two passes.
+  // This is the longest that anything on the safety path (e.g., the alarm buzzer) can go without being run.
+  tickIntervalP50,
+  tickIntervalP99,
+  tickIntervalMax,
+  // How much the interval changes from one pass to the next.
+  tickJitterP50,
+  tickJitterP99,
+  tickJitterMax
+};
+
+struct LoopOverrun {
+  unsigned long tickDuration;
+  unsigned long budget;
+};
+
+// Times every pass through the Runner and keeps histograms of the results.
+// It's also a watchdog: give it a budget and it'll emit a LoopOverrun event
+// at the end of any tick that takes longer than that.
+// Register it as the first tick observer so that it measures the other observers too.
+class LoopMonitor : public TickObserver, public MultiInput<LoopStat, unsigned long>, public EventStream<LoopOverrun> {
+  private:
+    LogBucketHistogram _durations;
+    LogBucketHistogram _intervals;
+    LogBucketHistogram _jitters;
+    std::optional<unsigned long> _budget;
+    std::optional<unsigned long> _lastTickStart;
+    std::optional<unsigned long> _lastInterval;
+    unsigned long _tickStart;
+    uint32_t _overrunCount;
+
+  public:
+    LoopMonitor(std::optional<unsigned long> budgetMicros = std::nullopt)
+    :
+      _budget(budgetMicros),
+      _tickStart(0),
+      _overrunCount(0)
+    { }
+
+    virtual void beforeTick() {
+      _tickStart = Timekeeper::nowMicros();
+      if (_lastTickStart.has_value()) {
+        unsigned long interval = _tickStart - _lastTickStart.value();
+        _intervals.record(interval);
+        if (_lastInterval.has_value()) {
+          _jitters.record(interval > _lastInterval.value()
+            ? interval - _lastInterval.value()
+            : _lastInterval.value() - interval
+          );
+        }
+        _lastInterval = interval;
+      }
+      _lastTickStart = _tickStart;
+    }
+
+    virtual void afterTick() {
+      unsigned long duration = Timekeeper::nowMicros() - _tickStart;
+      _durations.record(duration);
+      if (_budget.has_value() && duration > _budget.value()) {
+        _overrunCount ++;
+        this->_emit(LoopOverrun { duration, _budget.value() });
+      }
+    }
+
+    void setBudget(std::optional<unsigned long> budgetMicros) {
+      _budget = budgetMicros;
+    }
+
+    virtual unsigned long readChannel(LoopStat stat) {
+      switch (stat) {
+        case LoopStat::tickDurationP50: return _durations.percentile(0.5f);
+        case LoopStat::tickDurationP99: return _durations.percentile(0.99f);
+        case LoopStat::tickDurationMax: return _durations.max();
+        case LoopStat::tickIntervalP50: return _intervals.percentile(0.5f);
+        case LoopStat::tickIntervalP99: return _intervals.percentile(0.99f);
+        case LoopStat::tickIntervalMax: return _intervals.max();
+        case LoopStat::tickJitterP50: return _jitters.percentile(0.5f);
+        case LoopStat::tickJitterP99: return _jitters.percentile(0.99f);
+        case LoopStat::tickJitterMax: return _jitters.max();
+        default: return 0;
+      }
+    }
+
+    const LogBucketHistogram& getDurations() const { return _durations; }
+    const LogBucketHistogram& getIntervals() const { return _intervals; }
+    const LogBucketHistogram& getJitters() const { return _jitters; }
+    uint32_t getOverrunCount() const { return _overrunCount; }
+
+    // Start over, e.g., once boot-time hiccups are out of the way.
+    void reset() {
+      _durations.reset();
+      _intervals.reset();
+      _jitters.reset();
+      _lastTickStart = std::nullopt;
+      _lastInterval = std::nullopt;
+      _overrunCount = 0;
+    }
+};
+
+#endif
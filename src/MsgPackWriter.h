@@ -0,0 +1,153 @@
+#ifndef RHEOSCAPE_MSGPACK_WRITER_H
+#define RHEOSCAPE_MSGPACK_WRITER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Writes MessagePack (https://msgpack.org) straight into a buffer.
+// Integers take the fewest bytes they fit in; floats are always 32 bits,
+// which is all the precision a sensor reading has anyway.
+//
+// Give it a null buffer to find out how big the message will be,
+// then do it again with a buffer that big; same as measureJson() and serializeJson().
+// If the buffer runs out, it stops writing but keeps counting, and overflowed() turns true.
+class MsgPackWriter {
+  private:
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _size;
+
+    void _put(uint8_t byte) {
+      if (_buffer != nullptr && _size < _capacity) {
+        _buffer[_size] = byte;
+      }
+      _size ++;
+    }
+
+    // MessagePack is big-endian.
+    void _putBigEndian(uint64_t value, uint8_t bytes) {
+      for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        _put((uint8_t)(value >> shift));
+      }
+    }
+
+    void _writeHeader(size_t length, uint8_t fixMarker, uint8_t fixMax, uint8_t marker8, uint8_t marker16, uint8_t marker32) {
+      if (length <= fixMax) {
+        _put(fixMarker | (uint8_t)length);
+      } else if (marker8 && length <= UINT8_MAX) {
+        _put(marker8);
+        _putBigEndian(length, 1);
+      } else if (length <= UINT16_MAX) {
+        _put(marker16);
+        _putBigEndian(length, 2);
+      } else {
+        _put(marker32);
+        _putBigEndian(length, 4);
+      }
+    }
+
+  public:
+    MsgPackWriter(uint8_t* buffer = nullptr, size_t capacity = 0)
+    :
+      _buffer(buffer),
+      _capacity(buffer == nullptr ? 0 : capacity),
+      _size(0)
+    { }
+
+    // How many bytes have been written, or would have been.
+    size_t size() const {
+      return _size;
+    }
+
+    bool overflowed() const {
+      return _buffer != nullptr && _size > _capacity;
+    }
+
+    void writeNil() {
+      _put(0xc0);
+    }
+
+    void writeBool(bool value) {
+      _put(value ? 0xc3 : 0xc2);
+    }
+
+    void writeUint(uint64_t value) {
+      if (value <= 0x7f) {
+        _put((uint8_t)value);
+      } else if (value <= UINT8_MAX) {
+        _put(0xcc);
+        _putBigEndian(value, 1);
+      } else if (value <= UINT16_MAX) {
+        _put(0xcd);
+        _putBigEndian(value, 2);
+      } else if (value <= UINT32_MAX) {
+        _put(0xce);
+        _putBigEndian(value, 4);
+      } else {
+        _put(0xcf);
+        _putBigEndian(value, 8);
+      }
+    }
+
+    void writeInt(int64_t value) {
+      if (value >= 0) {
+        writeUint((uint64_t)value);
+      } else if (value >= -32) {
+        // Negative fixint.
+        _put((uint8_t)(int8_t)value);
+      } else if (value >= INT8_MIN) {
+        _put(0xd0);
+        _putBigEndian((uint8_t)(int8_t)value, 1);
+      } else if (value >= INT16_MIN) {
+        _put(0xd1);
+        _putBigEndian((uint16_t)(int16_t)value, 2);
+      } else if (value >= INT32_MIN) {
+        _put(0xd2);
+        _putBigEndian((uint32_t)(int32_t)value, 4);
+      } else {
+        _put(0xd3);
+        _putBigEndian((uint64_t)value, 8);
+      }
+    }
+
+    void writeFloat(float value) {
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      _put(0xca);
+      _putBigEndian(bits, 4);
+    }
+
+    void writeString(const char* value, size_t length) {
+      _writeHeader(length, 0xa0, 31, 0xd9, 0xda, 0xdb);
+      for (size_t i = 0; i < length; i ++) {
+        _put((uint8_t)value[i]);
+      }
+    }
+
+    void writeString(const char* value) {
+      writeString(value, strlen(value));
+    }
+
+    void writeString(const std::string& value) {
+      writeString(value.c_str(), value.size());
+    }
+
+    // Something that's already MessagePack, e.g., a value that was encoded once and is being sent to several clients.
+    void writeRaw(const uint8_t* bytes, size_t length) {
+      for (size_t i = 0; i < length; i ++) {
+        _put(bytes[i]);
+      }
+    }
+
+    // Follow these with that many values, or that many key/value pairs.
+    void writeArrayHeader(size_t length) {
+      _writeHeader(length, 0x90, 15, 0, 0xdc, 0xdd);
+    }
+
+    void writeMapHeader(size_t length) {
+      _writeHeader(length, 0x80, 15, 0, 0xde, 0xdf);
+    }
+};
+
+#endif
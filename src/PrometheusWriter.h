@@ -0,0 +1,133 @@
+#ifndef RHEOSCAPE_PROMETHEUS_WRITER_H
+#define RHEOSCAPE_PROMETHEUS_WRITER_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+struct PrometheusLabel {
+  const char* name;
+  const char* value;
+};
+
+// Writes metrics in Prometheus's text format, e.g.:
+//
+//   # HELP greenhouse_free_heap_bytes Free heap.
+//   # TYPE greenhouse_free_heap_bytes gauge
+//   greenhouse_free_heap_bytes 143212
+//
+// straight into a sink, which is anything with a write(const uint8_t*, size_t), like an AsyncResponseStream.
+// Numbers get formatted on the stack, so nothing gets allocated along the way
+// apart from whatever the sink does with what it's given.
+template <typename TSink>
+class PrometheusWriter {
+  private:
+    TSink* _sink;
+
+    void _write(const char* text, size_t length) {
+      _sink->write((const uint8_t*)text, length);
+    }
+
+    void _write(const char* text) {
+      _write(text, strlen(text));
+    }
+
+    // Backslashes, quotes and newlines are the only things that need escaping in a label value.
+    void _writeLabelValue(const char* value) {
+      const char* run = value;
+      for (const char* c = value; *c; c ++) {
+        const char* escaped = *c == '\\' ? "\\\\" : *c == '"' ? "\\\"" : *c == '\n' ? "\\n" : nullptr;
+        if (escaped) {
+          _write(run, c - run);
+          _write(escaped);
+          run = c + 1;
+        }
+      }
+      _write(run);
+    }
+
+    void _writeLabels(std::initializer_list<PrometheusLabel> labels) {
+      if (labels.size() == 0) {
+        return;
+      }
+      _write("{", 1);
+      bool first = true;
+      for (const PrometheusLabel& label : labels) {
+        if (!first) {
+          _write(",", 1);
+        }
+        first = false;
+        _write(label.name);
+        _write("=\"", 2);
+        _writeLabelValue(label.value);
+        _write("\"", 1);
+      }
+      _write("}", 1);
+    }
+
+    template <typename T>
+    void _writeValue(T value) {
+      char buffer[24];
+      if constexpr (std::is_floating_point_v<T>) {
+        if (std::isnan(value)) {
+          _write("NaN", 3);
+        } else if (std::isinf(value)) {
+          _write(value > 0 ? "+Inf" : "-Inf");
+        } else {
+          int length = snprintf(buffer, sizeof(buffer), "%.9g", (double)value);
+          _write(buffer, length);
+        }
+      } else {
+        // Backwards from the end of the buffer, so there's nothing to reverse afterwards.
+        bool negative = std::is_signed_v<T> && value < 0;
+        uint64_t magnitude = negative ? 0 - (uint64_t)value : (uint64_t)value;
+        char* digit = buffer + sizeof(buffer);
+        do {
+          *-- digit = '0' + magnitude % 10;
+          magnitude /= 10;
+        } while (magnitude);
+        if (negative) {
+          *-- digit = '-';
+        }
+        _write(digit, buffer + sizeof(buffer) - digit);
+      }
+    }
+
+  public:
+    PrometheusWriter(TSink* sink)
+    : _sink(sink)
+    { }
+
+    // Call it once before a metric's samples. The type is counter, gauge, or untyped.
+    void family(const char* name, const char* type, const char* help) {
+      _write("# HELP ", 7);
+      _write(name);
+      _write(" ", 1);
+      _write(help);
+      _write("\n# TYPE ", 8);
+      _write(name);
+      _write(" ", 1);
+      _write(type);
+      _write("\n", 1);
+    }
+
+    template <typename T>
+    void sample(const char* name, std::initializer_list<PrometheusLabel> labels, T value) {
+      static_assert(std::is_arithmetic_v<T>, "Prometheus samples are numbers");
+      _write(name);
+      _writeLabels(labels);
+      _write(" ", 1);
+      _writeValue(value);
+      _write("\n", 1);
+    }
+
+    template <typename T>
+    void sample(const char* name, T value) {
+      sample(name, {}, value);
+    }
+};
+
+#endif
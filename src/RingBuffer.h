@@ -0,0 +1,73 @@
+#ifndef RHEOSCAPE_RING_BUFFER_H
+#define RHEOSCAPE_RING_BUFFER_H
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// A fixed-capacity FIFO that allocates all its slots up front and never again.
+// It doesn't overwrite when it's full; push() just says no,
+// and the caller decides what to throw away.
+template <typename T>
+class RingBuffer {
+  private:
+    std::vector<std::optional<T>> _slots;
+    // Where the oldest item lives.
+    size_t _head;
+    size_t _size;
+
+    size_t _slotIndex(size_t i) const {
+      return (_head + i) % _slots.size();
+    }
+
+  public:
+    RingBuffer(size_t capacity = 0)
+    :
+      _slots(capacity),
+      _head(0),
+      _size(0)
+    { }
+
+    size_t capacity() const { return _slots.size(); }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    bool full() const { return _size == _slots.size(); }
+
+    // Returns false, and doesn't store anything, if it's full.
+    bool push(const T& value) {
+      if (full()) {
+        return false;
+      }
+      _slots[_slotIndex(_size)].emplace(value);
+      _size ++;
+      return true;
+    }
+
+    std::optional<T> pop() {
+      if (empty()) {
+        return std::nullopt;
+      }
+      std::optional<T> value = std::move(_slots[_head]);
+      _slots[_head].reset();
+      _head = (_head + 1) % _slots.size();
+      _size --;
+      return value;
+    }
+
+    // Oldest first. Don't ask for anything past size().
+    const T& at(size_t i) const {
+      return _slots[_slotIndex(i)].value();
+    }
+
+    const T& front() const {
+      return at(0);
+    }
+
+    void clear() {
+      while (!empty()) {
+        pop();
+      }
+    }
+};
+
+#endif
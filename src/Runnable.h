@@ -12,19 +12,40 @@ class Runnable {
     virtual void run() = 0;
 };
 
+// Something that wants to know when the Runner starts and finishes a pass through its runnables.
+// Override whichever of the two you need.
+class TickObserver {
+  public:
+    virtual void beforeTick() { }
+    virtual void afterTick() { }
+};
+
 class Runner {
   private:
     inline static std::vector<Runnable*> _runnables;
+    inline static std::vector<TickObserver*> _tickObservers;
 
   public:
     static void registerRunnable(Runnable* runnable) {
       Runner::_runnables.push_back(runnable);
     }
 
+    // Observers are nested: the first one registered sees the start of the tick first
+    // and the end of the tick last, so it can measure everything the others do too.
+    static void registerTickObserver(TickObserver* observer) {
+      Runner::_tickObservers.push_back(observer);
+    }
+
     static void run() {
+      for (int i = 0; i < _tickObservers.size(); i ++) {
+        _tickObservers[i]->beforeTick();
+      }
       for (int i = 0; i < _runnables.size(); i ++) {
         _runnables[i]->run();
       }
+      for (int i = _tickObservers.size() - 1; i >= 0; i --) {
+        _tickObservers[i]->afterTick();
+      }
     }
 };
 
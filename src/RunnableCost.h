@@ -0,0 +1,62 @@
+#ifndef RHEOSCAPE_RUNNABLE_COST_H
+#define RHEOSCAPE_RUNNABLE_COST_H
+
+#include <cstdint>
+#include <memory>
+
+#include <Runnable.h>
+#include <StatsRegistry.h>
+#include <Timer.h>
+
+// How much of the loop one runnable takes up.
+// LoopMonitor says how long a whole pass takes; this says who it's spent on.
+class RunnableCost : public StatsRegistry<RunnableCost> {
+  public:
+    const char* name;
+    uint32_t runs;
+    // All in microseconds.
+    uint64_t totalMicros;
+    uint32_t maxMicros;
+
+    RunnableCost(const char* name)
+    :
+      name(name),
+      runs(0),
+      totalMicros(0),
+      maxMicros(0)
+    { }
+
+    void record(uint32_t micros) {
+      runs ++;
+      totalMicros += micros;
+      if (micros > maxMicros) {
+        maxMicros = micros;
+      }
+    }
+};
+
+// Runs another runnable and times it. Register this with the Runner instead of the runnable itself.
+class CostedRunnable : public Runnable {
+  private:
+    Runnable* _runnable;
+    std::shared_ptr<RunnableCost> _cost;
+
+  public:
+    CostedRunnable(const char* name, Runnable* runnable)
+    :
+      _runnable(runnable),
+      _cost(RunnableCost::create(name))
+    { }
+
+    virtual void run() {
+      unsigned long start = Timekeeper::nowMicros();
+      _runnable->run();
+      _cost->record(Timekeeper::nowMicros() - start);
+    }
+
+    std::shared_ptr<RunnableCost> getCost() const {
+      return _cost;
+    }
+};
+
+#endif
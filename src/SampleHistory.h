@@ -0,0 +1,155 @@
+#ifndef RHEOSCAPE_SAMPLE_HISTORY_H
+#define RHEOSCAPE_SAMPLE_HISTORY_H
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <Runnable.h>
+#include <Timer.h>
+#include <event_stream/EventStream.h>
+
+enum class SampleHistoryRead {
+  read,
+  // Replaced by a newer row; the oldest one still being held is getFirstRow().
+  evicted,
+  // Not recorded yet.
+  notRecorded
+};
+
+// A rolling record of what the sensors and outputs were doing, for pulling off the controller later
+// (see HistoryExport).
+//
+// Every sample interval, it takes the latest value of every tracked field and adds a row.
+// Values are all stored as floats: booleans and enums as numbers, and missing readings as NaN.
+// Once it's holding as many rows as it can, each new one replaces the oldest.
+// All the rows are allocated at once, when the first one gets recorded,
+// so track everything before registering it as a runnable.
+//
+// Rows get numbered as they're recorded, starting at 0, so a reader on another task can keep its place
+// and tell if the row it wanted has been overwritten in the meantime.
+class SampleHistory : public Runnable {
+  private:
+    size_t _capacity;
+    unsigned long _interval;
+    std::optional<unsigned long> _lastSampledAt;
+    std::vector<const char*> _keys;
+    std::vector<std::function<float()>> _readers;
+
+    std::mutex _rowsMutex;
+    std::vector<unsigned long> _timestamps;
+    // One row after another, each with one value per key.
+    std::vector<float> _values;
+    uint64_t _rowsRecorded;
+
+    template <typename T>
+    static float _toFloat(const T& value) {
+      if constexpr (std::is_enum_v<T>) {
+        return (float)(int)value;
+      } else {
+        return (float)value;
+      }
+    }
+
+    template <typename T>
+    static float _toFloat(const std::optional<T>& value) {
+      return value.has_value() ? _toFloat(value.value()) : NAN;
+    }
+
+  public:
+    SampleHistory(size_t capacity, unsigned long intervalMillis)
+    :
+      _capacity(capacity),
+      _interval(intervalMillis),
+      _rowsRecorded(0)
+    {
+      if (capacity == 0) {
+        throw std::invalid_argument("A sample history needs room for at least one row");
+      }
+    }
+
+    void track(const char* key, std::function<float()> read) {
+      if (!_timestamps.empty()) {
+        throw std::logic_error("Can't track another field once the history has started recording");
+      }
+      _keys.push_back(key);
+      _readers.push_back(read);
+    }
+
+    // Records the stream's latest value, or NaN if it hasn't emitted anything yet.
+    template <typename T>
+    void track(const char* key, EventStream<T>* stream) {
+      track(key, [stream]() {
+        std::optional<Event<T>> last = stream->getLastEvent();
+        return last.has_value() ? _toFloat(last.value().value) : NAN;
+      });
+    }
+
+    // Adds a row right now, whether or not it's time.
+    void record(unsigned long timestamp) {
+      std::lock_guard<std::mutex> lock(_rowsMutex);
+      if (_timestamps.empty()) {
+        _timestamps.resize(_capacity);
+        _values.resize(_capacity * _keys.size());
+      }
+      size_t slot = _rowsRecorded % _capacity;
+      _timestamps[slot] = timestamp;
+      for (size_t i = 0; i < _readers.size(); i ++) {
+        _values[slot * _keys.size() + i] = _readers[i]();
+      }
+      _rowsRecorded ++;
+    }
+
+    virtual void run() {
+      unsigned long now = Timekeeper::nowMillis();
+      if (_lastSampledAt.has_value() && now - _lastSampledAt.value() < _interval) {
+        return;
+      }
+      _lastSampledAt = now;
+      record(now);
+    }
+
+    const std::vector<const char*>& getKeys() const {
+      return _keys;
+    }
+
+    unsigned long getInterval() const {
+      return _interval;
+    }
+
+    // The number of the oldest row that's still being held.
+    uint64_t getFirstRow() {
+      std::lock_guard<std::mutex> lock(_rowsMutex);
+      return _rowsRecorded > _capacity ? _rowsRecorded - _capacity : 0;
+    }
+
+    // One past the number of the newest row.
+    uint64_t getEndRow() {
+      std::lock_guard<std::mutex> lock(_rowsMutex);
+      return _rowsRecorded;
+    }
+
+    // Copies a row out, with one value per key, if it's still being held. Safe to call from any task.
+    SampleHistoryRead readRow(uint64_t row, unsigned long& timestamp, float* values) {
+      std::lock_guard<std::mutex> lock(_rowsMutex);
+      if (row >= _rowsRecorded) {
+        return SampleHistoryRead::notRecorded;
+      }
+      if (_rowsRecorded - row > _capacity) {
+        return SampleHistoryRead::evicted;
+      }
+      size_t slot = row % _capacity;
+      timestamp = _timestamps[slot];
+      for (size_t i = 0; i < _keys.size(); i ++) {
+        values[i] = _values[slot * _keys.size() + i];
+      }
+      return SampleHistoryRead::read;
+    }
+};
+
+#endif
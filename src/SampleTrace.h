@@ -0,0 +1,83 @@
+#ifndef RHEOSCAPE_SAMPLE_TRACE_H
+#define RHEOSCAPE_SAMPLE_TRACE_H
+
+#include <optional>
+
+#include <Timer.h>
+
+// Follows sensor samples through the input graph without touching any of the processes in between.
+//
+// Open a SampleTrace on the stack, then read an input.
+// Every sensor that gets read along the way calls SampleTrace::stamp() with when its sample was taken,
+// e.g., when a DS18B20 conversion finished.
+// The trace keeps the oldest one, so afterwards getAge() tells you how stale the value you just read is,
+// no matter how many translating, merging or control processes it went through.
+//
+// Traces nest. When one closes it hands its origin to the one that was open before it.
+// Events emitted while a trace is open carry its origin along too,
+// and a trace gets reopened around their subscribers.
+//
+// All times are in microseconds, from Timekeeper::nowMicros().
+class SampleTrace {
+  private:
+    // The web server runs on a different task, so every task gets its own stack of traces.
+    inline static thread_local SampleTrace* _current = nullptr;
+
+    SampleTrace* _enclosing;
+    std::optional<unsigned long> _origin;
+
+  public:
+    SampleTrace()
+    :
+      _enclosing(_current)
+    {
+      _current = this;
+    }
+
+    // Pick up where an earlier trace left off, e.g., when handling an event that carries an origin.
+    SampleTrace(std::optional<unsigned long> origin)
+    : SampleTrace()
+    {
+      _origin = origin;
+    }
+
+    ~SampleTrace() {
+      _current = _enclosing;
+      if (_origin.has_value()) {
+        stamp(_origin.value());
+      }
+    }
+
+    SampleTrace(const SampleTrace&) = delete;
+    SampleTrace& operator=(const SampleTrace&) = delete;
+
+    std::optional<unsigned long> getOrigin() const {
+      return _origin;
+    }
+
+    // How long ago the oldest sample behind this trace was taken.
+    std::optional<unsigned long> getAge() const {
+      if (!_origin.has_value()) {
+        return std::nullopt;
+      }
+      return Timekeeper::nowMicros() - _origin.value();
+    }
+
+    // Sensors call this every time they're read, even if they're handing out a cached sample.
+    // Does nothing if no trace is open.
+    static void stamp(unsigned long origin) {
+      if (_current == nullptr) {
+        return;
+      }
+      // Compare by difference, so that it still works when micros() rolls over.
+      if (!_current->_origin.has_value() || (long)(origin - _current->_origin.value()) < 0) {
+        _current->_origin = origin;
+      }
+    }
+
+    static std::optional<unsigned long> currentOrigin() {
+      return _current == nullptr ? std::nullopt : _current->_origin;
+    }
+};
+
+#endif
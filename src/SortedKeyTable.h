@@ -0,0 +1,75 @@
+#ifndef RHEOSCAPE_SORTED_KEY_TABLE_H
+#define RHEOSCAPE_SORTED_KEY_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+
+template <typename TValue>
+struct KeyedRow {
+  std::string_view key;
+  TValue value;
+};
+
+// A fixed set of string keys, each with a value (e.g., a function pointer),
+// sorted when the program's compiled so that looking one up is a binary search with no allocation.
+// Build it with makeSortedKeyTable() in a constexpr; the rows can go in whatever order reads best.
+template <typename TValue, size_t N>
+class SortedKeyTable {
+  private:
+    std::array<KeyedRow<TValue>, N> _rows;
+
+  public:
+    constexpr SortedKeyTable(std::array<KeyedRow<TValue>, N> rows)
+    : _rows(rows)
+    {
+      // An insertion sort, because std::sort isn't constexpr on every compiler this gets built with.
+      for (size_t i = 1; i < N; i ++) {
+        for (size_t j = i; j > 0 && _rows[j].key < _rows[j - 1].key; j --) {
+          KeyedRow<TValue> swap = _rows[j];
+          _rows[j] = _rows[j - 1];
+          _rows[j - 1] = swap;
+        }
+      }
+      for (size_t i = 1; i < N; i ++) {
+        if (_rows[i].key == _rows[i - 1].key) {
+          // In a constexpr, this is a compile error.
+          throw std::invalid_argument("Two rows have the same key");
+        }
+      }
+    }
+
+    // Null if the key isn't in the table.
+    constexpr const TValue* find(std::string_view key) const {
+      size_t low = 0;
+      size_t high = N;
+      while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (_rows[middle].key < key) {
+          low = middle + 1;
+        } else {
+          high = middle;
+        }
+      }
+      return low < N && _rows[low].key == key ? &_rows[low].value : nullptr;
+    }
+
+    constexpr size_t size() const {
+      return N;
+    }
+
+    constexpr const KeyedRow<TValue>* begin() const { return _rows.data(); }
+    constexpr const KeyedRow<TValue>* end() const { return _rows.data() + N; }
+};
+
+template <typename TValue, size_t N>
+constexpr SortedKeyTable<TValue, N> makeSortedKeyTable(const KeyedRow<TValue> (&rows)[N]) {
+  std::array<KeyedRow<TValue>, N> copy { };
+  for (size_t i = 0; i < N; i ++) {
+    copy[i] = rows[i];
+  }
+  return SortedKeyTable<TValue, N>(copy);
+}
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef RHEOSCAPE_STATE_PROTOCOL_H
+#define RHEOSCAPE_STATE_PROTOCOL_H
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <ArduinoJson.h>
+#include <Range.h>
+#include <SortedKeyTable.h>
+#include <StateServer.h>
+#include <event_stream/ChangeFrame.h>
+#include <GreenhouseState.h>
+#include <JsonConverters.h>
+
+// The parts of the websocket protocol that deal with the greenhouse state as JSON documents:
+// turning changes into StateServer fields, and carrying out what clients ask for.
+// There's nothing Arduino-specific in here, so it works the same behind
+// ESPAsyncWebServer (webServer.h) and behind hal/PosixWebSocketServer.h.
+
+void writeMsgPackVariant(MsgPackWriter& writer, JsonVariantConst value) {
+  if (value.isNull()) {
+    writer.writeNil();
+  } else if (value.is<bool>()) {
+    writer.writeBool(value.as<bool>());
+  } else if (value.is<long>()) {
+    writer.writeInt(value.as<long>());
+  } else if (value.is<unsigned long>()) {
+    writer.writeUint(value.as<unsigned long>());
+  } else if (value.is<float>()) {
+    writer.writeFloat(value.as<float>());
+  } else if (value.is<const char*>()) {
+    writer.writeString(value.as<const char*>());
+  } else if (value.is<JsonArrayConst>()) {
+    JsonArrayConst array = value.as<JsonArrayConst>();
+    writer.writeArrayHeader(array.size());
+    for (JsonVariantConst item : array) {
+      writeMsgPackVariant(writer, item);
+    }
+  } else if (value.is<JsonObjectConst>()) {
+    // Nested keys, like a calibration's low_reference, stay as strings.
+    JsonObjectConst object = value.as<JsonObjectConst>();
+    writer.writeMapHeader(object.size());
+    for (JsonPairConst kvp : object) {
+      writer.writeString(kvp.key().c_str());
+      writeMsgPackVariant(writer, kvp.value());
+    }
+  } else {
+    writer.writeNil();
+  }
+}
+
+void setStateServerField(StateServer* stateServer, size_t slot, JsonVariantConst value) {
+  stateServer->setField(slot, [value](std::string& json, std::string& msgPack) {
+    serializeJson(value, json);
+    MsgPackWriter measurer;
+    writeMsgPackVariant(measurer, value);
+    msgPack.resize(measurer.size());
+    MsgPackWriter writer((uint8_t*)msgPack.data(), msgPack.size());
+    writeMsgPackVariant(writer, value);
+  });
+}
+
+// Each value in the frame gets serialised once, and the text goes into every client's message and into /allState.
+// Register it as a FrameCollector consumer.
+void publishStateFrame(StateServer* stateServer, ChangeFrame<JsonDocument> frame) {
+  for (const FrameUpdate<JsonDocument>& update : frame) {
+    setStateServerField(stateServer, update.slot, update.value.as<JsonVariantConst>());
+  }
+  stateServer->publish();
+}
+
+// Fill every field in from the state as it is now; after this, it only needs changes.
+// Call it after all the fields have been tracked.
+void seedStateServer(StateServer* stateServer, const std::vector<const char*>& keys, GreenhouseState* ghState) {
+  JsonDocument allStateJson;
+  allStateJson.set(ghState);
+  for (size_t slot = 0; slot < keys.size(); slot ++) {
+    setStateServerField(stateServer, slot, allStateJson[keys[slot]].as<JsonVariantConst>());
+  }
+  stateServer->publish();
+}
+
+typedef void (*StateSetter)(GreenhouseState* ghState, JsonVariantConst value);
+
+// Sets one part of a state, like a fan's setpoint, and leaves the rest of it as it was.
+template <auto input, auto part>
+void setStatePart(GreenhouseState* ghState, JsonVariantConst value) {
+  auto current = (ghState->*input)->read();
+  current.*part = value.as<std::remove_reference_t<decltype(current.*part)>>();
+  (ghState->*input)->write(current);
+}
+
+void setTempUnit(GreenhouseState* ghState, JsonVariantConst value) {
+  const char* unit = value.as<const char*>();
+  if (unit == nullptr) {
+    return;
+  }
+  if (strcmp(unit, "celsius") == 0) {
+    ghState->temp_unit->write(TempUnit::celsius);
+  } else if (strcmp(unit, "fahrenheit") == 0) {
+    ghState->temp_unit->write(TempUnit::fahrenheit);
+  } else if (strcmp(unit, "kelvin") == 0) {
+    ghState->temp_unit->write(TempUnit::kelvin);
+  }
+}
+
+// Everything a setState message can set, and how.
+// Adding a settable field means adding a row; the table gets sorted when it's compiled.
+static constexpr auto stateSetters = makeSortedKeyTable<StateSetter>({
+  { "temp_unit", setTempUnit },
+  { "fan_control_setpoint", setStatePart<&GreenhouseState::fan, &SetpointAndHysteresis<float>::setpoint> },
+  { "fan_control_hysteresis", setStatePart<&GreenhouseState::fan, &SetpointAndHysteresis<float>::hysteresis> },
+  { "heater_control_setpoint", setStatePart<&GreenhouseState::heater, &SetpointAndHysteresis<float>::setpoint> },
+  { "heater_control_hysteresis", setStatePart<&GreenhouseState::heater, &SetpointAndHysteresis<float>::hysteresis> },
+  { "extreme_temp_alarm_control_min", setStatePart<&GreenhouseState::extreme_temp_alarm_control, &Range<float>::min> },
+  { "extreme_temp_alarm_control_max", setStatePart<&GreenhouseState::extreme_temp_alarm_control, &Range<float>::max> },
+  { "door_alarm_control_min", setStatePart<&GreenhouseState::door_alarm_control, &Range<float>::min> },
+  { "door_alarm_control_max", setStatePart<&GreenhouseState::door_alarm_control, &Range<float>::max> },
+  { "roof_vents_control_setpoint", setStatePart<&GreenhouseState::roof_vents, &SetpointAndHysteresis<float>::setpoint> },
+  { "roof_vents_control_hysteresis", setStatePart<&GreenhouseState::roof_vents, &SetpointAndHysteresis<float>::hysteresis> },
+  { "mat_1_control_setpoint", setStatePart<&GreenhouseState::mat_1, &SetpointAndHysteresis<float>::setpoint> },
+  { "mat_1_control_hysteresis", setStatePart<&GreenhouseState::mat_1, &SetpointAndHysteresis<float>::hysteresis> },
+  { "mat_2_control_setpoint", setStatePart<&GreenhouseState::mat_2, &SetpointAndHysteresis<float>::setpoint> },
+  { "mat_2_control_hysteresis", setStatePart<&GreenhouseState::mat_2, &SetpointAndHysteresis<float>::hysteresis> },
+  { "shelf_temp_calibration_low_reference", setStatePart<&GreenhouseState::shelf_temp_calibration, &TwoPointCalibration<float>::lowReference> },
+  { "shelf_temp_calibration_low_raw", setStatePart<&GreenhouseState::shelf_temp_calibration, &TwoPointCalibration<float>::lowRaw> },
+  { "shelf_temp_calibration_high_reference", setStatePart<&GreenhouseState::shelf_temp_calibration, &TwoPointCalibration<float>::highReference> },
+  { "shelf_temp_calibration_high_raw", setStatePart<&GreenhouseState::shelf_temp_calibration, &TwoPointCalibration<float>::highRaw> },
+  { "ground_temp_calibration_low_reference", setStatePart<&GreenhouseState::ground_temp_calibration, &TwoPointCalibration<float>::lowReference> },
+  { "ground_temp_calibration_low_raw", setStatePart<&GreenhouseState::ground_temp_calibration, &TwoPointCalibration<float>::lowRaw> },
+  { "ground_temp_calibration_high_reference", setStatePart<&GreenhouseState::ground_temp_calibration, &TwoPointCalibration<float>::highReference> },
+  { "ground_temp_calibration_high_raw", setStatePart<&GreenhouseState::ground_temp_calibration, &TwoPointCalibration<float>::highRaw> },
+  { "ceiling_temp_calibration_low_reference", setStatePart<&GreenhouseState::ceiling_temp_calibration, &TwoPointCalibration<float>::lowReference> },
+  { "ceiling_temp_calibration_low_raw", setStatePart<&GreenhouseState::ceiling_temp_calibration, &TwoPointCalibration<float>::lowRaw> },
+  { "ceiling_temp_calibration_high_reference", setStatePart<&GreenhouseState::ceiling_temp_calibration, &TwoPointCalibration<float>::highReference> },
+  { "ceiling_temp_calibration_high_raw", setStatePart<&GreenhouseState::ceiling_temp_calibration, &TwoPointCalibration<float>::highRaw> },
+  { "yuzu_temp_calibration_low_reference", setStatePart<&GreenhouseState::yuzu_temp_calibration, &TwoPointCalibration<float>::lowReference> },
+  { "yuzu_temp_calibration_low_raw", setStatePart<&GreenhouseState::yuzu_temp_calibration, &TwoPointCalibration<float>::lowRaw> },
+  { "yuzu_temp_calibration_high_reference", setStatePart<&GreenhouseState::yuzu_temp_calibration, &TwoPointCalibration<float>::highReference> },
+  { "yuzu_temp_calibration_high_raw", setStatePart<&GreenhouseState::yuzu_temp_calibration, &TwoPointCalibration<float>::highRaw> },
+  { "fish_tank_temp_calibration_low_reference", setStatePart<&GreenhouseState::fish_tank_temp_calibration, &TwoPointCalibration<float>::lowReference> },
+  { "fish_tank_temp_calibration_low_raw", setStatePart<&GreenhouseState::fish_tank_temp_calibration, &TwoPointCalibration<float>::lowRaw> },
+  { "fish_tank_temp_calibration_high_reference", setStatePart<&GreenhouseState::fish_tank_temp_calibration, &TwoPointCalibration<float>::highReference> },
+  { "fish_tank_temp_calibration_high_raw", setStatePart<&GreenhouseState::fish_tank_temp_calibration, &TwoPointCalibration<float>::highRaw> },
+  { "mat_1_temp_calibration_low_reference", setStatePart<&GreenhouseState::mat_1_temp_calibration, &TwoPointCalibration<float>::lowReference> },
+  { "mat_1_temp_calibration_low_raw", setStatePart<&GreenhouseState::mat_1_temp_calibration, &TwoPointCalibration<float>::lowRaw> },
+  { "mat_1_temp_calibration_high_reference", setStatePart<&GreenhouseState::mat_1_temp_calibration, &TwoPointCalibration<float>::highReference> },
+  { "mat_1_temp_calibration_high_raw", setStatePart<&GreenhouseState::mat_1_temp_calibration, &TwoPointCalibration<float>::highRaw> },
+  { "mat_2_temp_calibration_low_reference", setStatePart<&GreenhouseState::mat_2_temp_calibration, &TwoPointCalibration<float>::lowReference> },
+  { "mat_2_temp_calibration_low_raw", setStatePart<&GreenhouseState::mat_2_temp_calibration, &TwoPointCalibration<float>::lowRaw> },
+  { "mat_2_temp_calibration_high_reference", setStatePart<&GreenhouseState::mat_2_temp_calibration, &TwoPointCalibration<float>::highReference> },
+  { "mat_2_temp_calibration_high_raw", setStatePart<&GreenhouseState::mat_2_temp_calibration, &TwoPointCalibration<float>::highRaw> }
+});
+
+// A text message from a client: either
+// {"type":"setState","data":{"key":value,...}}, or
+// {"type":"subscribe","data":{"keys":[...],"prefixes":[...]}}.
+void receiveStateMessage(StateServer* stateServer, uint32_t clientId, const char* data, size_t length, GreenhouseState* ghState) {
+  JsonDocument messageJson;
+  if (deserializeJson(messageJson, data, length)) {
+    return;
+  }
+
+  const char* messageType = messageJson["type"];
+  if (messageType == nullptr) {
+    return;
+  }
+  if (strcmp(messageType, "setState") == 0) {
+    for (JsonPairConst kvp : messageJson["data"].as<JsonObjectConst>()) {
+      const StateSetter* setter = stateSetters.find(kvp.key().c_str());
+      if (setter != nullptr) {
+        (*setter)(ghState, kvp.value());
+      }
+    }
+  } else if (strcmp(messageType, "subscribe") == 0) {
+    std::vector<std::string> keys;
+    for (JsonVariantConst key : messageJson["data"]["keys"].as<JsonArrayConst>()) {
+      keys.push_back(key.as<std::string>());
+    }
+    std::vector<std::string> prefixes;
+    for (JsonVariantConst prefix : messageJson["data"]["prefixes"].as<JsonArrayConst>()) {
+      prefixes.push_back(prefix.as<std::string>());
+    }
+    stateServer->subscribe(clientId, keys, prefixes);
+  }
+}
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef RHEOSCAPE_STATE_SERVER_H
+#define RHEOSCAPE_STATE_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ClientOutbox.h>
+#include <FieldSubscription.h>
+#include <JsonObjectSnapshot.h>
+#include <JsonWriter.h>
+#include <MsgPackWriter.h>
+#include <Runnable.h>
+#include <WebSocketMessages.h>
+#include <input/Input.h>
+
+// Clients get JSON text unless they ask for MessagePack when they connect, with /ws?encoding=msgpack.
+// (It's a query parameter rather than a subprotocol because the server can't echo a subprotocol back.)
+// A MessagePack stateUpdated message is [type, {field ID: value}],
+// where the field IDs are indexes into the list the client got in its fieldIds message.
+enum class WebSocketEncoding {
+  json,
+  msgpack
+};
+
+// What the state server needs from the websocket server underneath it:
+// ESPAsyncWebServer on the ESP32 (see webServer.h), or POSIX sockets on a dev machine (see hal/PosixWebSocketServer.h).
+class WebSocketTransport {
+  public:
+    // Whether the client's still connected and has room for another message.
+    virtual bool isReady(uint32_t clientId) = 0;
+    // Send the same message to each of the clients; a backend that can share one buffer between them should.
+    // Returns how many bytes went out, counting every client's copy.
+    virtual size_t send(const std::vector<uint32_t>& clientIds, const uint8_t* message, size_t length, bool binary) = 0;
+};
+
+enum class StateServerStat {
+  clients,
+  // Every client's copy, since that's what goes over the air.
+  bytesSent,
+  messagesSent,
+  // Values that got replaced in a client's outbox before the client was ready for them.
+  superseded
+};
+
+// The websocket state protocol, without the websocket server:
+// keeps the latest value of every field, each client's encoding, subscription and outbox,
+// and the /allState snapshot, and decides who gets sent what.
+//
+// Fields are addressed by slot, and keys is the list of them by slot, e.g., FrameCollector::getKeys().
+// It can keep growing after the server's been made, but only until the first client connects.
+//
+// setField(), publish() and run() get called from one task (the loop's, on the ESP32);
+// clients connect, disconnect and subscribe from whichever task the websocket server runs on,
+// and readChannel() gets called from wherever the metrics are served.
+// So the clients and the superseded count are behind _clientsMutex,
+// the sent counters are atomic, and everything else belongs to the loop's task.
+class StateServer : public MultiInput<StateServerStat, uint32_t>, public Runnable {
+  private:
+    struct Client {
+      WebSocketEncoding encoding;
+      FieldSubscription subscription;
+      ClientOutbox outbox;
+    };
+
+    const std::vector<const char*>* _keys;
+    WebSocketTransport* _transport;
+    std::mutex _clientsMutex;
+    std::map<uint32_t, Client> _clients;
+
+    // The latest value of every field, by slot, serialised once for everybody.
+    std::vector<std::string> _latestJson;
+    std::vector<std::string> _latestMsgPack;
+    // The slots that have been set since the last publish.
+    std::vector<size_t> _changed;
+    std::vector<bool> _isChanged;
+
+    JsonObjectSnapshot _allState;
+    // Reused, so that once they've grown to fit the biggest message, writing one doesn't allocate.
+    JsonWriter _jsonWriter;
+    std::string _msgPackMessage;
+
+    // Clients connecting get sent their field IDs from the websocket server's task,
+    // and both of these get read by readChannel() from any task.
+    std::atomic<uint32_t> _bytesSent;
+    std::atomic<uint32_t> _messagesSent;
+    // Only touched with _clientsMutex held.
+    uint32_t _supersededByDisconnectedClients;
+    // Whether the last publish left any client with something in its outbox.
+    // Only touched from the loop's task, by publish() and run().
+    bool _outboxesWaiting;
+
+    void _growToFitKeys() {
+      size_t slotCount = _keys->size();
+      if (_latestJson.size() < slotCount) {
+        _latestJson.resize(slotCount);
+        _latestMsgPack.resize(slotCount);
+        _isChanged.resize(slotCount, false);
+      }
+    }
+
+    void _writeMsgPackMessage(const std::vector<bool>& slots) {
+      MsgPackWriter measurer;
+      writeStateUpdatedMsgPack(measurer, _latestMsgPack, slots);
+      _msgPackMessage.resize(measurer.size());
+      MsgPackWriter writer((uint8_t*)_msgPackMessage.data(), _msgPackMessage.size());
+      writeStateUpdatedMsgPack(writer, _latestMsgPack, slots);
+    }
+
+  public:
+    StateServer(const std::vector<const char*>* keys, WebSocketTransport* transport)
+    :
+      _keys(keys),
+      _transport(transport),
+      _jsonWriter(1024),
+      _bytesSent(0),
+      _messagesSent(0),
+      _supersededByDisconnectedClients(0),
+      _outboxesWaiting(false)
+    { }
+
+    // Overwrite a field's latest value.
+    // `serialise` gets called with the field's JSON and MessagePack strings to write the value into;
+    // both are needed, because a MessagePack client could connect before the next publish.
+    template <typename TSerialise>
+    void setField(size_t slot, TSerialise serialise) {
+      _growToFitKeys();
+      _latestJson[slot].clear();
+      _latestMsgPack[slot].clear();
+      serialise(_latestJson[slot], _latestMsgPack[slot]);
+      _allState.set(slot, (*_keys)[slot], _latestJson[slot]);
+      if (!_isChanged[slot]) {
+        _isChanged[slot] = true;
+        _changed.push_back(slot);
+      }
+    }
+
+    // Send everything that's been set since the last publish.
+    // Every changed field goes into the outbox of each client that's subscribed to it,
+    // then every client that's ready for more gets everything in its outbox.
+    // A client that isn't ready keeps its outbox for a later publish, or for run().
+    // Clients with the same encoding and the same fields waiting get the same message,
+    // so each different message only gets written once however many clients there are.
+    void publish() {
+      std::map<std::pair<WebSocketEncoding, std::vector<bool>>, std::vector<uint32_t>> audiences;
+      {
+        std::lock_guard<std::mutex> lock(_clientsMutex);
+        _outboxesWaiting = false;
+        for (auto& [id, client] : _clients) {
+          for (size_t slot : _changed) {
+            if (client.subscription.wants(slot)) {
+              client.outbox.push(slot);
+            }
+          }
+          if (client.outbox.empty()) {
+            continue;
+          }
+          if (!_transport->isReady(id)) {
+            _outboxesWaiting = true;
+            continue;
+          }
+          audiences[{ client.encoding, client.outbox.pending() }].push_back(id);
+          client.outbox.clear();
+        }
+      }
+      for (size_t slot : _changed) {
+        _isChanged[slot] = false;
+      }
+      _changed.clear();
+      _allState.publish();
+
+      for (auto const& [audience, ids] : audiences) {
+        auto const& [encoding, slots] = audience;
+        if (encoding == WebSocketEncoding::msgpack) {
+          _writeMsgPackMessage(slots);
+          _bytesSent += _transport->send(ids, (const uint8_t*)_msgPackMessage.data(), _msgPackMessage.size(), true);
+        } else {
+          writeStateUpdatedJson(_jsonWriter, *_keys, _latestJson, slots);
+          _bytesSent += _transport->send(ids, (const uint8_t*)_jsonWriter.data(), _jsonWriter.size(), false);
+        }
+        _messagesSent += ids.size();
+      }
+    }
+
+    // Publishes only happen when something changes, so once the state goes quiet,
+    // a client that was busy would never get the last values it's owed.
+    // Register this as a runnable on the same task as publish() to keep trying them until they're ready.
+    virtual void run() {
+      if (_outboxesWaiting) {
+        publish();
+      }
+    }
+
+    // MessagePack clients get told the field IDs straight away.
+    void connect(uint32_t clientId, WebSocketEncoding encoding) {
+      {
+        std::lock_guard<std::mutex> lock(_clientsMutex);
+        _clients[clientId] = Client { encoding, FieldSubscription(), ClientOutbox(_keys->size()) };
+      }
+      if (encoding == WebSocketEncoding::msgpack) {
+        JsonWriter writer;
+        writeFieldIdsJson(writer, *_keys);
+        _bytesSent += _transport->send({ clientId }, (const uint8_t*)writer.data(), writer.size(), false);
+      }
+    }
+
+    void disconnect(uint32_t clientId) {
+      std::lock_guard<std::mutex> lock(_clientsMutex);
+      auto found = _clients.find(clientId);
+      if (found != _clients.end()) {
+        _supersededByDisconnectedClients += found->second.outbox.getSupersededCount();
+        _clients.erase(found);
+      }
+    }
+
+    // See FieldSubscription; with neither keys nor prefixes, it's everything again.
+    void subscribe(uint32_t clientId, const std::vector<std::string>& keys, const std::vector<std::string>& prefixes) {
+      FieldSubscription subscription(*_keys, keys, prefixes);
+      std::lock_guard<std::mutex> lock(_clientsMutex);
+      auto found = _clients.find(clientId);
+      if (found != _clients.end()) {
+        found->second.subscription = subscription;
+      }
+    }
+
+    // What GET /allState sends. Safe to call from any task.
+    std::shared_ptr<const std::string> getAllState() {
+      return _allState.get();
+    }
+
+    // For metrics; `each` gets called with the lock held, so don't do anything slow in it.
+    template <typename TEach>
+    void forEachClient(TEach each) {
+      std::lock_guard<std::mutex> lock(_clientsMutex);
+      for (auto const& [id, client] : _clients) {
+        each(id, client.encoding, client.outbox);
+      }
+    }
+
+    virtual uint32_t readChannel(StateServerStat stat) {
+      switch (stat) {
+        case StateServerStat::clients: {
+          std::lock_guard<std::mutex> lock(_clientsMutex);
+          return _clients.size();
+        }
+        case StateServerStat::bytesSent: return _bytesSent;
+        case StateServerStat::messagesSent: return _messagesSent;
+        case StateServerStat::superseded: {
+          std::lock_guard<std::mutex> lock(_clientsMutex);
+          uint32_t superseded = _supersededByDisconnectedClients;
+          for (auto const& [id, client] : _clients) {
+            superseded += client.outbox.getSupersededCount();
+          }
+          return superseded;
+        }
+        default: return 0;
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef RHEOSCAPE_STATS_REGISTRY_H
+#define RHEOSCAPE_STATS_REGISTRY_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Keeps track of every instance of a stats class, so that something like /metrics can report them all.
+// Derive the stats class from it, passing itself in, e.g.,
+//
+//   class SensorReadStats : public StatsRegistry<SensorReadStats> { ... };
+//
+// then make them with create() rather than constructing them, so they get listed.
+template <typename T>
+class StatsRegistry {
+  private:
+    inline static std::vector<std::shared_ptr<T>> _all;
+
+  public:
+    // In the order they were created.
+    static const std::vector<std::shared_ptr<T>>& all() {
+      return _all;
+    }
+
+    template <typename... TArgs>
+    static std::shared_ptr<T> create(TArgs&&... args) {
+      auto stats = std::make_shared<T>(std::forward<TArgs>(args)...);
+      _all.push_back(stats);
+      return stats;
+    }
+};
+
+#endif
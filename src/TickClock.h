@@ -0,0 +1,102 @@
+#ifndef RHEOSCAPE_TICK_CLOCK_H
+#define RHEOSCAPE_TICK_CLOCK_H
+
+#include <vector>
+
+#include <Runnable.h>
+#include <Timer.h>
+
+// Something that wants a TickClock to wake it up at a certain time.
+class ClockListener {
+  public:
+    virtual void onClockDeadline(unsigned long now) = 0;
+};
+
+// One time source for a whole bunch of time-based processes.
+// It reads the clock once at the start of every Runner tick,
+// then wakes up every listener whose deadline has passed.
+// Listeners that aren't due cost a comparison each, not a clock read and a Timer each.
+//
+// Register it as a tick observer.
+// All times are in milliseconds, from Timekeeper::nowMillis().
+class TickClock : public TickObserver {
+  private:
+    struct _Wakeup {
+      ClockListener* listener;
+      unsigned long deadline;
+      bool pending;
+    };
+
+    std::vector<_Wakeup> _wakeups;
+    unsigned long _now;
+
+  public:
+    TickClock()
+    : _now(Timekeeper::nowMillis())
+    { }
+
+    // The time at the start of this tick.
+    unsigned long nowMillis() const {
+      return _now;
+    }
+
+    // How far into a cycle of the given period this tick is.
+    // Everything that takes its phase from the same clock lines up,
+    // e.g., two lights blinking at the same rate turn on and off together.
+    // (The phase jumps when millis() rolls over, every 49 days.)
+    unsigned long phase(unsigned long period) const {
+      return _now % period;
+    }
+
+    // When the next cycle of the given period starts.
+    unsigned long nextCycleStart(unsigned long period) const {
+      return _now - phase(period) + period;
+    }
+
+    // Catch up with the real clock outside of a tick, e.g., in tests.
+    void refresh() {
+      _now = Timekeeper::nowMillis();
+    }
+
+    // Returns a slot number to use with wakeAt().
+    size_t addListener(ClockListener* listener) {
+      _wakeups.push_back(_Wakeup { listener, 0, false });
+      return _wakeups.size() - 1;
+    }
+
+    void removeListener(size_t slot) {
+      _wakeups[slot].listener = nullptr;
+      _wakeups[slot].pending = false;
+    }
+
+    // Each slot only has one deadline; setting a new one replaces the old one.
+    // Listeners usually set their next deadline from inside onClockDeadline().
+    void wakeAt(size_t slot, unsigned long deadline) {
+      _wakeups[slot].deadline = deadline;
+      _wakeups[slot].pending = _wakeups[slot].listener != nullptr;
+    }
+
+    void cancelWakeup(size_t slot) {
+      _wakeups[slot].pending = false;
+    }
+
+    // Wake up everything that's due.
+    void fireDue() {
+      // Only the ones that were there when it started; listeners can add more.
+      size_t count = _wakeups.size();
+      for (size_t i = 0; i < count; i ++) {
+        // Compare by difference, so that it still works when millis() rolls over.
+        if (_wakeups[i].pending && (long)(_now - _wakeups[i].deadline) >= 0) {
+          _wakeups[i].pending = false;
+          _wakeups[i].listener->onClockDeadline(_now);
+        }
+      }
+    }
+
+    virtual void beforeTick() {
+      refresh();
+      fireDue();
+    }
+};
+
+#endif
@@ -1,8 +1,12 @@
 #ifndef RHEOSCAPE_TIMER_H
 #define RHEOSCAPE_TIMER_H
 
+#include <climits>
+#include <cstdint>
 #include <functional>
 #include <exception>
+#include <optional>
+#include <stdexcept>
 
 #ifdef PLATFORM_ARDUINO
 #include <Arduino.h>
@@ -22,7 +26,8 @@ enum TimekeeperSource {
 class Timekeeper {
   private:
     inline static TimekeeperSource _source = TimekeeperSource::systemTime;
-    inline static unsigned long _nowMillisSim;
+    // Sim time is kept in microseconds so that the micros clock can be simulated too.
+    inline static uint64_t _nowMicrosSim;
   
   public:
     static unsigned long nowMillis() {
@@ -36,12 +41,36 @@ class Timekeeper {
 #endif
 #endif
         case TimekeeperSource::simTime:
-          return Timekeeper::_nowMillisSim;
+          return (unsigned long)(Timekeeper::_nowMicrosSim / 1000);
         default:
           throw std::exception();
       }
     }
 
+    // For measuring things that take less than a millisecond, like a pass through the Runner.
+    // Like millis(), this rolls over (every 71 minutes on the ESP32),
+    // so only ever use it to subtract one reading from another.
+    static unsigned long nowMicros() {
+      switch (Timekeeper::_source) {
+        case TimekeeperSource::systemTime:
+#ifdef PLATFORM_ARDUINO
+          return micros();
+#else
+#ifdef PLATFORM_DEV_MACHINE
+          return (unsigned long)duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+#endif
+        case TimekeeperSource::simTime:
+          return (unsigned long)Timekeeper::_nowMicrosSim;
+        default:
+          throw std::exception();
+      }
+    }
+
+    static TimekeeperSource getSource() {
+      return Timekeeper::_source;
+    }
+
     static void setSource(TimekeeperSource source) {
       Timekeeper::_source = source;
       if (source == TimekeeperSource::simTime) {
@@ -53,14 +82,21 @@ class Timekeeper {
       if (_source != TimekeeperSource::simTime) {
         std::__throw_invalid_argument("Can't set the time; using system time");
       }
-      Timekeeper::_nowMillisSim = millis;
+      Timekeeper::_nowMicrosSim = (uint64_t)millis * 1000;
     }
 
     static void tick(unsigned long millis = 1) {
       if (_source != TimekeeperSource::simTime) {
         std::__throw_invalid_argument("Can't tick; using system time");
       }
-      Timekeeper::_nowMillisSim += millis;
+      Timekeeper::_nowMicrosSim += (uint64_t)millis * 1000;
+    }
+
+    static void tickMicros(unsigned long micros) {
+      if (_source != TimekeeperSource::simTime) {
+        std::__throw_invalid_argument("Can't tick; using system time");
+      }
+      Timekeeper::_nowMicrosSim += micros;
     }
 };
 
@@ -106,8 +142,13 @@ class Timer : public Runnable {
       bool catchUp = false
     )
     :
+      _startTime(0),
       _interval(interval),
       _callback(callback),
+      _isComplete(false),
+      // A timer that hasn't been started isn't running, and won't run until it's restarted.
+      _isCancelled(!start),
+      _passedIntervals(0),
       _times(times),
       _firstRunOnStart(firstRunOnStart),
       _catchUp(catchUp)
@@ -0,0 +1,79 @@
+#ifndef RHEOSCAPE_WEB_SOCKET_MESSAGES_H
+#define RHEOSCAPE_WEB_SOCKET_MESSAGES_H
+
+#include <string>
+#include <vector>
+
+#include <JsonWriter.h>
+#include <MsgPackWriter.h>
+
+enum WebSocketMessageType {
+  stateUpdated,
+  // Sent to binary clients when they connect, so they know which key each field ID stands for.
+  fieldIds,
+};
+
+const char* webSocketMessageTypeName(WebSocketMessageType type) {
+  switch (type) {
+    case WebSocketMessageType::stateUpdated: return "stateUpdated";
+    case WebSocketMessageType::fieldIds: return "fieldIds";
+    default: return "unknown";
+  }
+}
+
+// {"type":"stateUpdated","data":{"key":value,...}}, with the fields whose flags are set in `slots`.
+// keys and valuesJson are indexed by slot, and valuesJson has each field's latest value already serialised,
+// so that the text can be shared between clients and with anything else that wants it, like the /allState snapshot.
+void writeStateUpdatedJson(JsonWriter& writer, const std::vector<const char*>& keys, const std::vector<std::string>& valuesJson, const std::vector<bool>& slots) {
+  writer.clear();
+  writer.beginObject();
+  writer.key("type");
+  writer.value(webSocketMessageTypeName(WebSocketMessageType::stateUpdated));
+  writer.key("data");
+  writer.beginObject();
+  for (size_t slot = 0; slot < slots.size(); slot ++) {
+    if (slots[slot]) {
+      writer.key(keys[slot]);
+      writer.raw(valuesJson[slot]);
+    }
+  }
+  writer.endObject();
+  writer.endObject();
+}
+
+// [type, {field ID: value}], with the fields whose flags are set in `slots`.
+// valuesMsgPack is indexed by slot, and has each field's latest value already encoded.
+void writeStateUpdatedMsgPack(MsgPackWriter& writer, const std::vector<std::string>& valuesMsgPack, const std::vector<bool>& slots) {
+  size_t count = 0;
+  for (bool wanted : slots) {
+    if (wanted) {
+      count ++;
+    }
+  }
+  writer.writeArrayHeader(2);
+  writer.writeUint(WebSocketMessageType::stateUpdated);
+  writer.writeMapHeader(count);
+  for (size_t slot = 0; slot < slots.size(); slot ++) {
+    if (slots[slot]) {
+      writer.writeUint(slot);
+      writer.writeRaw((const uint8_t*)valuesMsgPack[slot].data(), valuesMsgPack[slot].size());
+    }
+  }
+}
+
+// {"type":"fieldIds","data":["key",...]}, where each key's field ID is its index.
+void writeFieldIdsJson(JsonWriter& writer, const std::vector<const char*>& keys) {
+  writer.clear();
+  writer.beginObject();
+  writer.key("type");
+  writer.value(webSocketMessageTypeName(WebSocketMessageType::fieldIds));
+  writer.key("data");
+  writer.beginArray();
+  for (const char* key : keys) {
+    writer.value(key);
+  }
+  writer.endArray();
+  writer.endObject();
+}
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef RHEOSCAPE_BUFFERED_SUBSCRIBER_H
+#define RHEOSCAPE_BUFFERED_SUBSCRIBER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+
+#include <RingBuffer.h>
+#include <event_stream/EventStream.h>
+#include <input/Input.h>
+
+// What a BufferedSubscriber does when an event comes in and the buffer's full.
+enum class BackpressurePolicy {
+  // Only ever keep the newest event; anything still waiting is replaced.
+  // Good for state, where only the current value matters.
+  latestValueWins,
+  dropOldest,
+  dropNewest,
+  // Make the emitter wait for the subscriber to catch up, but only for so long;
+  // after that the new event gets dropped.
+  // Only use this if the subscriber's being drained on another task, or it'll always time out.
+  blockWithTimeout
+};
+
+enum class BufferedSubscriberStat {
+  // How many events are waiting right now.
+  depth,
+  // The most that have ever been waiting at once.
+  highWaterMark,
+  delivered,
+  // Thrown away by the backpressure policy, including the ones that timed out.
+  dropped,
+  // Emitters that gave up waiting under blockWithTimeout.
+  timedOut
+};
+
+// Puts a bounded buffer between a stream and a slow subscriber, like an HTTPS call,
+// so that the subscriber can't hold up whoever's emitting.
+// Events get buffered on the emitter's task, and the subscriber gets called from whatever calls drain(),
+// e.g., a task of its own that loops on waitAndDrain().
+// The buffer's allocated up front, and it never grows.
+template <typename T>
+class BufferedSubscriber : public MultiInput<BufferedSubscriberStat, uint32_t> {
+  private:
+    std::mutex _mutex;
+    std::condition_variable _spaceFreed;
+    std::condition_variable _eventArrived;
+    RingBuffer<Event<T>> _buffer;
+    std::function<void(const Event<T>&)> _subscriber;
+    BackpressurePolicy _policy;
+    unsigned long _blockTimeoutMillis;
+    Subscription _subscription;
+    uint32_t _highWaterMark;
+    uint32_t _delivered;
+    uint32_t _dropped;
+    uint32_t _timedOut;
+
+    void _push(const Event<T>& event) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      switch (_policy) {
+        case BackpressurePolicy::latestValueWins:
+          _dropped += _buffer.size();
+          _buffer.clear();
+          break;
+        case BackpressurePolicy::dropOldest:
+          if (_buffer.full()) {
+            _buffer.pop();
+            _dropped ++;
+          }
+          break;
+        case BackpressurePolicy::dropNewest:
+          if (_buffer.full()) {
+            _dropped ++;
+            return;
+          }
+          break;
+        case BackpressurePolicy::blockWithTimeout:
+          if (!_spaceFreed.wait_for(lock, std::chrono::milliseconds(_blockTimeoutMillis), [this]() { return !_buffer.full(); })) {
+            _timedOut ++;
+            _dropped ++;
+            return;
+          }
+          break;
+      }
+
+      _buffer.push(event);
+      if (_buffer.size() > _highWaterMark) {
+        _highWaterMark = _buffer.size();
+      }
+      lock.unlock();
+      _eventArrived.notify_one();
+    }
+
+  public:
+    BufferedSubscriber(
+      EventStream<T>* eventStream,
+      std::function<void(const Event<T>&)> subscriber,
+      size_t capacity,
+      BackpressurePolicy policy = BackpressurePolicy::dropOldest,
+      unsigned long blockTimeoutMillis = 0
+    )
+    :
+      // Latest-value-wins never holds more than one.
+      _buffer(policy == BackpressurePolicy::latestValueWins ? 1 : capacity),
+      _subscriber(subscriber),
+      _policy(policy),
+      _blockTimeoutMillis(blockTimeoutMillis),
+      _highWaterMark(0),
+      _delivered(0),
+      _dropped(0),
+      _timedOut(0)
+    {
+      _subscription = eventStream->registerSubscriber([this](const Event<T>& event) { _push(event); });
+    }
+
+    ~BufferedSubscriber() {
+      _subscription.cancel();
+    }
+
+    BufferedSubscriber(const BufferedSubscriber&) = delete;
+    BufferedSubscriber& operator=(const BufferedSubscriber&) = delete;
+
+    // Hand waiting events to the subscriber, oldest first, up to the limit.
+    // Returns how many got delivered.
+    size_t drain(std::optional<size_t> maxEvents = std::nullopt) {
+      size_t count = 0;
+      while (!maxEvents.has_value() || count < maxEvents.value()) {
+        std::optional<Event<T>> event;
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          event = _buffer.pop();
+        }
+        if (!event.has_value()) {
+          break;
+        }
+        _spaceFreed.notify_one();
+        // Don't hold the lock while the subscriber runs; that's the whole point.
+        _subscriber(event.value());
+        {
+          // readChannel() reads it from other tasks, like the rest of the counters.
+          std::lock_guard<std::mutex> lock(_mutex);
+          _delivered ++;
+        }
+        count ++;
+      }
+      return count;
+    }
+
+    // Wait up to the timeout for something to show up, then drain everything.
+    // For a consumer task's main loop.
+    size_t waitAndDrain(unsigned long timeoutMillis) {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _eventArrived.wait_for(lock, std::chrono::milliseconds(timeoutMillis), [this]() { return !_buffer.empty(); });
+      }
+      return drain();
+    }
+
+    virtual uint32_t readChannel(BufferedSubscriberStat stat) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      switch (stat) {
+        case BufferedSubscriberStat::depth: return _buffer.size();
+        case BufferedSubscriberStat::highWaterMark: return _highWaterMark;
+        case BufferedSubscriberStat::delivered: return _delivered;
+        case BufferedSubscriberStat::dropped: return _dropped;
+        case BufferedSubscriberStat::timedOut: return _timedOut;
+        default: return 0;
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef RHEOSCAPE_CHANGE_FRAME_H
+#define RHEOSCAPE_CHANGE_FRAME_H
+
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <Runnable.h>
+#include <Timer.h>
+#include <event_stream/EventStream.h>
+#include <input/Input.h>
+
+// One stream's change during a tick, converted to whatever the consumers want to work with,
+// e.g., a JsonDocument for the web server.
+template <typename TValue>
+struct FrameUpdate {
+  const char* key;
+  // Where the stream comes in the order they were tracked.
+  // It's the same for as long as the collector's around, so it can stand in for the key, e.g., in a binary message.
+  size_t slot;
+  unsigned long timestamp;
+  std::optional<unsigned long> origin;
+  TValue value;
+};
+
+// A read-only view of all the updates collected in one tick, in the order the streams first changed.
+// It's only good until the consumer it was handed to returns.
+template <typename TValue>
+class ChangeFrame {
+  private:
+    const FrameUpdate<TValue>* _updates;
+    size_t _size;
+
+  public:
+    ChangeFrame(const FrameUpdate<TValue>* updates, size_t size)
+    :
+      _updates(updates),
+      _size(size)
+    { }
+
+    const FrameUpdate<TValue>* begin() const { return _updates; }
+    const FrameUpdate<TValue>* end() const { return _updates + _size; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    const FrameUpdate<TValue>& operator[](size_t i) const { return _updates[i]; }
+};
+
+enum class FrameCollectorStat {
+  // Changes recorded, i.e., how many messages there'd have been with one per change.
+  updates,
+  // Changes that replaced one that was already waiting in the frame.
+  coalesced,
+  // Frames handed to the consumers.
+  frames
+};
+
+// Gathers the changes from a bunch of streams over one Runner tick,
+// and hands them to its consumers all at once at the end of it.
+// If a stream changes more than once in a frame, only its latest value makes it into the frame.
+// That way something expensive, like a websocket broadcast, happens once a frame instead of once per field.
+//
+// With a flush interval, a frame stays open across ticks until the interval's passed since the last one went out.
+// The first change after a quiet spell still goes out at the end of its tick.
+//
+// Register it as a tick observer before the EventQueue,
+// so that the deferred events get dispatched into the same frame.
+template <typename TValue>
+class FrameCollector : public TickObserver, public MultiInput<FrameCollectorStat, uint32_t> {
+  private:
+    // Streams that haven't been deferred to the EventQueue might emit from another task.
+    std::mutex _mutex;
+    std::vector<FrameUpdate<TValue>> _collecting;
+    // Swapped with _collecting at the end of a tick,
+    // so anything the consumers cause to be emitted goes into the next frame.
+    std::vector<FrameUpdate<TValue>> _delivering;
+    // For every tracked stream, where its update is in _collecting, if it's changed this tick.
+    std::vector<std::optional<size_t>> _positions;
+    std::vector<const char*> _keys;
+    std::vector<std::function<void(ChangeFrame<TValue>)>> _consumers;
+    unsigned long _flushInterval;
+    std::optional<unsigned long> _lastFlushAt;
+    uint32_t _updateCount;
+    uint32_t _frameCount;
+    uint32_t _coalescedCount;
+
+    void _record(size_t slot, FrameUpdate<TValue> update) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _updateCount ++;
+      if (_positions[slot].has_value()) {
+        _collecting[_positions[slot].value()] = std::move(update);
+        _coalescedCount ++;
+        return;
+      }
+      _positions[slot] = _collecting.size();
+      _collecting.push_back(std::move(update));
+    }
+
+  public:
+    FrameCollector(unsigned long flushInterval = 0)
+    :
+      _flushInterval(flushInterval),
+      _updateCount(0),
+      _frameCount(0),
+      _coalescedCount(0)
+    { }
+
+    // Track a stream's changes under the given key, converting each value with convert(const T&) -> TValue.
+    // The key has to outlive the collector; a string literal is best.
+    template <typename T, typename TConvert>
+    Subscription track(const char* key, EventStream<T>* stream, TConvert convert) {
+      size_t slot = _positions.size();
+      _positions.push_back(std::nullopt);
+      _keys.push_back(key);
+      // Every stream can only show up once per frame, so this is the last allocation they'll need.
+      _collecting.reserve(_positions.size());
+      _delivering.reserve(_positions.size());
+      return stream->registerSubscriber([this, slot, key, convert](const Event<T>& event) {
+        _record(slot, FrameUpdate<TValue> { key, slot, event.timestamp, event.origin, convert(event.value) });
+      });
+    }
+
+    template <typename T>
+    Subscription track(const char* key, EventStream<T>* stream) {
+      return track(key, stream, [](const T& value) { return (TValue)value; });
+    }
+
+    // Every tracked key, indexed by slot.
+    const std::vector<const char*>& getKeys() const {
+      return _keys;
+    }
+
+    void registerConsumer(std::function<void(ChangeFrame<TValue>)> consumer) {
+      _consumers.push_back(consumer);
+    }
+
+    // The least time between frames, in milliseconds; 0 means a frame every tick that had changes.
+    void setFlushInterval(unsigned long flushInterval) {
+      _flushInterval = flushInterval;
+    }
+
+    virtual void afterTick() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_collecting.empty()) {
+          return;
+        }
+        unsigned long now = Timekeeper::nowMillis();
+        if (_lastFlushAt.has_value() && now - _lastFlushAt.value() < _flushInterval) {
+          // Keep collecting.
+          return;
+        }
+        _lastFlushAt = now;
+        std::swap(_collecting, _delivering);
+        for (std::optional<size_t>& position : _positions) {
+          position = std::nullopt;
+        }
+      }
+
+      ChangeFrame<TValue> frame(_delivering.data(), _delivering.size());
+      for (auto& consumer : _consumers) {
+        consumer(frame);
+      }
+      _delivering.clear();
+      _frameCount ++;
+    }
+
+    // How many frames have been delivered.
+    uint32_t getFrameCount() const { return _frameCount; }
+    // How many emits got folded into an update that was already in the frame.
+    uint32_t getCoalescedCount() const { return _coalescedCount; }
+
+    virtual uint32_t readChannel(FrameCollectorStat stat) {
+      switch (stat) {
+        case FrameCollectorStat::updates: {
+          std::lock_guard<std::mutex> lock(_mutex);
+          return _updateCount;
+        }
+        case FrameCollectorStat::coalesced: {
+          std::lock_guard<std::mutex> lock(_mutex);
+          return _coalescedCount;
+        }
+        case FrameCollectorStat::frames: return _frameCount;
+        default: return 0;
+      }
+    }
+};
+
+#endif
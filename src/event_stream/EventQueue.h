@@ -0,0 +1,193 @@
+#ifndef RHEOSCAPE_EVENT_QUEUE_H
+#define RHEOSCAPE_EVENT_QUEUE_H
+
+#include <mutex>
+#include <optional>
+
+#include <RingBuffer.h>
+#include <Runnable.h>
+#include <event_stream/EventStream.h>
+#include <input/Input.h>
+
+enum class EventQueueStat {
+  // How many events are waiting right now.
+  depth,
+  // The most that have ever been waiting at once.
+  highWaterMark,
+  queued,
+  dispatched,
+  // Thrown away by an overflow policy.
+  dropped,
+  // Dispatched right away by the dispatchNow overflow policy, on the emitter's stack.
+  dispatchedImmediately,
+  // Ticks that hit the dispatch cap and left events for the next tick.
+  carriedOverTicks
+};
+
+// Collects the events emitted by streams that have been deferTo()'d it,
+// and dispatches them in the order they were emitted at the end of every Runner tick.
+// Events that get emitted while it's dispatching go to the back of the line,
+// so a chain of deferred streams never gets any deeper than one of them on the stack.
+//
+// Register it as a tick observer after the LoopMonitor, so its dispatching counts towards the tick time.
+// It must outlive every stream deferred to it.
+class EventQueue : public AbstractEventQueue, public TickObserver, public MultiInput<EventQueueStat, uint32_t> {
+  private:
+    std::mutex _mutex;
+    // One entry per waiting event, pointing to the stream that's holding it.
+    RingBuffer<DeferredEventTarget*> _targets;
+    std::optional<size_t> _maxDispatchPerTick;
+    uint32_t _highWaterMark;
+    uint32_t _queued;
+    uint32_t _dispatched;
+    uint32_t _dropped;
+    uint32_t _dispatchedImmediately;
+    uint32_t _carriedOverTicks;
+
+    EventQueueAdmission _overflow(EventOverflowPolicy policy) {
+      if (policy == EventOverflowPolicy::dispatchNow) {
+        _dispatchedImmediately ++;
+        return EventQueueAdmission::dispatchNow;
+      }
+      _dropped ++;
+      return EventQueueAdmission::dropped;
+    }
+
+    // Takes the oldest entry that's either the target's or another dropOldest stream's out of the line,
+    // keeping the rest in order, and returns the stream it belonged to.
+    DeferredEventTarget* _removeOldestDroppable(DeferredEventTarget* target) {
+      std::optional<size_t> found;
+      for (size_t i = 0; i < _targets.size(); i ++) {
+        DeferredEventTarget* waiting = _targets.at(i);
+        if (waiting == target || waiting->getOverflowPolicy() == EventOverflowPolicy::dropOldest) {
+          found = i;
+          break;
+        }
+      }
+      if (!found.has_value()) {
+        return nullptr;
+      }
+      DeferredEventTarget* evicted = _targets.at(found.value());
+      RingBuffer<DeferredEventTarget*> kept(_targets.capacity());
+      for (size_t i = 0; !_targets.empty(); i ++) {
+        DeferredEventTarget* waiting = _targets.pop().value();
+        if (i != found.value()) {
+          kept.push(waiting);
+        }
+      }
+      _targets = kept;
+      return evicted;
+    }
+
+  public:
+    // The cap stops a flood of events from stretching a tick out; whatever's left waits for the next one.
+    EventQueue(size_t capacity, std::optional<size_t> maxDispatchPerTick = std::nullopt)
+    :
+      _targets(capacity),
+      _maxDispatchPerTick(maxDispatchPerTick),
+      _highWaterMark(0),
+      _queued(0),
+      _dispatched(0),
+      _dropped(0),
+      _dispatchedImmediately(0),
+      _carriedOverTicks(0)
+    { }
+
+    virtual std::mutex& getMutex() {
+      return _mutex;
+    }
+
+    virtual EventQueueAdmission admit(DeferredEventTarget* target, bool targetFull, EventOverflowPolicy policy) {
+      if (targetFull) {
+        // The stream's own backlog is full, so the queue already has an entry for every event it's holding.
+        if (policy == EventOverflowPolicy::dropOldest) {
+          _dropped ++;
+          _queued ++;
+          return EventQueueAdmission::replacedOldest;
+        }
+        return _overflow(policy);
+      }
+
+      if (_targets.full()) {
+        if (policy != EventOverflowPolicy::dropOldest) {
+          return _overflow(policy);
+        }
+        // Only make room with an event that its stream would be willing to lose:
+        // one of this stream's own, or one from another dropOldest stream.
+        // A burst of telemetry shouldn't push out an alarm message that asked for dispatchNow.
+        DeferredEventTarget* evicted = _removeOldestDroppable(target);
+        if (evicted == nullptr) {
+          return _overflow(policy);
+        }
+        evicted->discardDeferred();
+        _dropped ++;
+      }
+
+      _targets.push(target);
+      _queued ++;
+      if (_targets.size() > _highWaterMark) {
+        _highWaterMark = _targets.size();
+      }
+      return EventQueueAdmission::queued;
+    }
+
+    virtual void forget(DeferredEventTarget* target) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      RingBuffer<DeferredEventTarget*> kept(_targets.capacity());
+      while (!_targets.empty()) {
+        DeferredEventTarget* waiting = _targets.pop().value();
+        if (waiting != target) {
+          kept.push(waiting);
+        }
+      }
+      _targets = kept;
+    }
+
+    // Dispatch waiting events, oldest first, up to the per-tick cap.
+    // Returns how many got dispatched.
+    size_t drain() {
+      size_t count = 0;
+      while (!_maxDispatchPerTick.has_value() || count < _maxDispatchPerTick.value()) {
+        DeferredEventTarget* target;
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          if (_targets.empty()) {
+            return count;
+          }
+          target = _targets.pop().value();
+        }
+        // Don't hold the lock while the subscribers run; they might emit.
+        target->dispatchDeferred();
+        _dispatched ++;
+        count ++;
+      }
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_targets.empty()) {
+        _carriedOverTicks ++;
+      }
+      return count;
+    }
+
+    virtual void afterTick() {
+      drain();
+    }
+
+    virtual uint32_t readChannel(EventQueueStat stat) {
+      switch (stat) {
+        case EventQueueStat::depth: {
+          std::lock_guard<std::mutex> lock(_mutex);
+          return _targets.size();
+        }
+        case EventQueueStat::highWaterMark: return _highWaterMark;
+        case EventQueueStat::queued: return _queued;
+        case EventQueueStat::dispatched: return _dispatched;
+        case EventQueueStat::dropped: return _dropped;
+        case EventQueueStat::dispatchedImmediately: return _dispatchedImmediately;
+        case EventQueueStat::carriedOverTicks: return _carriedOverTicks;
+        default: return 0;
+      }
+    }
+};
+
+#endif
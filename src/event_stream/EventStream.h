@@ -1,53 +1,537 @@
 #ifndef RHEOSCAPE_EVENT_STREAM_H
 #define RHEOSCAPE_EVENT_STREAM_H
 
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 #include <helpers/string_format.h>
+#include <RingBuffer.h>
 #include <Runnable.h>
+#include <SampleTrace.h>
+#include <StatsRegistry.h>
 #include <Timer.h>
 
 template <typename T>
 struct Event {
   unsigned long timestamp;
   T value;
+  // When the oldest sensor sample behind this value was taken, in microseconds, if it was traced.
+  // See SampleTrace.
+  std::optional<unsigned long> origin;
 
-  Event(unsigned long timestamp, T value)
-  : timestamp(timestamp), value(value) { }
+  Event(unsigned long timestamp, T value, std::optional<unsigned long> origin = std::nullopt)
+  : timestamp(timestamp), value(value), origin(origin) { }
 };
 
+// An entry in a stream's history.
+// Sequence numbers count every event the stream has dispatched, starting at 1.
 template <typename T>
-class EventStream {
+struct SequencedEvent {
+  uint32_t sequence;
+  Event<T> event;
+};
+
+// Counters for finding the streams that stall the loop.
+// Subscribers run synchronously inside _emit, so the time spent in them
+// includes everything downstream of them, like websocket messages and HTTPS calls.
+class EventStreamStats : public StatsRegistry<EventStreamStats> {
+  private:
+    // The rate is counted in one-second windows. Only recordEmit() moves the window along;
+    // emitsPerSecond() gets called from the web server's task, so it only reads,
+    // and the lock keeps it from seeing a window that's halfway through moving.
+    mutable std::mutex _windowMutex;
+    unsigned long _windowStart;
+    uint32_t _windowCount;
+    // The count from the last window that finished.
+    uint32_t _lastWindowCount;
+
+  public:
+    const char* name;
+    uint32_t emitCount;
+    size_t subscriberCount;
+    // All in microseconds.
+    uint64_t totalSubscriberTime;
+    uint32_t maxSubscriberTime;
+
+    EventStreamStats(const char* name, size_t subscriberCount)
+    :
+      _windowStart(Timekeeper::nowMillis()),
+      _windowCount(0),
+      _lastWindowCount(0),
+      name(name),
+      emitCount(0),
+      subscriberCount(subscriberCount),
+      totalSubscriberTime(0),
+      maxSubscriberTime(0)
+    { }
+
+    void recordEmit(uint32_t subscriberTime) {
+      {
+        std::lock_guard<std::mutex> lock(_windowMutex);
+        unsigned long elapsed = Timekeeper::nowMillis() - _windowStart;
+        if (elapsed >= 1000) {
+          // If a whole window's gone by since the last emit, the last one to finish was empty.
+          _lastWindowCount = elapsed >= 2000 ? 0 : _windowCount;
+          _windowStart += elapsed - elapsed % 1000;
+          _windowCount = 0;
+        }
+        _windowCount ++;
+      }
+      emitCount ++;
+      totalSubscriberTime += subscriberTime;
+      if (subscriberTime > maxSubscriberTime) {
+        maxSubscriberTime = subscriberTime;
+      }
+    }
+
+    // How many were emitted in the last whole second.
+    float emitsPerSecond() const {
+      std::lock_guard<std::mutex> lock(_windowMutex);
+      unsigned long elapsed = Timekeeper::nowMillis() - _windowStart;
+      if (elapsed < 1000) {
+        return (float)_lastWindowCount;
+      }
+      // The window that's open has finished, but nothing's emitted since to move it along.
+      return elapsed < 2000 ? (float)_windowCount : 0.0f;
+    }
+};
+
+// What a deferred stream does when it's got no room for another event.
+enum class EventOverflowPolicy {
+  // Throw away the event that was just emitted.
+  dropNewest,
+  // Throw away the oldest waiting event to make room; good for settings, where only the latest matters.
+  dropOldest,
+  // Give up on deferring and call the subscribers right away; good for things you can't afford to lose.
+  dispatchNow
+};
+
+enum class EventQueueAdmission {
+  queued,
+  // The stream's own backlog was full, so it should swap its oldest event for this one.
+  replacedOldest,
+  dropped,
+  dispatchNow
+};
+
+// A stream with events waiting in an AbstractEventQueue.
+class DeferredEventTarget {
+  public:
+    // Called by the queue, without its mutex held, to hand the oldest waiting event to the subscribers.
+    virtual void dispatchDeferred() = 0;
+    // Called by the queue, with its mutex held, when it has to make room.
+    virtual void discardDeferred() = 0;
+    // Only dropOldest targets get their events thrown away to make room for other targets' events.
+    virtual EventOverflowPolicy getOverflowPolicy() const = 0;
+};
+
+// Holds the order that deferred events were emitted in, across all the streams deferred to it.
+// The streams hold the events themselves. See EventQueue for the real one.
+class AbstractEventQueue {
+  public:
+    // Guards the queue and the backlogs of every stream deferred to it,
+    // because events can be emitted from the web server's task.
+    virtual std::mutex& getMutex() = 0;
+    // Call with the mutex held.
+    virtual EventQueueAdmission admit(DeferredEventTarget* target, bool targetFull, EventOverflowPolicy policy) = 0;
+    // Forget about all of a stream's waiting events, e.g., because it's going away.
+    virtual void forget(DeferredEventTarget* target) = 0;
+};
+
+// Something that subscriptions can be cancelled on.
+// Lets Subscription be a plain, non-template handle.
+class SubscriptionOwner {
+  public:
+    virtual void unsubscribe(uint32_t id) = 0;
+};
+
+// What you get back from registering a subscriber.
+// Dropping it does nothing; the subscriber stays registered until you call cancel().
+// It's safe to cancel after the stream has gone away, and safe to cancel from inside the subscriber itself.
+class Subscription {
+  private:
+    // Points to a pointer to the stream, which the stream clears when it's destroyed.
+    std::weak_ptr<SubscriptionOwner*> _owner;
+    uint32_t _id;
+
+  public:
+    Subscription()
+    : _id(0)
+    { }
+
+    Subscription(std::weak_ptr<SubscriptionOwner*> owner, uint32_t id)
+    :
+      _owner(owner),
+      _id(id)
+    { }
+
+    void cancel() {
+      std::shared_ptr<SubscriptionOwner*> owner = _owner.lock();
+      if (owner && *owner && _id) {
+        (*owner)->unsubscribe(_id);
+      }
+      _owner.reset();
+      _id = 0;
+    }
+
+    bool isActive() const {
+      return _id != 0 && !_owner.expired();
+    }
+};
+
+template <typename T>
+class EventStream : public SubscriptionOwner, public DeferredEventTarget {
   private:
-    std::vector<std::function<void(Event<T>)>> _subscribers;
+    struct _Subscriber {
+      // 0 means it's been cancelled and is waiting to be swept out.
+      uint32_t id;
+      std::function<void(const Event<T>&)> receive;
+    };
+
+    // Kept in one contiguous block and called in place, in the order they were registered.
+    std::vector<_Subscriber> _subscribers;
+    // Subscribers registered in the middle of an emit wait here until it's done,
+    // so that _subscribers never reallocates under a subscriber that's running.
+    std::vector<_Subscriber> _pendingSubscribers;
+    uint32_t _nextSubscriberId = 1;
+    size_t _liveSubscriberCount = 0;
+    bool _hasCancelledSubscribers = false;
+    // How many emits deep we are; subscribers can emit on the stream that called them.
+    uint8_t _emitDepth = 0;
+    std::shared_ptr<SubscriptionOwner*> _self;
     std::optional<Event<T>> _lastEvent;
+    std::shared_ptr<EventStreamStats> _stats;
+    AbstractEventQueue* _queue = nullptr;
+    EventOverflowPolicy _overflowPolicy = EventOverflowPolicy::dropOldest;
+    RingBuffer<Event<T>> _deferred;
+    // Atomic, because the web server reads it from its own task.
+    std::atomic<uint32_t> _sequence = 0;
+    // The sequence number of the event the subscribers are being called with right now.
+    uint32_t _dispatchingSequence = 0;
+    // Empty unless enableHistory() has been called.
+    RingBuffer<SequencedEvent<T>> _history;
+    // The web server reads the history from its own task.
+    std::mutex _historyMutex;
+
+    void _dispatchNow(const Event<T>& event) {
+      uint32_t enclosingSequence = _dispatchingSequence;
+      if (_history.capacity()) {
+        // Under the lock, so that historyCovers() never sees the sequence number without its event.
+        std::lock_guard<std::mutex> lock(_historyMutex);
+        _dispatchingSequence = ++ _sequence;
+        if (_history.full()) {
+          _history.pop();
+        }
+        _history.push(SequencedEvent<T> { _dispatchingSequence, event });
+      } else {
+        _dispatchingSequence = ++ _sequence;
+      }
+
+      // Anything the subscribers emit inherits this event's origin.
+      SampleTrace trace(event.origin);
+      if (!_stats) {
+        _dispatch(event);
+      } else {
+        unsigned long start = Timekeeper::nowMicros();
+        _dispatch(event);
+        _stats->recordEmit(Timekeeper::nowMicros() - start);
+      }
+      _dispatchingSequence = enclosingSequence;
+    }
+
+    void _dispatch(const Event<T>& event) {
+      _emitDepth ++;
+      // Only the ones that were there when the emit started.
+      size_t count = _subscribers.size();
+      for (size_t i = 0; i < count; i ++) {
+        if (_subscribers[i].id) {
+          _subscribers[i].receive(event);
+        }
+      }
+      _emitDepth --;
+      if (_emitDepth == 0) {
+        _settle();
+      }
+    }
+
+    // Sweep out cancelled subscribers and let in the ones that are waiting.
+    void _settle() {
+      if (_hasCancelledSubscribers) {
+        size_t kept = 0;
+        for (size_t i = 0; i < _subscribers.size(); i ++) {
+          if (_subscribers[i].id) {
+            if (kept != i) {
+              _subscribers[kept] = std::move(_subscribers[i]);
+            }
+            kept ++;
+          }
+        }
+        _subscribers.resize(kept);
+        _hasCancelledSubscribers = false;
+      }
+      if (!_pendingSubscribers.empty()) {
+        for (_Subscriber& subscriber : _pendingSubscribers) {
+          if (subscriber.id) {
+            _subscribers.push_back(std::move(subscriber));
+          }
+        }
+        _pendingSubscribers.clear();
+      }
+    }
 
   protected:
-    void _emit(Event<T> event) {
-      _lastEvent = event;
-      for (auto receive : _subscribers) {
-        receive(event);
+    void _emit(const Event<T>& event) {
+      if (_queue == nullptr) {
+        _lastEvent = event;
+        _dispatchNow(event);
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(_queue->getMutex());
+        _lastEvent = event;
+        switch (_queue->admit(this, _deferred.full(), _overflowPolicy)) {
+          case EventQueueAdmission::queued:
+            _deferred.push(event);
+            return;
+          case EventQueueAdmission::replacedOldest:
+            _deferred.pop();
+            _deferred.push(event);
+            return;
+          case EventQueueAdmission::dropped:
+            return;
+          case EventQueueAdmission::dispatchNow:
+            break;
+        }
       }
+      _dispatchNow(event);
     }
 
     void _emit(T value) {
       _emit(Event<T>{
         Timekeeper::nowMillis(),
-        value
+        value,
+        SampleTrace::currentOrigin()
       });
     }
 
   public:
-    void registerSubscriber(std::function<void(Event<T>)> subscriber, bool receiveLastEvent = false) {
-      _subscribers.push_back(subscriber);
+    EventStream() { }
+
+    // Copies get the subscribers but not the subscriptions;
+    // cancelling a subscription only ever affects the stream it came from.
+    EventStream(const EventStream& other)
+    :
+      _subscribers(other._subscribers),
+      _pendingSubscribers(other._pendingSubscribers),
+      _nextSubscriberId(other._nextSubscriberId),
+      _liveSubscriberCount(other._liveSubscriberCount),
+      _hasCancelledSubscribers(other._hasCancelledSubscribers),
+      _lastEvent(other._lastEvent),
+      _stats(other._stats),
+      _queue(other._queue),
+      _overflowPolicy(other._overflowPolicy),
+      _deferred(other._deferred.capacity()),
+      _history(other._history.capacity())
+    { }
+
+    EventStream& operator=(const EventStream& other) {
+      if (this != &other) {
+        _subscribers = other._subscribers;
+        _pendingSubscribers = other._pendingSubscribers;
+        _nextSubscriberId = other._nextSubscriberId;
+        _liveSubscriberCount = other._liveSubscriberCount;
+        _hasCancelledSubscribers = other._hasCancelledSubscribers;
+        _lastEvent = other._lastEvent;
+        _stats = other._stats;
+        if (_queue) {
+          _queue->forget(this);
+        }
+        _queue = other._queue;
+        _overflowPolicy = other._overflowPolicy;
+        _deferred = RingBuffer<Event<T>>(other._deferred.capacity());
+        std::lock_guard<std::mutex> lock(_historyMutex);
+        _history = RingBuffer<SequencedEvent<T>>(other._history.capacity());
+      }
+      return *this;
+    }
+
+    virtual ~EventStream() {
+      // Any Subscriptions still out there will find nothing to cancel.
+      if (_self) {
+        *_self = nullptr;
+      }
+      if (_queue) {
+        _queue->forget(this);
+      }
+    }
+
+    // Subscribers that take a const Event<T>& get called without copying the event.
+    // Ones that take an Event<T> still work, but get a copy.
+    Subscription registerSubscriber(std::function<void(const Event<T>&)> subscriber, bool receiveLastEvent = false) {
+      if (!_self) {
+        _self = std::make_shared<SubscriptionOwner*>(this);
+      }
+      uint32_t id = _nextSubscriberId ++;
+      if (_emitDepth) {
+        _pendingSubscribers.push_back(_Subscriber { id, subscriber });
+      } else {
+        _subscribers.push_back(_Subscriber { id, subscriber });
+      }
+      _liveSubscriberCount ++;
+      if (_stats) {
+        _stats->subscriberCount = _liveSubscriberCount;
+      }
       if (receiveLastEvent && _lastEvent.has_value()) {
         subscriber(_lastEvent.value());
       }
+      return Subscription(_self, id);
+    }
+
+    // Usually called through Subscription::cancel().
+    // The subscriber won't be called again, even later on in an emit that's already happening.
+    virtual void unsubscribe(uint32_t id) {
+      for (std::vector<_Subscriber>* list : { &_subscribers, &_pendingSubscribers }) {
+        for (_Subscriber& subscriber : *list) {
+          if (subscriber.id == id) {
+            subscriber.id = 0;
+            _hasCancelledSubscribers = true;
+            _liveSubscriberCount --;
+            if (_stats) {
+              _stats->subscriberCount = _liveSubscriberCount;
+            }
+            if (!_emitDepth) {
+              _settle();
+            }
+            return;
+          }
+        }
+      }
     }
 
     std::optional<Event<T>> getLastEvent() const {
       return _lastEvent;
     }
+
+    // Keep the last few events that were dispatched, so that late subscribers can catch up on them.
+    // The history is allocated here, once, and never again.
+    void enableHistory(size_t length) {
+      std::lock_guard<std::mutex> lock(_historyMutex);
+      _history = RingBuffer<SequencedEvent<T>>(length);
+    }
+
+    // The sequence number of the last event dispatched, or 0 if there hasn't been one.
+    uint32_t getSequence() const {
+      return _sequence;
+    }
+
+    // Whether the history still has every event after the given sequence number,
+    // i.e., whether someone who'd seen up to there can catch up without starting over.
+    bool historyCovers(uint32_t afterSequence) {
+      std::lock_guard<std::mutex> lock(_historyMutex);
+      uint32_t sequence = _sequence;
+      if (afterSequence == sequence) {
+        return true;
+      }
+      // A sequence number from the future, e.g., one the client saw before a reboot, doesn't count.
+      if ((int32_t)(afterSequence - sequence) > 0) {
+        return false;
+      }
+      if (_history.empty()) {
+        return false;
+      }
+      // Compare by difference, so that it still works when the sequence rolls over.
+      return (int32_t)(afterSequence + 1 - _history.front().sequence) >= 0;
+    }
+
+    // Call a function with every event in the history after the given sequence number, oldest first.
+    // It's safe to call from another task; events that come in meanwhile get included.
+    void forEachInHistory(uint32_t afterSequence, std::function<void(const Event<T>&, uint32_t)> visit) {
+      uint32_t cursor = afterSequence;
+      while (true) {
+        std::optional<SequencedEvent<T>> next;
+        {
+          std::lock_guard<std::mutex> lock(_historyMutex);
+          if (_history.empty()) {
+            return;
+          }
+          // The history's sequence numbers have no gaps, so the next one's position can be worked out.
+          uint32_t oldest = _history.front().sequence;
+          uint32_t wanted = (int32_t)(cursor + 1 - oldest) < 0 ? oldest : cursor + 1;
+          size_t index = wanted - oldest;
+          if (index >= _history.size()) {
+            return;
+          }
+          next = _history.at(index);
+        }
+        // Without the lock, in case the visitor emits on this stream.
+        visit(next.value().event, next.value().sequence);
+        cursor = next.value().sequence;
+      }
+    }
+
+    // Replay whatever's in the history after the given sequence number, then carry on with new events.
+    // The subscriber gets every event's sequence number, so it knows where to pick up from next time.
+    // Check historyCovers() first if it matters whether anything was missed.
+    // Call this on the task that dispatches the stream's events, so none of them slip in between.
+    Subscription registerSubscriberFrom(uint32_t afterSequence, std::function<void(const Event<T>&, uint32_t)> subscriber) {
+      forEachInHistory(afterSequence, subscriber);
+      return registerSubscriber([this, subscriber](const Event<T>& event) { subscriber(event, _dispatchingSequence); });
+    }
+
+    size_t getSubscriberCount() const {
+      return _liveSubscriberCount;
+    }
+
+    // Start counting emits and timing subscribers.
+    // Streams without stats pay nothing but a null check per emit.
+    // The name shows up wherever EventStreamStats::all() gets reported.
+    void enableStats(const char* name) {
+      if (!_stats) {
+        _stats = EventStreamStats::create(name, _liveSubscriberCount);
+      }
+    }
+
+    std::shared_ptr<EventStreamStats> getStats() const {
+      return _stats;
+    }
+
+    // Stop calling subscribers from inside _emit(); queue the events up and let the queue dispatch them later,
+    // in the order they were emitted, on whatever task drains the queue.
+    // That keeps long chains of streams off the emitter's stack, e.g., a web request handler's.
+    // getLastEvent() still changes right away.
+    // The backlog is how many of this stream's events can be waiting at once.
+    void deferTo(AbstractEventQueue* queue, size_t backlog = 4, EventOverflowPolicy overflowPolicy = EventOverflowPolicy::dropOldest) {
+      if (_queue) {
+        _queue->forget(this);
+      }
+      _queue = queue;
+      _overflowPolicy = overflowPolicy;
+      _deferred = RingBuffer<Event<T>>(backlog);
+    }
+
+    virtual void dispatchDeferred() {
+      std::optional<Event<T>> event;
+      {
+        std::lock_guard<std::mutex> lock(_queue->getMutex());
+        event = _deferred.pop();
+      }
+      if (event.has_value()) {
+        _dispatchNow(event.value());
+      }
+    }
+
+    virtual void discardDeferred() {
+      _deferred.pop();
+    }
+
+    virtual EventOverflowPolicy getOverflowPolicy() const {
+      return _overflowPolicy;
+    }
 };
 
 // I suppose it's silly to make this; just feel like it makes intentions clear.
@@ -1,32 +1,100 @@
 #ifndef RHEOSCAPE_EVENT_STREAM_PROCESSES_H
 #define RHEOSCAPE_EVENT_STREAM_PROCESSES_H
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
+#include <type_traits>
 
 #include <Runnable.h>
+#include <TickClock.h>
 #include <Timer.h>
 #include <input/Input.h>
 #include <input/TranslatingProcesses.h>
 #include <event_stream/EventStream.h>
 
+// Decides when an InputToEventStream bothers to emit.
+// The default emits every time the value changes at all, which is too often for noisy sensors.
+struct EmitPolicy {
+  // A numeric value has to move further than this from the last one emitted to count as a change.
+  float absoluteDeadband;
+  // The same, as a fraction of the last value emitted, e.g., 0.05 for 5%.
+  // If both are set, the wider of the two wins.
+  float relativeDeadband;
+  // Changes that come in sooner than this after the last emit are held back until it's up,
+  // then the latest one gets emitted.
+  unsigned long minInterval;
+  // Re-emit the current value if nothing's been emitted for this long,
+  // so subscribers that missed something (e.g., a websocket client that just connected) catch up.
+  std::optional<unsigned long> maxSilence;
+
+  EmitPolicy(float absoluteDeadband = 0, float relativeDeadband = 0, unsigned long minInterval = 0, std::optional<unsigned long> maxSilence = std::nullopt)
+  :
+    absoluteDeadband(absoluteDeadband),
+    relativeDeadband(relativeDeadband),
+    minInterval(minInterval),
+    maxSilence(maxSilence)
+  { }
+};
+
+// Deadbands only make sense for numbers; anything else counts as changed whenever it isn't equal.
+template <typename T>
+bool exceedsDeadband(const T& last, const T& next, const EmitPolicy& policy) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    double difference = fabs((double)next - (double)last);
+    double deadband = std::max((double)policy.absoluteDeadband, policy.relativeDeadband * fabs((double)last));
+    return difference > deadband;
+  } else {
+    return next != last;
+  }
+}
+
+// A sensor appearing or dropping out is always a change.
+template <typename T>
+bool exceedsDeadband(const std::optional<T>& last, const std::optional<T>& next, const EmitPolicy& policy) {
+  if (last.has_value() && next.has_value()) {
+    return exceedsDeadband(last.value(), next.value(), policy);
+  }
+  return last.has_value() != next.has_value();
+}
+
 template <typename T>
 class InputToEventStream : public EventStream<T>, public Runnable {
   private:
     Input<T>* _wrappedInput;
     std::optional<T> _lastSeenValue;
+    std::optional<T> _lastEmittedValue;
+    std::optional<unsigned long> _lastEmittedAt;
+    // A change that's waiting for the minimum interval to pass.
+    std::optional<T> _pendingValue;
     std::optional<Throttle<T>> _throttle;
+    EmitPolicy _policy;
+
+    void _emitNow(T value, unsigned long now) {
+      _lastEmittedValue = value;
+      _lastEmittedAt = now;
+      _pendingValue = std::nullopt;
+      EventStream<T>::_emit(value);
+    }
     
   public:
-    InputToEventStream(Input<T>* wrappedInput, unsigned long throttleRead = 0)
+    InputToEventStream(Input<T>* wrappedInput, unsigned long throttleRead = 0, EmitPolicy policy = EmitPolicy())
     :
       _wrappedInput(wrappedInput),
       _throttle(throttleRead
         ? (std::optional<Throttle<T>>)Throttle<T>(throttleRead, [wrappedInput]() { return wrappedInput->read(); })
         : (std::optional<Throttle<T>>)std::nullopt
-      )
+      ),
+      _policy(policy)
     { }
 
+    void setEmitPolicy(EmitPolicy policy) {
+      _policy = policy;
+    }
+
     virtual void run() {
+      // Catches the origins of any sensor samples read below, so the emitted event carries them.
+      SampleTrace trace;
       std::optional<T> nextValue;
       if (_throttle.has_value()) {
         nextValue = _throttle.value().tryRun();
@@ -34,14 +102,27 @@ class InputToEventStream : public EventStream<T>, public Runnable {
         nextValue = _wrappedInput->read();
       }
 
-      if (!nextValue.has_value()) {
+      if (nextValue.has_value()) {
+        _lastSeenValue = nextValue;
+        if (!_lastEmittedValue.has_value() || exceedsDeadband(_lastEmittedValue.value(), nextValue.value(), _policy)) {
+          _pendingValue = nextValue;
+        } else {
+          // It wandered back inside the deadband before the minimum interval was up.
+          _pendingValue = std::nullopt;
+        }
+      }
+
+      if (!_lastSeenValue.has_value()) {
         return;
       }
 
-      T nextValueValue = nextValue.value();
-      if (!_lastSeenValue.has_value() || nextValueValue != _lastSeenValue.value()) {
-        _lastSeenValue = nextValueValue;
-        EventStream<T>::_emit(nextValueValue);
+      unsigned long now = Timekeeper::nowMillis();
+      if (_pendingValue.has_value()) {
+        if (!_lastEmittedAt.has_value() || now - _lastEmittedAt.value() >= _policy.minInterval) {
+          _emitNow(_pendingValue.value(), now);
+        }
+      } else if (_policy.maxSilence.has_value() && now - _lastEmittedAt.value() >= _policy.maxSilence.value()) {
+        _emitNow(_lastSeenValue.value(), now);
       }
     }
 };
@@ -52,7 +133,7 @@ class EventStreamFilter : public EventStream<T> {
     std::function<bool(Event<T>)> _filter;
 
   public:
-    void receiveEvent(Event<T> event) {
+    void receiveEvent(const Event<T>& event) {
       if (_filter(event)) {
         this->_emit(event);
       }
@@ -61,7 +142,7 @@ class EventStreamFilter : public EventStream<T> {
     EventStreamFilter(EventStream<T>* wrappedEventStream, std::function<bool(Event<T>)> filter)
     : _filter(filter)
     {
-      wrappedEventStream->registerSubscriber([this](Event<T> e) { this->receiveEvent(e); });
+      wrappedEventStream->registerSubscriber([this](const Event<T>& e) { this->receiveEvent(e); });
     }
 
     EventStreamFilter(EventStream<T>* wrappedEventStream, std::function<bool(T)> filter)
@@ -74,19 +155,23 @@ class EventStreamTranslator : public EventStream<TOut> {
   private:
     const std::function<Event<TOut>(Event<TIn>)> _translator;
 
-    void _receiveEvent(Event<TIn> event) {
-      this->_emit(_translator(event));
+    void _receiveEvent(const Event<TIn>& event) {
+      Event<TOut> translated = _translator(event);
+      if (!translated.origin.has_value()) {
+        translated.origin = event.origin;
+      }
+      this->_emit(translated);
     }
 
   public:
     EventStreamTranslator(EventStream<TIn>* wrappedEventStream, std::function<Event<TOut>(Event<TIn>)> translator)
     : _translator(translator)
     {
-      wrappedEventStream->registerSubscriber([this](Event<TIn> e) { this->_receiveEvent(e); });
+      wrappedEventStream->registerSubscriber([this](const Event<TIn>& e) { this->_receiveEvent(e); });
     }
 
     EventStreamTranslator(EventStream<TIn>* wrappedEventStream, std::function<TOut(TIn)> translator)
-    : EventStreamTranslator(wrappedEventStream, [translator](Event<TIn> e) { return Event(e.timestamp, translator(e.value)); })
+    : EventStreamTranslator(wrappedEventStream, [translator](Event<TIn> e) { return Event(e.timestamp, translator(e.value), e.origin); })
     { }
 };
 
@@ -109,46 +194,73 @@ class EventStreamNotEmpty : public EventStreamTranslator<std::optional<T>, T> {
     { }
 };
 
+// Only lets an event through if the value holds for the whole delay.
+// It either needs to be registered as a runnable,
+// or be given a TickClock to wake it up when the delay's over.
 template <typename T>
-class EventStreamDebouncer : public EventStream<T>, public Runnable {
+class EventStreamDebouncer : public EventStream<T>, public Runnable, public ClockListener {
   private:
+    unsigned long _delay;
+    TickClock* _clock;
+    size_t _slot;
     Timer _timer;
     std::optional<Event<T>> _firstEvent;
     std::optional<Event<T>> _latestEvent;
 
-    void _receiveEvent(Event<T> event) {
+    void _receiveEvent(const Event<T>& event) {
       if (!_firstEvent.has_value()) {
         _firstEvent = event;
-        _timer.restart();
+        if (_clock != nullptr) {
+          _clock->wakeAt(_slot, _clock->nowMillis() + _delay);
+        } else {
+          _timer.restart();
+        }
       } else {
         _latestEvent = event;
       }
     }
 
+    void _settle() {
+      if (!_latestEvent.has_value() || _latestEvent.value().value == _firstEvent.value().value) {
+        // Event value(s) held through debounce. Emit the original one.
+        this->_emit(_firstEvent.value());
+      }
+      // Reset the state either way, for the next debounce cycle.
+      _firstEvent = _latestEvent = std::nullopt;
+    }
+
   public:
-    EventStreamDebouncer(EventStream<T>* wrappedEventStream, unsigned long delay)
+    EventStreamDebouncer(EventStream<T>* wrappedEventStream, unsigned long delay, TickClock* clock = nullptr)
     :
+      _delay(delay),
+      _clock(clock),
       _timer(Timer(
         delay,
-        [this]() {
-          if (!_latestEvent.has_value() || _latestEvent.value().value == _firstEvent.value().value) {
-            // Event value(s) held through debounce. Emit the original one.
-            this->_emit(_firstEvent.value());
-          }
-          // Reset the state either way, for the next debounce cycle.
-          _firstEvent = _latestEvent = std::nullopt;
-        },
+        [this]() { _settle(); },
         1,
         false,
         false
       ))
     {
-      wrappedEventStream->registerSubscriber([this](Event<T> e) { this->_receiveEvent(e); });
+      if (clock != nullptr) {
+        _slot = clock->addListener(this);
+      }
+      wrappedEventStream->registerSubscriber([this](const Event<T>& e) { this->_receiveEvent(e); });
+    }
+
+    ~EventStreamDebouncer() {
+      if (_clock != nullptr) {
+        _clock->removeListener(_slot);
+      }
     }
 
     void run() {
       _timer.run();
     }
+
+    virtual void onClockDeadline(unsigned long now) {
+      _settle();
+    }
 };
 
 template <typename TIndex, typename TEvent>
@@ -158,7 +270,7 @@ class EventStreamSwitcher : public EventStream<TEvent> {
     Input<TIndex>* _switchInput;
     std::string _message;
 
-    void _receiveEventWithStreamIndex(TIndex index, Event<TEvent> event) {
+    void _receiveEventWithStreamIndex(TIndex index, const Event<TEvent>& event) {
       if (_switchInput->read() == index) {
         _message = "received event with stream index and it's the active stream";
         this->_emit(event);
@@ -174,7 +286,7 @@ class EventStreamSwitcher : public EventStream<TEvent> {
     {
       _message = "entering constructor";
       for (auto stream : _eventStreams) {
-        stream.second->registerSubscriber([stream, this](Event<TEvent> e) { this->_receiveEventWithStreamIndex(stream.first, e); });
+        stream.second->registerSubscriber([stream, this](const Event<TEvent>& e) { this->_receiveEventWithStreamIndex(stream.first, e); });
       }
       _message = "registered all the subscribers";
     }
@@ -188,48 +300,89 @@ class EventStreamCombiner : public EventStream<T> {
     EventStreamCombiner(std::vector<EventStream<T>*> eventStreams)
     {
       for (int i = 0; i < eventStreams.size(); i ++) {
-        eventStreams[i]->registerSubscriber([this](Event<T> event) { this->_emit(event); });
+        eventStreams[i]->registerSubscriber([this](const Event<T>& event) { this->_emit(event); });
       }
     }
 };
 
+// Emit the value every interval for as long as the status is true.
+// It needs to be registered as a runnable either way, so it can watch the status.
+// Given a TickClock, it emits on the clock's interval boundaries rather than counting from when the status went true,
+// so beacons with the same interval emit on the same tick.
 template <typename T>
-class Beacon : public EventStream<T>, public Runnable {
+class Beacon : public EventStream<T>, public Runnable, public ClockListener {
   private:
+    Input<T>* _valueInput;
+    unsigned long _interval;
+    TickClock* _clock;
+    size_t _slot;
+    bool _isBeaconing;
     Timer _timer;
     Input<bool>* _statusInput;
 
   public:
-    Beacon(Input<T>* valueInput, Input<bool>* statusInput, unsigned long interval)
+    Beacon(Input<T>* valueInput, Input<bool>* statusInput, unsigned long interval, TickClock* clock = nullptr)
     :
-      _statusInput(statusInput),
+      _valueInput(valueInput),
+      _interval(interval),
+      _clock(clock),
+      _isBeaconing(false),
       _timer(Timer(
         interval,
         [valueInput, this]() {
           this->_emit(valueInput->read());
         },
-        std::nullopt
+        std::nullopt,
         // We would emit an event on first run, but there's no event handler yet to listen to it.
-      ))
-    { }
+        false,
+        clock == nullptr
+      )),
+      _statusInput(statusInput)
+    {
+      if (clock != nullptr) {
+        _slot = clock->addListener(this);
+      }
+    }
 
-    Beacon(Input<std::optional<T>>* valueInput, unsigned long interval)
+    Beacon(Input<std::optional<T>>* valueInput, unsigned long interval, TickClock* clock = nullptr)
     : Beacon(
       // FIXME: two memory leaks
       new TranslatingProcess<std::optional<T>, T>(valueInput, [](std::optional<T> value) { return value.value(); }),
       new TranslatingProcess<std::optional<T>, bool>(valueInput, [](std::optional<T> value) { return value.has_value(); }),
-      interval
+      interval,
+      clock
     )
     { }
 
+    ~Beacon() {
+      if (_clock != nullptr) {
+        _clock->removeListener(_slot);
+      }
+    }
+
     virtual void run() {
-      if (_statusInput->read() && !_timer.isRunning()) {
+      bool status = _statusInput->read();
+      if (_clock != nullptr) {
+        if (status && !_isBeaconing) {
+          _clock->wakeAt(_slot, _clock->nextCycleStart(_interval));
+        } else if (!status && _isBeaconing) {
+          _clock->cancelWakeup(_slot);
+        }
+        _isBeaconing = status;
+        return;
+      }
+      if (status && !_timer.isRunning()) {
         _timer.restart();
-      } else if (!_statusInput->read() && _timer.isRunning()) {
+      } else if (!status && _timer.isRunning()) {
         _timer.cancel();
       }
       _timer.run();
     }
+
+    virtual void onClockDeadline(unsigned long now) {
+      this->_emit(Event<T>(now, _valueInput->read()));
+      _clock->wakeAt(_slot, _clock->nextCycleStart(_interval));
+    }
 };
 
 #endif
\ No newline at end of file
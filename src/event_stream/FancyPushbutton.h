@@ -80,10 +80,10 @@ class FancyPushbutton : public EventStream<FancyPushbuttonEvent>, public Runnabl
       _longPressTime(longPressTime),
       _repeatInterval(repeatInterval)
     {
-      wrappedEventStream->registerSubscriber([this](Event<bool> v) { this->receiveEvent(v); });
+      wrappedEventStream->registerSubscriber([this](const Event<bool>& v) { this->receiveEvent(v); });
     }
   
-    void receiveEvent(Event<bool> event) {
+    void receiveEvent(const Event<bool>& event) {
       if (event.value && (!_lastEventReceived.has_value() || !_lastEventReceived.value().value)) {
         // Last event seen was false and the new one is true; transition to down.
         _lastEventEmitted = Event<FancyPushbuttonEvent>{
@@ -121,6 +121,7 @@ class FancyPushbutton : public EventStream<FancyPushbuttonEvent>, public Runnabl
         // We only needed to keep track of it so we knew what kinds of fancy event(s) to emit during `run()`.
         _lastEventEmitted = std::nullopt;
       }
+      _lastEventReceived = event;
     }
 
     void run() {
@@ -132,31 +133,34 @@ class FancyPushbutton : public EventStream<FancyPushbuttonEvent>, public Runnabl
       unsigned long lastEventTimestamp = _lastEventEmitted.value().timestamp;
       FancyPushbuttonEvent lastEvent = _lastEventEmitted.value().value;
       unsigned long now = Timekeeper::nowMillis();
+      // The hold times are all measured from when the button went down.
+      unsigned long downTimestamp = lastEvent == button_holdStart ? lastEventTimestamp - _shortPressTime : lastEventTimestamp;
       std::optional<unsigned long> lastRepeatPressTimestamp;
       switch (lastEvent) {
         case button_down:
-          if (lastEventTimestamp + _shortPressTime >= now) {
+          if (now - downTimestamp >= _shortPressTime) {
             // Passed the short press time; we're now into long press territory.
             // We emit an event stamped to the start of the long press, not the current timestamp --
             // even though that time has passed already.
             // Maybe we should set the timestamp to _shortPressTime + 1
             // (which would also necessitate changing the above condition from >= to >)
             // but I think 1 millisecond isn't going to be that surprising.
-            unsigned long longPressStartTimestamp = lastEventTimestamp + _shortPressTime;
-            _emit(Event<FancyPushbuttonEvent>{
+            unsigned long longPressStartTimestamp = downTimestamp + _shortPressTime;
+            _lastEventEmitted = Event<FancyPushbuttonEvent>{
               longPressStartTimestamp,
               button_holdStart
-            });
+            };
+            _emit(_lastEventEmitted.value());
           } else {
             // We don't want to fall through if we haven't hit the end of short press time.
             break;
           }
           // Fall through to repeat press territory in case we've gotten that far..
         case button_holdStart:
-          if (lastEventTimestamp + _longPressTime >= now) {
+          if (now - downTimestamp >= _longPressTime) {
             // We're beyond long press territory, into repeat press territory.
             // Emit the first repeat press event.
-            lastRepeatPressTimestamp = lastEventTimestamp + _longPressTime;
+            lastRepeatPressTimestamp = downTimestamp + _longPressTime;
             _emit(Event<FancyPushbuttonEvent>{now, button_press});
             _lastEventEmitted = Event<FancyPushbuttonEvent>{
               lastRepeatPressTimestamp.value(),
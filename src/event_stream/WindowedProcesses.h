@@ -0,0 +1,215 @@
+#ifndef RHEOSCAPE_WINDOWED_PROCESSES_H
+#define RHEOSCAPE_WINDOWED_PROCESSES_H
+
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+#include <RingBuffer.h>
+#include <TickClock.h>
+#include <event_stream/EventStream.h>
+
+// A summary of the events that came in during a window of time.
+// It's the same size no matter how many events went into it.
+template <typename T>
+struct WindowAggregate {
+  unsigned long start;
+  unsigned long length;
+  uint32_t count;
+  std::optional<T> first;
+  std::optional<T> last;
+  // Only kept for numbers.
+  std::optional<T> min;
+  std::optional<T> max;
+
+  WindowAggregate(unsigned long start = 0, unsigned long length = 0)
+  :
+    start(start),
+    length(length),
+    count(0)
+  { }
+
+  unsigned long end() const {
+    return start + length;
+  }
+
+  float ratePerSecond() const {
+    return length ? (float)count * 1000.0f / (float)length : 0.0f;
+  }
+
+  void add(const T& value) {
+    if (!count) {
+      first = value;
+    }
+    last = value;
+    count ++;
+    if constexpr (std::is_arithmetic_v<T>) {
+      if (!min.has_value() || value < min.value()) {
+        min = value;
+      }
+      if (!max.has_value() || value > max.value()) {
+        max = value;
+      }
+    }
+  }
+
+  // Fold in a window that comes right after this one.
+  void merge(const WindowAggregate<T>& later) {
+    length = later.end() - start;
+    if (!later.count) {
+      return;
+    }
+    if (!count) {
+      first = later.first;
+    }
+    last = later.last;
+    count += later.count;
+    if constexpr (std::is_arithmetic_v<T>) {
+      if (!min.has_value() || later.min.value() < min.value()) {
+        min = later.min;
+      }
+      if (!max.has_value() || later.max.value() > max.value()) {
+        max = later.max;
+      }
+    }
+  }
+};
+
+// Chops time up into back-to-back windows of the same length,
+// and emits a summary of the events in each one when it closes.
+// The event's timestamp is when the window ended.
+// It doesn't have a timer of its own; the TickClock wakes it up when a window's done.
+template <typename T>
+class TumblingWindow : public EventStream<WindowAggregate<T>>, public ClockListener {
+  private:
+    TickClock* _clock;
+    size_t _slot;
+    unsigned long _length;
+    bool _emitEmpty;
+    WindowAggregate<T> _current;
+    Subscription _subscription;
+
+  public:
+    TumblingWindow(
+      EventStream<T>* wrappedEventStream,
+      unsigned long length,
+      TickClock* clock,
+      // Emit windows that nothing happened in, e.g., to show a rate of zero.
+      bool emitEmpty = false
+    )
+    :
+      _clock(clock),
+      _length(length),
+      _emitEmpty(emitEmpty),
+      _current(clock->nowMillis(), length)
+    {
+      if (length == 0) {
+        throw std::invalid_argument("Can't have a zero-length window.");
+      }
+      _slot = clock->addListener(this);
+      clock->wakeAt(_slot, _current.end());
+      _subscription = wrappedEventStream->registerSubscriber([this](const Event<T>& e) { _current.add(e.value); });
+    }
+
+    ~TumblingWindow() {
+      _clock->removeListener(_slot);
+      _subscription.cancel();
+    }
+
+    virtual void onClockDeadline(unsigned long now) {
+      if (_current.count || _emitEmpty) {
+        this->_emit(Event<WindowAggregate<T>>(_current.end(), _current));
+      }
+      // If the clock's been away for a while, skip the windows that ended in the meantime;
+      // they can't have had anything in them.
+      unsigned long windowsPassed = (now - _current.start) / _length;
+      _current = WindowAggregate<T>(_current.start + windowsPassed * _length, _length);
+      _clock->wakeAt(_slot, _current.end());
+    }
+
+    // The window that's still open.
+    const WindowAggregate<T>& getCurrent() const {
+      return _current;
+    }
+};
+
+// Like a tumbling window, but the windows overlap.
+// Every hop it emits a summary of the last `length` milliseconds.
+// It keeps one small summary per hop rather than the events themselves,
+// so memory is fixed at length / hop summaries.
+// Until a whole window has gone by, the summaries cover however long it's been.
+template <typename T>
+class SlidingWindow : public EventStream<WindowAggregate<T>>, public ClockListener {
+  private:
+    TickClock* _clock;
+    size_t _slot;
+    unsigned long _hop;
+    bool _emitEmpty;
+    // The hops that have finished, oldest first.
+    RingBuffer<WindowAggregate<T>> _panes;
+    WindowAggregate<T> _current;
+    Subscription _subscription;
+
+    void _pushPane(const WindowAggregate<T>& pane) {
+      if (_panes.full()) {
+        _panes.pop();
+      }
+      _panes.push(pane);
+    }
+
+  public:
+    SlidingWindow(
+      EventStream<T>* wrappedEventStream,
+      unsigned long length,
+      unsigned long hop,
+      TickClock* clock,
+      bool emitEmpty = false
+    )
+    :
+      _clock(clock),
+      _hop(hop),
+      _emitEmpty(emitEmpty),
+      _panes(hop ? length / hop : 0),
+      _current(clock->nowMillis(), hop)
+    {
+      if (hop == 0 || length == 0) {
+        throw std::invalid_argument("Can't have a zero-length window or hop.");
+      }
+      if (length % hop != 0) {
+        throw std::invalid_argument("Length must be a multiple of hop.");
+      }
+      _slot = clock->addListener(this);
+      clock->wakeAt(_slot, _current.end());
+      _subscription = wrappedEventStream->registerSubscriber([this](const Event<T>& e) { _current.add(e.value); });
+    }
+
+    ~SlidingWindow() {
+      _clock->removeListener(_slot);
+      _subscription.cancel();
+    }
+
+    virtual void onClockDeadline(unsigned long now) {
+      _pushPane(_current);
+      unsigned long hopsPassed = (now - _current.start) / _hop;
+      unsigned long nextStart = _current.start + hopsPassed * _hop;
+      // The hops the clock missed were empty, but they still take up room in the window.
+      // Only the ones that'll fit matter.
+      unsigned long firstMissed = hopsPassed > _panes.capacity() ? hopsPassed - _panes.capacity() : 1;
+      for (unsigned long i = firstMissed; i < hopsPassed; i ++) {
+        _pushPane(WindowAggregate<T>(_current.start + i * _hop, _hop));
+      }
+
+      WindowAggregate<T> window = _panes.front();
+      for (size_t i = 1; i < _panes.size(); i ++) {
+        window.merge(_panes.at(i));
+      }
+      if (window.count || _emitEmpty) {
+        this->_emit(Event<WindowAggregate<T>>(window.end(), window));
+      }
+
+      _current = WindowAggregate<T>(nextStart, _hop);
+      _clock->wakeAt(_slot, _current.end());
+    }
+};
+
+#endif
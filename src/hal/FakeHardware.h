@@ -0,0 +1,241 @@
+#ifndef RHEOSCAPE_FAKE_HARDWARE_H
+#define RHEOSCAPE_FAKE_HARDWARE_H
+
+#ifdef PLATFORM_DEV_MACHINE
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include <Histogram.h>
+#include <Runnable.h>
+#include <Timer.h>
+
+// Pretend hardware for the dev machine.
+// The headers in hal/native/ stand in for Arduino.h, Wire.h, SPI.h, OneWire.h and the sensor libraries,
+// and they all talk to this instead of real pins and buses.
+// That lets the real drivers in input/ and output/ run in native tests.
+//
+// Every pin access and bus transaction is charged to a FakeBus,
+// using roughly how long it'd take on the real thing,
+// so you can see how much bus time each driver burns per tick.
+// If you want the sim clock to move forward by that much too, call FakeHardware::setTransactionsTakeTime(true).
+
+struct FakePin {
+  uint8_t mode;
+  // What digitalRead() sees and what digitalWrite() last set.
+  bool level;
+  // What analogRead() returns.
+  uint16_t analogValue;
+  // What analogWrite() last set.
+  int analogWriteValue;
+  // How many times digitalWrite() has actually changed the level, e.g., to count relay clicks.
+  uint32_t transitions;
+};
+
+class FakeBus {
+  private:
+    const char* _name;
+    uint64_t _busyNanos;
+    uint32_t _transactions;
+
+  public:
+    FakeBus(const char* name)
+    :
+      _name(name),
+      _busyNanos(0),
+      _transactions(0)
+    { }
+
+    // Defined below FakeHardware, because it needs to know whether transactions take time.
+    void transact(uint64_t nanos);
+
+    const char* getName() const { return _name; }
+    uint64_t getBusyNanos() const { return _busyNanos; }
+    unsigned long getBusyMicros() const { return (unsigned long)(_busyNanos / 1000); }
+    uint32_t getTransactions() const { return _transactions; }
+
+    void reset() {
+      _busyNanos = 0;
+      _transactions = 0;
+    }
+};
+
+// One DS18B20 on a OneWire bus.
+// Like the real thing, it only updates its scratchpad once a conversion finishes,
+// and the scratchpad reads 85°C until the first one does.
+struct FakeDs18b20 {
+  uint64_t address;
+  float tempC;
+  bool connected;
+  float scratchpadTempC;
+  float pendingTempC;
+  unsigned long conversionReadyAt;
+  bool conversionPending;
+
+  FakeDs18b20(uint64_t address, float tempC)
+  :
+    address(address),
+    tempC(tempC),
+    connected(true),
+    scratchpadTempC(85.0f),
+    pendingTempC(85.0f),
+    conversionReadyAt(0),
+    conversionPending(false)
+  { }
+
+  void startConversion(unsigned long now, unsigned long conversionTime) {
+    pendingTempC = tempC;
+    conversionReadyAt = now + conversionTime;
+    conversionPending = true;
+  }
+
+  float readScratchpad(unsigned long now) {
+    if (conversionPending && (long)(now - conversionReadyAt) >= 0) {
+      scratchpadTempC = pendingTempC;
+      conversionPending = false;
+    }
+    return scratchpadTempC;
+  }
+};
+
+// The physical world that the fake sensors measure.
+struct FakeEnvironment {
+  float airTempC = 20.0f;
+  float humidity = 50.0f;
+  float pressureMbar = 1013.25f;
+  float thermocoupleTempC = 20.0f;
+  bool thermocoupleOpen = false;
+  // Keyed by the OneWire bus's pin.
+  std::map<uint8_t, std::vector<FakeDs18b20>> oneWireDevices;
+};
+
+class FakeHardware {
+  private:
+    inline static std::array<FakePin, 64> _pins;
+    inline static FakeBus _gpio = FakeBus("gpio");
+    inline static FakeBus _i2c = FakeBus("i2c");
+    inline static FakeBus _spi = FakeBus("spi");
+    inline static FakeBus _oneWire = FakeBus("one_wire");
+    inline static FakeEnvironment _environment;
+    inline static bool _transactionsTakeTime = false;
+    inline static uint64_t _unspentNanos = 0;
+    inline static uint32_t _i2cClockHz = 100000;
+    inline static uint32_t _spiClockHz = 4000000;
+
+  public:
+    // A register write on the ESP32 is well under a microsecond;
+    // the Arduino wrappers around it are what cost.
+    static constexpr uint64_t gpioNanos = 150;
+    static constexpr uint64_t analogReadNanos = 20000;
+    static constexpr uint64_t analogWriteNanos = 2000;
+    // OneWire's standard speed slots, from Maxim's app note 126.
+    static constexpr uint64_t oneWireResetNanos = 960000;
+    static constexpr uint64_t oneWireSlotNanos = 65000;
+    static constexpr uint64_t oneWireByteNanos = 8 * oneWireSlotNanos;
+    // A search reads two bits and writes one for each of the 64 address bits.
+    static constexpr uint64_t oneWireSearchNanos = oneWireResetNanos + oneWireByteNanos + 64 * 3 * oneWireSlotNanos;
+
+    static FakePin& pin(uint8_t number) { return _pins.at(number); }
+    static FakeBus& gpio() { return _gpio; }
+    static FakeBus& i2c() { return _i2c; }
+    static FakeBus& spi() { return _spi; }
+    static FakeBus& oneWire() { return _oneWire; }
+    static FakeEnvironment& environment() { return _environment; }
+
+    static std::vector<FakeDs18b20>& oneWireDevices(uint8_t pin) {
+      return _environment.oneWireDevices[pin];
+    }
+
+    static FakeDs18b20* findOneWireDevice(uint8_t pin, uint64_t address) {
+      for (FakeDs18b20& device : oneWireDevices(pin)) {
+        if (device.address == address) {
+          return &device;
+        }
+      }
+      return nullptr;
+    }
+
+    static void setTransactionsTakeTime(bool takeTime) {
+      _transactionsTakeTime = takeTime;
+      _unspentNanos = 0;
+    }
+
+    static bool transactionsTakeTime() {
+      return _transactionsTakeTime && Timekeeper::getSource() == TimekeeperSource::simTime;
+    }
+
+    // Let the sim clock catch up with bus time, a whole microsecond at a time.
+    static void spendNanos(uint64_t nanos) {
+      _unspentNanos += nanos;
+      if (_unspentNanos >= 1000) {
+        Timekeeper::tickMicros(_unspentNanos / 1000);
+        _unspentNanos %= 1000;
+      }
+    }
+
+    static void setI2cClock(uint32_t hz) { _i2cClockHz = hz; }
+    static void setSpiClock(uint32_t hz) { _spiClockHz = hz; }
+
+    // START, address byte, the payload, and STOP; every byte is nine clocks including the ACK.
+    static uint64_t i2cNanos(size_t bytes) {
+      return ((uint64_t)(bytes + 1) * 9 + 2) * 1000000000ULL / _i2cClockHz;
+    }
+
+    // The payload plus a microsecond of chip select setup and hold.
+    static uint64_t spiNanos(size_t bytes) {
+      return (uint64_t)bytes * 8 * 1000000000ULL / _spiClockHz + 1000;
+    }
+
+    // Put every pin, bus and environment value back to how it was at power-on.
+    static void reset() {
+      _pins.fill(FakePin { 0, false, 0, 0, 0 });
+      _gpio.reset();
+      _i2c.reset();
+      _spi.reset();
+      _oneWire.reset();
+      _environment = FakeEnvironment();
+      _transactionsTakeTime = false;
+      _unspentNanos = 0;
+      _i2cClockHz = 100000;
+      _spiClockHz = 4000000;
+    }
+};
+
+inline void FakeBus::transact(uint64_t nanos) {
+  _transactions ++;
+  _busyNanos += nanos;
+  if (FakeHardware::transactionsTakeTime()) {
+    FakeHardware::spendNanos(nanos);
+  }
+}
+
+// Records how many microseconds a bus was busy during each pass through the Runner.
+class FakeBusTimeMonitor : public TickObserver {
+  private:
+    FakeBus* _bus;
+    uint64_t _busyAtTickStart;
+    LogBucketHistogram _perTick;
+
+  public:
+    FakeBusTimeMonitor(FakeBus* bus)
+    :
+      _bus(bus),
+      _busyAtTickStart(0)
+    { }
+
+    virtual void beforeTick() {
+      _busyAtTickStart = _bus->getBusyNanos();
+    }
+
+    virtual void afterTick() {
+      _perTick.record((uint32_t)((_bus->getBusyNanos() - _busyAtTickStart) / 1000));
+    }
+
+    const LogBucketHistogram& getPerTickMicros() const { return _perTick; }
+};
+
+#endif
+
+#endif
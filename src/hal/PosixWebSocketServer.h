@@ -0,0 +1,547 @@
+#ifndef RHEOSCAPE_POSIX_WEB_SOCKET_SERVER_H
+#define RHEOSCAPE_POSIX_WEB_SOCKET_SERVER_H
+
+#ifdef PLATFORM_DEV_MACHINE
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <StateServer.h>
+
+// Just enough SHA-1 and base64 for a websocket handshake.
+namespace websocket_handshake {
+  inline uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+  }
+
+  inline std::string sha1(const std::string& message) {
+    uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    std::string padded = message;
+    padded += (char)0x80;
+    while (padded.size() % 64 != 56) {
+      padded += (char)0;
+    }
+    uint64_t bitLength = (uint64_t)message.size() * 8;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      padded += (char)(bitLength >> shift);
+    }
+
+    for (size_t chunk = 0; chunk < padded.size(); chunk += 64) {
+      uint32_t w[80];
+      for (int i = 0; i < 16; i ++) {
+        const uint8_t* word = (const uint8_t*)padded.data() + chunk + i * 4;
+        w[i] = (uint32_t)word[0] << 24 | (uint32_t)word[1] << 16 | (uint32_t)word[2] << 8 | word[3];
+      }
+      for (int i = 16; i < 80; i ++) {
+        w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+      }
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+      for (int i = 0; i < 80; i ++) {
+        uint32_t f, k;
+        if (i < 20) {
+          f = (b & c) | (~b & d);
+          k = 0x5a827999;
+        } else if (i < 40) {
+          f = b ^ c ^ d;
+          k = 0x6ed9eba1;
+        } else if (i < 60) {
+          f = (b & c) | (b & d) | (c & d);
+          k = 0x8f1bbcdc;
+        } else {
+          f = b ^ c ^ d;
+          k = 0xca62c1d6;
+        }
+        uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotateLeft(b, 30);
+        b = a;
+        a = temp;
+      }
+      h[0] += a;
+      h[1] += b;
+      h[2] += c;
+      h[3] += d;
+      h[4] += e;
+    }
+
+    std::string digest;
+    for (uint32_t word : h) {
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        digest += (char)(word >> shift);
+      }
+    }
+    return digest;
+  }
+
+  inline std::string base64(const std::string& bytes) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded;
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+      uint32_t group = (uint8_t)bytes[i] << 16;
+      if (i + 1 < bytes.size()) group |= (uint8_t)bytes[i + 1] << 8;
+      if (i + 2 < bytes.size()) group |= (uint8_t)bytes[i + 2];
+      encoded += alphabet[(group >> 18) & 0x3f];
+      encoded += alphabet[(group >> 12) & 0x3f];
+      encoded += i + 1 < bytes.size() ? alphabet[(group >> 6) & 0x3f] : '=';
+      encoded += i + 2 < bytes.size() ? alphabet[group & 0x3f] : '=';
+    }
+    return encoded;
+  }
+
+  // What goes in the Sec-WebSocket-Accept header for a client's Sec-WebSocket-Key.
+  inline std::string acceptKey(const std::string& clientKey) {
+    return base64(sha1(clientKey + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+  }
+}
+
+// A websocket server on plain POSIX sockets, so that StateServer can be run and load-tested on a dev machine
+// the same way it runs behind ESPAsyncWebServer on the ESP32.
+//
+// It serves the same URLs as webServer.h does for the state:
+// /ws (with ?encoding=msgpack if you want it) and GET /allState. Everything else is a 404.
+// Text messages from clients go to the message handler, which is where receiveStateMessage() goes.
+//
+// Everything happens on one thread, like AsyncTCP's task does on the ESP32;
+// StateServer::publish() gets called from whichever thread stands in for the loop.
+// Like AsyncTCP, each client has a short queue of messages waiting to go out,
+// and a client with a full queue isn't ready for any more,
+// so a slow client exercises the outboxes the same way it would on the real thing.
+class PosixWebSocketServer : public WebSocketTransport {
+  public:
+    typedef std::function<void(uint32_t clientId, const char* data, size_t length)> MessageHandler;
+
+  private:
+    struct Connection {
+      int fd;
+      bool isWebSocket;
+      // Once everything queued has gone out, hang up; for plain HTTP responses and close frames.
+      bool closeWhenSent;
+      std::string received;
+      // Messages get framed once and shared between every client they're going to.
+      std::deque<std::shared_ptr<const std::string>> queued;
+      size_t sentOfFront;
+    };
+
+    uint16_t _port;
+    size_t _maxQueued;
+    StateServer* _stateServer;
+    MessageHandler _onMessage;
+
+    int _listenFd;
+    int _wakeFds[2];
+    std::atomic<bool> _running;
+    std::thread _thread;
+
+    // Guards the connections' send queues, and the map itself when connections come and go;
+    // everything else about a connection is only touched by the server thread.
+    std::mutex _connectionsMutex;
+    std::map<uint32_t, std::unique_ptr<Connection>> _connections;
+    uint32_t _nextClientId;
+
+    static std::shared_ptr<const std::string> _frame(const uint8_t* payload, size_t length, uint8_t opcode) {
+      std::string frame;
+      frame.reserve(length + 10);
+      frame += (char)(0x80 | opcode);
+      if (length < 126) {
+        frame += (char)length;
+      } else if (length <= 0xffff) {
+        frame += (char)126;
+        frame += (char)(length >> 8);
+        frame += (char)length;
+      } else {
+        frame += (char)127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+          frame += (char)((uint64_t)length >> shift);
+        }
+      }
+      frame.append((const char*)payload, length);
+      return std::make_shared<const std::string>(std::move(frame));
+    }
+
+    void _wake() {
+      char wake = 0;
+      ssize_t ignored = write(_wakeFds[1], &wake, 1);
+      (void)ignored;
+    }
+
+    void _queue(Connection* connection, std::shared_ptr<const std::string> data, bool thenClose = false) {
+      std::lock_guard<std::mutex> lock(_connectionsMutex);
+      connection->queued.push_back(data);
+      connection->closeWhenSent = connection->closeWhenSent || thenClose;
+    }
+
+    void _respond(Connection* connection, const char* status, const char* contentType, const std::string& body) {
+      std::string response = std::string("HTTP/1.1 ") + status + "\r\n"
+        + "Content-Type: " + contentType + "\r\n"
+        + "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        + "Connection: close\r\n\r\n"
+        + body;
+      _queue(connection, std::make_shared<const std::string>(std::move(response)), true);
+    }
+
+    static std::string _header(const std::string& request, const char* name) {
+      size_t lineStart = request.find("\r\n");
+      size_t nameLength = strlen(name);
+      while (lineStart != std::string::npos) {
+        lineStart += 2;
+        size_t lineEnd = request.find("\r\n", lineStart);
+        if (lineEnd == std::string::npos || lineEnd == lineStart) {
+          break;
+        }
+        if (lineEnd - lineStart > nameLength && request[lineStart + nameLength] == ':' && strncasecmp(request.data() + lineStart, name, nameLength) == 0) {
+          size_t valueStart = request.find_first_not_of(' ', lineStart + nameLength + 1);
+          return request.substr(valueStart, lineEnd - valueStart);
+        }
+        lineStart = lineEnd;
+      }
+      return "";
+    }
+
+    // Returns false if the connection should be dropped.
+    bool _receiveHttp(uint32_t id, Connection* connection) {
+      size_t headersEnd = connection->received.find("\r\n\r\n");
+      if (headersEnd == std::string::npos) {
+        return connection->received.size() < 8192;
+      }
+      std::string request = connection->received.substr(0, headersEnd + 2);
+      connection->received.erase(0, headersEnd + 4);
+
+      size_t pathStart = request.find(' ');
+      size_t pathEnd = pathStart == std::string::npos ? std::string::npos : request.find(' ', pathStart + 1);
+      if (pathEnd == std::string::npos || request.compare(0, pathStart, "GET") != 0) {
+        _respond(connection, "405 Method Not Allowed", "text/plain", "");
+        return true;
+      }
+      std::string target = request.substr(pathStart + 1, pathEnd - pathStart - 1);
+      std::string path = target.substr(0, target.find('?'));
+      std::string query = path.size() < target.size() ? target.substr(path.size() + 1) : "";
+
+      std::string clientKey = _header(request, "Sec-WebSocket-Key");
+      if (path == "/ws" && !clientKey.empty()) {
+        std::string response = "HTTP/1.1 101 Switching Protocols\r\n"
+          "Upgrade: websocket\r\n"
+          "Connection: Upgrade\r\n"
+          "Sec-WebSocket-Accept: " + websocket_handshake::acceptKey(clientKey) + "\r\n\r\n";
+        {
+          std::lock_guard<std::mutex> lock(_connectionsMutex);
+          connection->queued.push_back(std::make_shared<const std::string>(std::move(response)));
+          connection->isWebSocket = true;
+        }
+        WebSocketEncoding encoding = ("&" + query + "&").find("&encoding=msgpack&") != std::string::npos
+          ? WebSocketEncoding::msgpack
+          : WebSocketEncoding::json;
+        _stateServer->connect(id, encoding);
+        return true;
+      }
+      if (path == "/allState") {
+        _respond(connection, "200 OK", "text/json", *_stateServer->getAllState());
+        return true;
+      }
+      _respond(connection, "404 Not Found", "text/plain", "");
+      return true;
+    }
+
+    // Clients have to mask their frames. Fragmented messages get dropped, like they do on the ESP32.
+    bool _receiveFrames(uint32_t id, Connection* connection) {
+      std::string& received = connection->received;
+      while (received.size() >= 2) {
+        const uint8_t* bytes = (const uint8_t*)received.data();
+        bool final = bytes[0] & 0x80;
+        uint8_t opcode = bytes[0] & 0x0f;
+        bool masked = bytes[1] & 0x80;
+        uint64_t length = bytes[1] & 0x7f;
+        size_t headerLength = 2;
+        if (length == 126) {
+          headerLength = 4;
+        } else if (length == 127) {
+          headerLength = 10;
+        }
+        if (!masked) {
+          return false;
+        }
+        if (received.size() < headerLength + 4) {
+          return true;
+        }
+        if (headerLength == 4) {
+          length = (uint64_t)bytes[2] << 8 | bytes[3];
+        } else if (headerLength == 10) {
+          length = 0;
+          for (int i = 2; i < 10; i ++) {
+            length = length << 8 | bytes[i];
+          }
+        }
+        if (length > 65536) {
+          return false;
+        }
+        if (received.size() < headerLength + 4 + length) {
+          return true;
+        }
+        const uint8_t* mask = bytes + headerLength;
+        std::string payload = received.substr(headerLength + 4, length);
+        for (size_t i = 0; i < payload.size(); i ++) {
+          payload[i] ^= mask[i % 4];
+        }
+        received.erase(0, headerLength + 4 + length);
+
+        if (opcode == 0x1 && final) {
+          if (_onMessage) {
+            _onMessage(id, payload.data(), payload.size());
+          }
+        } else if (opcode == 0x8) {
+          _queue(connection, _frame((const uint8_t*)payload.data(), std::min<size_t>(payload.size(), 2), 0x8), true);
+        } else if (opcode == 0x9) {
+          _queue(connection, _frame((const uint8_t*)payload.data(), payload.size(), 0xa));
+        }
+      }
+      return true;
+    }
+
+    // Returns false if the connection should be dropped.
+    bool _receive(uint32_t id, Connection* connection) {
+      char buffer[4096];
+      ssize_t count = recv(connection->fd, buffer, sizeof(buffer), 0);
+      if (count <= 0) {
+        return false;
+      }
+      connection->received.append(buffer, count);
+      if (!connection->isWebSocket && !_receiveHttp(id, connection)) {
+        return false;
+      }
+      return !connection->isWebSocket || _receiveFrames(id, connection);
+    }
+
+    // Returns false if the connection should be dropped.
+    bool _flush(Connection* connection) {
+      std::lock_guard<std::mutex> lock(_connectionsMutex);
+      while (!connection->queued.empty()) {
+        const std::string& front = *connection->queued.front();
+        ssize_t count = ::send(connection->fd, front.data() + connection->sentOfFront, front.size() - connection->sentOfFront, MSG_NOSIGNAL);
+        if (count < 0) {
+          return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection->sentOfFront += count;
+        if (connection->sentOfFront < front.size()) {
+          return true;
+        }
+        connection->queued.pop_front();
+        connection->sentOfFront = 0;
+      }
+      return !connection->closeWhenSent;
+    }
+
+    void _drop(uint32_t id) {
+      bool wasWebSocket;
+      {
+        std::lock_guard<std::mutex> lock(_connectionsMutex);
+        auto found = _connections.find(id);
+        close(found->second->fd);
+        wasWebSocket = found->second->isWebSocket;
+        _connections.erase(found);
+      }
+      if (wasWebSocket) {
+        _stateServer->disconnect(id);
+      }
+    }
+
+    void _accept() {
+      int fd = accept(_listenFd, nullptr, nullptr);
+      if (fd < 0) {
+        return;
+      }
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      int noDelay = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+      std::lock_guard<std::mutex> lock(_connectionsMutex);
+      _connections[_nextClientId ++] = std::unique_ptr<Connection>(new Connection { fd, false, false, "", {}, 0 });
+    }
+
+    void _serve() {
+      std::vector<pollfd> fds;
+      std::vector<uint32_t> ids;
+      while (_running) {
+        fds.clear();
+        ids.clear();
+        fds.push_back({ _listenFd, POLLIN, 0 });
+        fds.push_back({ _wakeFds[0], POLLIN, 0 });
+        {
+          std::lock_guard<std::mutex> lock(_connectionsMutex);
+          for (auto const& [id, connection] : _connections) {
+            short events = POLLIN;
+            if (!connection->queued.empty()) {
+              events |= POLLOUT;
+            }
+            fds.push_back({ connection->fd, events, 0 });
+            ids.push_back(id);
+          }
+        }
+        if (poll(fds.data(), fds.size(), 100) <= 0) {
+          continue;
+        }
+        if (fds[1].revents & POLLIN) {
+          char drained[64];
+          while (read(_wakeFds[0], drained, sizeof(drained)) == sizeof(drained)) { }
+        }
+        for (size_t i = 0; i < ids.size(); i ++) {
+          short revents = fds[i + 2].revents;
+          if (!revents) {
+            continue;
+          }
+          Connection* connection = _connections.find(ids[i])->second.get();
+          bool keep = true;
+          if (revents & (POLLIN | POLLHUP | POLLERR)) {
+            keep = _receive(ids[i], connection);
+          }
+          if (keep) {
+            keep = _flush(connection);
+          }
+          if (!keep) {
+            _drop(ids[i]);
+          }
+        }
+        if (fds[0].revents & POLLIN) {
+          _accept();
+        }
+      }
+    }
+
+  public:
+    // Port 0 gets any free one; see getPort().
+    // maxQueued is how many messages a client can have waiting to go out before it isn't ready for more.
+    PosixWebSocketServer(uint16_t port = 0, size_t maxQueued = 4)
+    :
+      _port(port),
+      _maxQueued(maxQueued),
+      _stateServer(nullptr),
+      _listenFd(-1),
+      _wakeFds{ -1, -1 },
+      _running(false),
+      _nextClientId(1)
+    { }
+
+    ~PosixWebSocketServer() {
+      stop();
+    }
+
+    // They need each other, so this can't go in the constructor.
+    void setStateServer(StateServer* stateServer) {
+      _stateServer = stateServer;
+    }
+
+    void onMessage(MessageHandler handler) {
+      _onMessage = handler;
+    }
+
+    void begin() {
+      if (_stateServer == nullptr) {
+        throw std::invalid_argument("PosixWebSocketServer needs a StateServer before it can begin");
+      }
+      _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+      int reuse = 1;
+      setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+      sockaddr_in address {};
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      address.sin_port = htons(_port);
+      if (bind(_listenFd, (sockaddr*)&address, sizeof(address)) != 0 || listen(_listenFd, 128) != 0) {
+        close(_listenFd);
+        throw std::runtime_error("PosixWebSocketServer couldn't listen on its port");
+      }
+      socklen_t addressLength = sizeof(address);
+      getsockname(_listenFd, (sockaddr*)&address, &addressLength);
+      _port = ntohs(address.sin_port);
+      if (pipe(_wakeFds) != 0) {
+        throw std::runtime_error("PosixWebSocketServer couldn't make its wakeup pipe");
+      }
+      fcntl(_wakeFds[0], F_SETFL, fcntl(_wakeFds[0], F_GETFL) | O_NONBLOCK);
+      fcntl(_wakeFds[1], F_SETFL, fcntl(_wakeFds[1], F_GETFL) | O_NONBLOCK);
+      _running = true;
+      _thread = std::thread([this]() { _serve(); });
+    }
+
+    void stop() {
+      if (!_running) {
+        return;
+      }
+      _running = false;
+      _wake();
+      _thread.join();
+      std::vector<uint32_t> ids;
+      for (auto const& [id, connection] : _connections) {
+        ids.push_back(id);
+      }
+      for (uint32_t id : ids) {
+        _drop(id);
+      }
+      close(_listenFd);
+      close(_wakeFds[0]);
+      close(_wakeFds[1]);
+    }
+
+    uint16_t getPort() const {
+      return _port;
+    }
+
+    // How much CPU time the server thread has used, for working out what each client costs.
+    uint64_t getCpuNanos() {
+      clockid_t clock;
+      timespec time;
+      if (!_running || pthread_getcpuclockid(_thread.native_handle(), &clock) != 0 || clock_gettime(clock, &time) != 0) {
+        return 0;
+      }
+      return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+    }
+
+    bool isReady(uint32_t clientId) {
+      std::lock_guard<std::mutex> lock(_connectionsMutex);
+      auto found = _connections.find(clientId);
+      return found != _connections.end()
+        && found->second->isWebSocket
+        && !found->second->closeWhenSent
+        && found->second->queued.size() < _maxQueued;
+    }
+
+    size_t send(const std::vector<uint32_t>& clientIds, const uint8_t* message, size_t length, bool binary) {
+      std::shared_ptr<const std::string> frame = _frame(message, length, binary ? 0x2 : 0x1);
+      size_t bytesSent = 0;
+      {
+        std::lock_guard<std::mutex> lock(_connectionsMutex);
+        for (uint32_t id : clientIds) {
+          auto found = _connections.find(id);
+          if (found == _connections.end() || !found->second->isWebSocket) {
+            continue;
+          }
+          found->second->queued.push_back(frame);
+          bytesSent += length;
+        }
+      }
+      _wake();
+      return bytesSent;
+    }
+};
+
+#endif
+
+#endif
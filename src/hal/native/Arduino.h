@@ -0,0 +1,121 @@
+#ifndef RHEOSCAPE_FAKE_ARDUINO_H
+#define RHEOSCAPE_FAKE_ARDUINO_H
+
+// Just enough of the Arduino core for the drivers in input/ and output/ to build and run on the dev machine.
+// Pins live in FakeHardware, and time comes from Timekeeper, so sim time works the same for drivers as it does for everything else.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include <hal/FakeHardware.h>
+
+#define LOW 0x0
+#define HIGH 0x1
+
+// The ESP32 core's pin modes.
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+typedef uint8_t byte;
+
+// Like the ESP32 core, so that e.g. abs() works on floats.
+using std::abs;
+using std::isinf;
+using std::isnan;
+using std::max;
+using std::min;
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  FakePin& fakePin = FakeHardware::pin(pin);
+  fakePin.mode = mode;
+  // An unconnected pin floats to wherever its pull resistor takes it.
+  if (mode == INPUT_PULLUP) {
+    fakePin.level = HIGH;
+  } else if (mode == INPUT_PULLDOWN) {
+    fakePin.level = LOW;
+  }
+  FakeHardware::gpio().transact(FakeHardware::gpioNanos);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+  FakePin& fakePin = FakeHardware::pin(pin);
+  if (fakePin.level != (bool)value) {
+    fakePin.level = value;
+    fakePin.transitions ++;
+  }
+  FakeHardware::gpio().transact(FakeHardware::gpioNanos);
+}
+
+inline int digitalRead(uint8_t pin) {
+  FakeHardware::gpio().transact(FakeHardware::gpioNanos);
+  return FakeHardware::pin(pin).level ? HIGH : LOW;
+}
+
+inline uint16_t analogRead(uint8_t pin) {
+  FakeHardware::gpio().transact(FakeHardware::analogReadNanos);
+  return FakeHardware::pin(pin).analogValue;
+}
+
+inline void analogReadResolution(uint8_t bits) { }
+
+inline void analogWrite(uint8_t pin, int value) {
+  FakeHardware::pin(pin).analogWriteValue = value;
+  FakeHardware::gpio().transact(FakeHardware::analogWriteNanos);
+}
+
+inline unsigned long millis() {
+  return Timekeeper::nowMillis();
+}
+
+inline unsigned long micros() {
+  return Timekeeper::nowMicros();
+}
+
+// In sim time, waiting just moves the clock along.
+inline void delay(unsigned long ms) {
+  if (Timekeeper::getSource() == TimekeeperSource::simTime) {
+    Timekeeper::tick(ms);
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  if (Timekeeper::getSource() == TimekeeperSource::simTime) {
+    Timekeeper::tickMicros(us);
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+}
+
+class FakeSerial {
+  public:
+    void begin(unsigned long baud) { }
+
+    template <typename T>
+    void print(T value) {
+      std::cout << value;
+    }
+
+    template <typename T>
+    void println(T value) {
+      std::cout << value << std::endl;
+    }
+
+    void println() {
+      std::cout << std::endl;
+    }
+};
+
+inline FakeSerial Serial;
+
+#endif
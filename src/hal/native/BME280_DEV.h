@@ -0,0 +1,154 @@
+#ifndef RHEOSCAPE_FAKE_BME280_DEV_H
+#define RHEOSCAPE_FAKE_BME280_DEV_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+
+#define SLEEP_MODE 0x00
+#define FORCED_MODE 0x01
+#define NORMAL_MODE 0x03
+
+#define OVERSAMPLING_SKIP 0x00
+#define OVERSAMPLING_X1 0x01
+#define OVERSAMPLING_X2 0x02
+#define OVERSAMPLING_X4 0x03
+#define OVERSAMPLING_X8 0x04
+#define OVERSAMPLING_X16 0x05
+
+#define IIR_FILTER_OFF 0x00
+#define IIR_FILTER_2 0x01
+#define IIR_FILTER_4 0x02
+#define IIR_FILTER_8 0x03
+#define IIR_FILTER_16 0x04
+
+#define TIME_STANDBY_05MS 0x00
+#define TIME_STANDBY_62MS 0x01
+#define TIME_STANDBY_125MS 0x02
+#define TIME_STANDBY_250MS 0x03
+#define TIME_STANDBY_500MS 0x04
+#define TIME_STANDBY_1000MS 0x05
+#define TIME_STANDBY_10MS 0x06
+#define TIME_STANDBY_20MS 0x07
+
+// A BME280 that measures FakeHardware::environment().
+// Like the real thing, in forced mode it takes one measurement and goes back to sleep,
+// so you have to start another conversion to get a fresh reading.
+class BME280_DEV {
+  private:
+    bool _spi;
+    uint8_t _mode;
+    uint8_t _presOversampling;
+    uint8_t _tempOversampling;
+    uint8_t _humOversampling;
+    unsigned long _measurementStart;
+
+    void _charge(size_t bytes) {
+      if (_spi) {
+        FakeHardware::spi().transact(FakeHardware::spiNanos(bytes));
+      } else {
+        FakeHardware::i2c().transact(FakeHardware::i2cNanos(bytes));
+      }
+    }
+
+    static unsigned long _oversamplingMultiple(uint8_t oversampling) {
+      return oversampling == OVERSAMPLING_SKIP ? 0 : 1 << (oversampling - 1);
+    }
+
+    // The datasheet's typical measurement time (section 9.1), rounded up to a whole millisecond.
+    unsigned long _measurementMillis() {
+      float ms = 1.0f + 2.0f * _oversamplingMultiple(_tempOversampling);
+      if (_presOversampling != OVERSAMPLING_SKIP) {
+        ms += 2.0f * _oversamplingMultiple(_presOversampling) + 0.5f;
+      }
+      if (_humOversampling != OVERSAMPLING_SKIP) {
+        ms += 2.0f * _oversamplingMultiple(_humOversampling) + 0.5f;
+      }
+      return (unsigned long)std::ceil(ms);
+    }
+
+    void _startMeasuring() {
+      _measurementStart = Timekeeper::nowMillis();
+    }
+
+  public:
+    BME280_DEV(TwoWire& twoWire)
+    :
+      _spi(false),
+      _mode(SLEEP_MODE),
+      _presOversampling(OVERSAMPLING_X1),
+      _tempOversampling(OVERSAMPLING_X1),
+      _humOversampling(OVERSAMPLING_X1),
+      _measurementStart(0)
+    { }
+
+    BME280_DEV(uint8_t cs, uint8_t spiPort, SPIClass& spiClass)
+    :
+      _spi(true),
+      _mode(SLEEP_MODE),
+      _presOversampling(OVERSAMPLING_X1),
+      _tempOversampling(OVERSAMPLING_X1),
+      _humOversampling(OVERSAMPLING_X1),
+      _measurementStart(0)
+    { }
+
+    // Reads the chip ID and calibration data, then writes the config registers.
+    uint8_t begin(
+      uint8_t mode = SLEEP_MODE,
+      uint8_t presOversampling = OVERSAMPLING_X16,
+      uint8_t tempOversampling = OVERSAMPLING_X2,
+      uint8_t humOversampling = OVERSAMPLING_X1,
+      uint8_t iirFilter = IIR_FILTER_OFF,
+      uint8_t timeStandby = TIME_STANDBY_05MS
+    ) {
+      _charge(2);
+      _charge(26);
+      _charge(8);
+      _charge(6);
+      _presOversampling = presOversampling;
+      _tempOversampling = tempOversampling;
+      _humOversampling = humOversampling;
+      _mode = mode;
+      if (_mode != SLEEP_MODE) {
+        _startMeasuring();
+      }
+      return 1;
+    }
+
+    uint8_t startForcedConversion() {
+      if (_mode == SLEEP_MODE) {
+        _charge(2);
+        _mode = FORCED_MODE;
+        _startMeasuring();
+        return 1;
+      }
+      return 0;
+    }
+
+    void stopConversion() {
+      _charge(2);
+      _mode = SLEEP_MODE;
+    }
+
+    // Reads the status register, and if a measurement's ready, the eight data registers.
+    uint8_t getMeasurements(float& temperature, float& pressure, float& humidity, float& altitude) {
+      _charge(2);
+      if (_mode == SLEEP_MODE || Timekeeper::nowMillis() - _measurementStart < _measurementMillis()) {
+        return 0;
+      }
+      _charge(9);
+      FakeEnvironment& environment = FakeHardware::environment();
+      temperature = environment.airTempC;
+      pressure = environment.pressureMbar;
+      humidity = environment.humidity;
+      altitude = 44330.0f * (1.0f - std::pow(pressure / 1013.23f, 0.1903f));
+      if (_mode == FORCED_MODE) {
+        _mode = SLEEP_MODE;
+      } else {
+        _startMeasuring();
+      }
+      return 1;
+    }
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef RHEOSCAPE_FAKE_DALLAS_TEMPERATURE_H
+#define RHEOSCAPE_FAKE_DALLAS_TEMPERATURE_H
+
+#include <Arduino.h>
+#include <OneWire.h>
+
+typedef uint8_t DeviceAddress[8];
+
+#define DEVICE_DISCONNECTED_C -127
+
+// Talks to the FakeDs18b20s on a fake OneWire bus.
+// Bus time is charged the way the real library spends it:
+// a reset and a ROM command for every transaction, plus the scratchpad bytes.
+class DallasTemperature {
+  private:
+    OneWire* _wire;
+    uint8_t _resolution;
+    bool _waitForConversion;
+
+    void _charge(size_t bytes) {
+      FakeHardware::oneWire().transact(FakeHardware::oneWireResetNanos + bytes * FakeHardware::oneWireByteNanos);
+    }
+
+  public:
+    DallasTemperature()
+    :
+      _wire(nullptr),
+      _resolution(9),
+      _waitForConversion(true)
+    { }
+
+    DallasTemperature(OneWire* wire)
+    :
+      _wire(wire),
+      _resolution(9),
+      _waitForConversion(true)
+    { }
+
+    void begin() { }
+
+    // Writes every device's config register; that's a match ROM, a write scratchpad, and three bytes each.
+    void setResolution(uint8_t resolution) {
+      _resolution = resolution;
+      if (_wire == nullptr) {
+        return;
+      }
+      size_t deviceCount = FakeHardware::oneWireDevices(_wire->getPin()).size();
+      for (size_t i = 0; i < deviceCount; i ++) {
+        _charge(13);
+      }
+    }
+
+    uint8_t getResolution() { return _resolution; }
+
+    void setWaitForConversion(bool wait) {
+      _waitForConversion = wait;
+    }
+
+    uint16_t millisToWaitForConversion() {
+      return 750 / (1 << (12 - _resolution));
+    }
+
+    // Skip ROM plus convert T, so every device starts converting at once.
+    void requestTemperatures() {
+      if (_wire == nullptr) {
+        return;
+      }
+      _charge(2);
+      unsigned long now = Timekeeper::nowMillis();
+      for (FakeDs18b20& device : FakeHardware::oneWireDevices(_wire->getPin())) {
+        if (device.connected) {
+          device.startConversion(now, millisToWaitForConversion());
+        }
+      }
+      if (_waitForConversion) {
+        delay(millisToWaitForConversion());
+      }
+    }
+
+    // Match ROM, read scratchpad, then nine bytes of scratchpad back.
+    float getTempC(const uint8_t* deviceAddress) {
+      if (_wire == nullptr) {
+        return DEVICE_DISCONNECTED_C;
+      }
+      _charge(19);
+      uint64_t address = 0;
+      for (uint8_t i = 0; i < 8; i ++) {
+        address |= (uint64_t)deviceAddress[i] << (i * 8);
+      }
+      FakeDs18b20* device = FakeHardware::findOneWireDevice(_wire->getPin(), address);
+      if (device == nullptr || !device->connected) {
+        return DEVICE_DISCONNECTED_C;
+      }
+      // Lower resolutions just leave the bottom bits of the reading undefined, i.e., zero.
+      float step = 0.5f / (1 << (_resolution - 9));
+      return std::floor(device->readScratchpad(Timekeeper::nowMillis()) / step) * step;
+    }
+};
+
+#endif
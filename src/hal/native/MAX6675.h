@@ -0,0 +1,45 @@
+#ifndef RHEOSCAPE_FAKE_MAX6675_H
+#define RHEOSCAPE_FAKE_MAX6675_H
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#define STATUS_OK 0x00
+#define STATUS_ERROR 0x04
+#define STATUS_NOREAD 0x80
+#define STATUS_NO_COMMUNICATION 0x81
+
+// A MAX6675 reading FakeHardware::environment()'s thermocouple.
+// It's always converting, so every read gets the latest value, in quarter degrees like the real chip.
+class MAX6675 {
+  private:
+    uint8_t _status;
+    float _temperature;
+
+  public:
+    MAX6675(uint8_t select, SPIClass* spi)
+    :
+      _status(STATUS_NOREAD),
+      _temperature(0)
+    { }
+
+    void begin() { }
+
+    // Sixteen bits, clocked out while chip select is low.
+    uint8_t read() {
+      FakeHardware::spi().transact(FakeHardware::spiNanos(2));
+      FakeEnvironment& environment = FakeHardware::environment();
+      if (environment.thermocoupleOpen) {
+        _status = STATUS_ERROR;
+      } else {
+        _status = STATUS_OK;
+        _temperature = std::floor(environment.thermocoupleTempC * 4) / 4;
+      }
+      return _status;
+    }
+
+    float getTemperature() { return _temperature; }
+    uint8_t getStatus() { return _status; }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef RHEOSCAPE_FAKE_ONE_WIRE_H
+#define RHEOSCAPE_FAKE_ONE_WIRE_H
+
+#include <Arduino.h>
+
+// A OneWire bus whose devices are the FakeDs18b20s attached to its pin in FakeHardware.
+class OneWire {
+  private:
+    uint8_t _pin;
+    size_t _searchIndex;
+
+  public:
+    OneWire(uint8_t pin)
+    :
+      _pin(pin),
+      _searchIndex(0)
+    { }
+
+    uint8_t getPin() const { return _pin; }
+
+    // Returns 1 if anything answered with a presence pulse.
+    uint8_t reset() {
+      FakeHardware::oneWire().transact(FakeHardware::oneWireResetNanos);
+      for (FakeDs18b20& device : FakeHardware::oneWireDevices(_pin)) {
+        if (device.connected) {
+          return 1;
+        }
+      }
+      return 0;
+    }
+
+    void reset_search() {
+      _searchIndex = 0;
+    }
+
+    bool search(uint8_t* newAddress, bool searchMode = true) {
+      std::vector<FakeDs18b20>& devices = FakeHardware::oneWireDevices(_pin);
+      FakeHardware::oneWire().transact(FakeHardware::oneWireSearchNanos);
+      while (_searchIndex < devices.size() && !devices[_searchIndex].connected) {
+        _searchIndex ++;
+      }
+      if (_searchIndex >= devices.size()) {
+        // Like the real library, start over on the next search.
+        _searchIndex = 0;
+        return false;
+      }
+      uint64_t address = devices[_searchIndex].address;
+      for (uint8_t i = 0; i < 8; i ++) {
+        newAddress[i] = address & 0xFF;
+        address >>= 8;
+      }
+      _searchIndex ++;
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef RHEOSCAPE_FAKE_SHT2X_H
+#define RHEOSCAPE_FAKE_SHT2X_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// An SHT21 that measures FakeHardware::environment(),
+// taking as long as the datasheet's worst case for each 14-bit temperature or 12-bit humidity reading.
+class SHT21 {
+  private:
+    static constexpr unsigned long _tempMillis = 85;
+    static constexpr unsigned long _humMillis = 29;
+
+    // 0 = nothing requested, 1 = temperature, 2 = humidity, like the real library.
+    uint8_t _requestType;
+    unsigned long _requestStart;
+    float _temperature;
+    float _humidity;
+
+    bool _ready(uint8_t requestType, unsigned long measurementMillis) {
+      return _requestType == requestType && Timekeeper::nowMillis() - _requestStart >= measurementMillis;
+    }
+
+    bool _request(uint8_t requestType) {
+      FakeHardware::i2c().transact(FakeHardware::i2cNanos(1));
+      _requestType = requestType;
+      _requestStart = Timekeeper::nowMillis();
+      return true;
+    }
+
+  public:
+    SHT21()
+    :
+      _requestType(0),
+      _requestStart(0),
+      _temperature(0),
+      _humidity(0)
+    { }
+
+    bool begin(TwoWire* wire = &Wire) {
+      // Soft reset.
+      FakeHardware::i2c().transact(FakeHardware::i2cNanos(1));
+      return true;
+    }
+
+    bool isConnected() {
+      FakeHardware::i2c().transact(FakeHardware::i2cNanos(0));
+      return true;
+    }
+
+    bool requestTemperature() { return _request(1); }
+    bool requestHumidity() { return _request(2); }
+    bool reqTempReady() { return _ready(1, _tempMillis); }
+    bool reqHumReady() { return _ready(2, _humMillis); }
+
+    // Two data bytes and a CRC.
+    bool readTemperature() {
+      FakeHardware::i2c().transact(FakeHardware::i2cNanos(3));
+      if (!reqTempReady()) {
+        return false;
+      }
+      _temperature = FakeHardware::environment().airTempC;
+      _requestType = 0;
+      return true;
+    }
+
+    bool readHumidity() {
+      FakeHardware::i2c().transact(FakeHardware::i2cNanos(3));
+      if (!reqHumReady()) {
+        return false;
+      }
+      _humidity = FakeHardware::environment().humidity;
+      _requestType = 0;
+      return true;
+    }
+
+    float getTemperature() { return _temperature; }
+    float getHumidity() { return _humidity; }
+};
+
+#endif
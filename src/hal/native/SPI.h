@@ -0,0 +1,27 @@
+#ifndef RHEOSCAPE_FAKE_SPI_H
+#define RHEOSCAPE_FAKE_SPI_H
+
+#include <Arduino.h>
+
+// The ESP32-S3's general-purpose SPI hosts.
+#define FSPI 0
+#define HSPI 1
+
+// The fake SPI sensors charge their own transactions to FakeHardware::spi(),
+// so all this needs to do is remember the clock speed.
+class SPIClass {
+  public:
+    SPIClass(uint8_t spiBus = HSPI) { }
+
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) { }
+
+    void end() { }
+
+    void setFrequency(uint32_t frequency) {
+      FakeHardware::setSpiClock(frequency);
+    }
+};
+
+inline SPIClass SPI;
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef RHEOSCAPE_FAKE_WIRE_H
+#define RHEOSCAPE_FAKE_WIRE_H
+
+#include <Arduino.h>
+
+// The fake I2C sensors charge their own transactions to FakeHardware::i2c(),
+// so all this needs to do is remember the clock speed.
+class TwoWire {
+  public:
+    TwoWire(uint8_t busNum = 0) { }
+
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) {
+      if (frequency) {
+        setClock(frequency);
+      }
+      return true;
+    }
+
+    bool setClock(uint32_t frequency) {
+      FakeHardware::setI2cClock(frequency);
+      return true;
+    }
+};
+
+inline TwoWire Wire;
+
+#endif
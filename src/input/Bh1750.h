@@ -4,6 +4,7 @@
 #ifdef PLATFORM_ARDUINO
 
 #include <Arduino.h>
+#include <SampleTrace.h>
 #include <Timer.h>
 #include <input/Input.h>
 #include <Wire.h>
@@ -14,6 +15,7 @@ class Bh1750 : public Input<float> {
     BH1750 _lightMeter;
     Timer _timer;
     float _lastReadValue;
+    std::optional<unsigned long> _sampledAt;
 
   public:
     static const uint8_t BH1750_ADDRESS_LOW = 0x23;
@@ -27,6 +29,7 @@ class Bh1750 : public Input<float> {
         [this]() {
           if (_lightMeter.measurementReady()) {
             _lastReadValue = _lightMeter.readLightLevel();
+            _sampledAt = Timekeeper::nowMicros();
           }
         },
         std::nullopt,
@@ -38,6 +41,9 @@ class Bh1750 : public Input<float> {
 
     virtual float read() {
       _timer.run();
+      if (_sampledAt.has_value()) {
+        SampleTrace::stamp(_sampledAt.value());
+      }
       return _lastReadValue;
     }
 };
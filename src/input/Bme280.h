@@ -1,9 +1,10 @@
 #ifndef RHEOSCAPE_BME280_H
 #define RHEOSCAPE_BME280_H
 
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
 #include <Arduino.h>
+#include <SampleTrace.h>
 #include <input/Input.h>
 #include <BME280_DEV.h>
 
@@ -28,15 +29,23 @@ class Bme280 : public MultiInput<Bme280Channel, std::optional<float>>, Input<std
     std::optional<float> _lastReadPress;
     std::optional<float> _lastReadHum;
     std::optional<float> _lastReadAlt;
+    std::optional<unsigned long> _sampledAt;
 
     void _read() {
       float temp, press, hum, alt;
       if (_sensor.getMeasurements(temp, press, hum, alt)) {
         _lastReadTemp = temp;
         // Pressure is given in millibars, but we want it in kPa.
-        _lastReadPress = press * 10;
+        _lastReadPress = press / 10;
         _lastReadHum = hum;
         _lastReadAlt = alt;
+        _sampledAt = Timekeeper::nowMicros();
+        // In forced mode the sensor goes back to sleep after every measurement,
+        // so ask for the next one.
+        _sensor.startForcedConversion();
+      }
+      if (_sampledAt.has_value()) {
+        SampleTrace::stamp(_sampledAt.value());
       }
     }
 
@@ -1,15 +1,17 @@
 #ifndef RHEOSCAPE_DS18B20_H
 #define RHEOSCAPE_DS18B20_H
 
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
 #include <deque>
 #include <Arduino.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
 
+#include <SampleTrace.h>
 #include <Timer.h>
 #include <input/Input.h>
+#include <input/SensorReadStats.h>
 
 // DeviceAddress is a stupid type to use -- it's just an array so you hvae to pass a pointer.
 // And you can't use it as a map key.
@@ -25,7 +27,7 @@ void intToDeviceAddress(uint64_t address, DeviceAddress deviceAddress) {
 uint64_t deviceAddressToInt(DeviceAddress deviceAddress) {
   uint64_t address = 0;
   for (uint8_t i = 0; i < 8; i ++) {
-    address += deviceAddress[i] & (0xFF << i * 8);
+    address |= (uint64_t)deviceAddress[i] << (i * 8);
   }
   return address;
 }
@@ -36,7 +38,49 @@ class Ds18b20 : public MultiInput<uint64_t, std::optional<float>>, public Input<
     DallasTemperature _inputs;
     std::vector<uint64_t> _deviceAddresses;
     std::map<uint64_t, std::optional<float>> _deviceTemperatures;
-    Timer _timer;
+    unsigned long _conversionMicros;
+    unsigned long _requestedAt;
+    // When the conversion behind the current readings finished.
+    std::optional<unsigned long> _sampledAt;
+    std::shared_ptr<SensorReadStats> _readStats;
+
+    void _requestTemperatures() {
+      _inputs.requestTemperatures();
+      _requestedAt = Timekeeper::nowMicros();
+    }
+
+    // You can't poll DallasTemperature for a finished conversion without tying up the bus,
+    // so count from when the conversion was requested instead.
+    // (A fixed-interval Timer doesn't work here: it fires a bit late, requests the next conversion,
+    // then fires again before that conversion is done, and the readings stop changing.)
+    void _update() {
+      if (Timekeeper::nowMicros() - _requestedAt < _conversionMicros) {
+        if (_sampledAt.has_value()) {
+          SampleTrace::stamp(_sampledAt.value());
+        }
+        return;
+      }
+
+      _deviceTemperatures = std::map<uint64_t, std::optional<float>>();
+      for (int i = 0; i < _deviceAddresses.size(); i ++) {
+        uint64_t owAddress = _deviceAddresses[i];
+        DeviceAddress dAddress;
+        intToDeviceAddress(owAddress, dAddress);
+        float tempC = _inputs.getTempC(dAddress);
+        if (tempC == DEVICE_DISCONNECTED_C) {
+          _deviceTemperatures[owAddress] = std::nullopt;
+        } else {
+          _deviceTemperatures[owAddress] = tempC;
+        }
+        if (_readStats) {
+          _readStats->record(tempC != DEVICE_DISCONNECTED_C);
+        }
+      }
+      _sampledAt = _requestedAt + _conversionMicros;
+      SampleTrace::stamp(_sampledAt.value());
+      // Set up for next run.
+      _requestTemperatures();
+    }
 
   public:
     enum Resolution {
@@ -49,30 +93,10 @@ class Ds18b20 : public MultiInput<uint64_t, std::optional<float>>, public Input<
     Ds18b20(OneWire* bus, Resolution resolution = half_degree)
     :
       _bus(bus),
-      // We use a Timer to throttle reads here because unfortunately you can't poll using DallasTemperature.
-      _timer(Timer(
-        // This gnarly math is copied from https://github.com/milesburton/Arduino-Temperature-Control-Library/blob/master/examples/WaitForConversion/WaitForConversion.ino#L58
-        // in which the proper timeout is determined by bit math
-        750 / (1 << (12 - resolution)),
-        [this, resolution]() {
-          _deviceTemperatures = std::map<uint64_t, std::optional<float>>();
-          for (int i = 0; i < _deviceAddresses.size(); i ++) {
-            uint64_t owAddress = _deviceAddresses[i];
-            DeviceAddress dAddress;
-            intToDeviceAddress(owAddress, dAddress);
-            float tempC = _inputs.getTempC(dAddress);
-            if (tempC == DEVICE_DISCONNECTED_C) {
-              _deviceTemperatures[owAddress] = std::nullopt;
-            } else {
-              _deviceTemperatures[owAddress] = tempC;
-            }
-          }
-          // Set up for next run.
-          _inputs.requestTemperatures();
-        },
-        std::nullopt,
-        true
-      ))
+      // This gnarly math is copied from https://github.com/milesburton/Arduino-Temperature-Control-Library/blob/master/examples/WaitForConversion/WaitForConversion.ino#L58
+      // in which the proper timeout is determined by bit math
+      _conversionMicros((750 / (1 << (12 - resolution))) * 1000UL),
+      _requestedAt(0)
     {
       // First, find out what devices are on the bus.
       scanBus();
@@ -81,10 +105,24 @@ class Ds18b20 : public MultiInput<uint64_t, std::optional<float>>, public Input<
       _inputs.setResolution(resolution);
       // Set up in async mode.
       _inputs.setWaitForConversion(false);
+      // Kick off the first conversion, so the first reading is a real one
+      // rather than the 85°C that the scratchpad holds at power-on.
+      _requestTemperatures();
+    }
+
+    // Counts every device's reading from every conversion; the name shows up wherever SensorReadStats::all() gets reported.
+    void enableReadStats(const char* name) {
+      if (!_readStats) {
+        _readStats = SensorReadStats::create(name);
+      }
+    }
+
+    std::shared_ptr<SensorReadStats> getReadStats() const {
+      return _readStats;
     }
 
     virtual std::optional<float> readChannel(uint64_t address) {
-      _timer.run();
+      _update();
       if (_deviceTemperatures.find(address) != _deviceTemperatures.end()) {
         return _deviceTemperatures[address];
       }
@@ -92,7 +130,7 @@ class Ds18b20 : public MultiInput<uint64_t, std::optional<float>>, public Input<
     }
 
     virtual std::map<uint64_t, std::optional<float>> read() {
-      _timer.run();
+      _update();
       return _deviceTemperatures;
     }
 
@@ -1,9 +1,10 @@
 #ifndef RHEOSCAPE_GPIO_INPUTS_H
 #define RHEOSCAPE_GPIO_INPUTS_H
 
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
 #include <Arduino.h>
+#include <SampleTrace.h>
 #include <input/Input.h>
 
 class DigitalPinInput : public Input<bool> {
@@ -21,6 +22,7 @@ class DigitalPinInput : public Input<bool> {
     }
 
     virtual bool read() {
+      SampleTrace::stamp(Timekeeper::nowMicros());
       bool pinState = digitalRead(_pin);
       return _circuitClosedState ? pinState : !pinState;
     }
@@ -43,6 +45,7 @@ class AnalogPinInput : public Input<float> {
     }
 
     virtual float read() {
+      SampleTrace::stamp(Timekeeper::nowMicros());
       return (float)analogRead(_pin) / (2 ^ _resolution - 1);
     }
 };
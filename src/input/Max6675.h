@@ -1,10 +1,11 @@
 #ifndef RHEOSCAPE_MAX6675_H
 #define RHEOSCAPE_MAX6675_H
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
 #include <Arduino.h>
 #include <MAX6675.h>
 
+#include <SampleTrace.h>
 #include <Timer.h>
 #include <input/Input.h>
 
@@ -13,6 +14,7 @@ class Max6675 : public Input<std::optional<float>> {
     MAX6675 _sensor;
     BasicThrottle _throttle;
     std::optional<float> _lastReading;
+    std::optional<unsigned long> _sampledAt;
   
   public:
     Max6675(uint8_t csPin, SPIClass* spi)
@@ -22,13 +24,18 @@ class Max6675 : public Input<std::optional<float>> {
       _throttle(220, [this]() {
         if (_sensor.read() != STATUS_OK) {
           _lastReading = std::nullopt;
+        } else {
+          _lastReading = _sensor.getTemperature();
+          _sampledAt = Timekeeper::nowMicros();
         }
-        _lastReading = _sensor.getTemperature();
       })
     { }
 
     virtual std::optional<float> read() {
       _throttle.tryRun();
+      if (_lastReading.has_value()) {
+        SampleTrace::stamp(_sampledAt.value());
+      }
       return _lastReading;
     }
 };
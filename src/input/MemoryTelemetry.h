@@ -0,0 +1,193 @@
+#ifndef RHEOSCAPE_MEMORY_TELEMETRY_H
+#define RHEOSCAPE_MEMORY_TELEMETRY_H
+
+#include <cstddef>
+#include <optional>
+
+#ifdef PLATFORM_ARDUINO
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#ifdef PLATFORM_DEV_MACHINE
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#endif
+#endif
+
+#include <input/Input.h>
+
+enum class MemoryTelemetryChannel {
+  freeHeap,
+  // The lowest free heap ever seen since boot.
+  minFreeHeap,
+  // The biggest single allocation that could succeed right now.
+  // If this drifts far below freeHeap, the heap is fragmenting.
+  largestFreeBlock
+};
+
+#ifdef PLATFORM_DEV_MACHINE
+
+// There's no fixed-size heap on the dev machine, so we pretend there is one
+// and count every allocation against it.
+// glibc got rid of __malloc_hook, so the hook is a replacement of the global operator new/delete,
+// which is what every std::function, std::map and std::vector goes through anyway.
+// Each allocation gets a small header that remembers its size so that delete can uncount it.
+//
+// Replacing them swaps the allocator for the whole program, and they can only be defined once,
+// so they're opt-in: define RHEOSCAPE_TRACK_NATIVE_HEAP before including this in exactly one translation unit.
+// Without it, nothing gets counted, and the heap always looks empty.
+class NativeHeapTracker {
+  private:
+    inline static std::atomic<size_t> _liveBytes = 0;
+    inline static std::atomic<size_t> _peakLiveBytes = 0;
+    // The ESP32-S3's internal DRAM, give or take; change it to model a different board.
+    inline static size_t _notionalHeapSize = 320 * 1024;
+
+  public:
+    // Big enough to keep the user's pointer aligned for anything.
+    static constexpr size_t headerSize = alignof(std::max_align_t);
+
+    static void* allocate(size_t size) {
+      void* block = std::malloc(size + headerSize);
+      if (block == nullptr) {
+        return nullptr;
+      }
+      *(size_t*)block = size;
+      size_t live = _liveBytes += size;
+      size_t peak = _peakLiveBytes.load();
+      while (live > peak && !_peakLiveBytes.compare_exchange_weak(peak, live)) { }
+      return (char*)block + headerSize;
+    }
+
+    static void release(void* pointer) {
+      if (pointer == nullptr) {
+        return;
+      }
+      void* block = (char*)pointer - headerSize;
+      _liveBytes -= *(size_t*)block;
+      std::free(block);
+    }
+
+    static size_t liveBytes() { return _liveBytes; }
+    static size_t peakLiveBytes() { return _peakLiveBytes; }
+    static size_t notionalHeapSize() { return _notionalHeapSize; }
+
+    static void setNotionalHeapSize(size_t size) {
+      _notionalHeapSize = size;
+    }
+
+    static size_t freeBytes() {
+      size_t live = _liveBytes;
+      return live < _notionalHeapSize ? _notionalHeapSize - live : 0;
+    }
+
+    static size_t minFreeBytes() {
+      size_t peak = _peakLiveBytes;
+      return peak < _notionalHeapSize ? _notionalHeapSize - peak : 0;
+    }
+};
+
+#ifdef RHEOSCAPE_TRACK_NATIVE_HEAP
+
+void* operator new(size_t size) {
+  void* pointer = NativeHeapTracker::allocate(size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return NativeHeapTracker::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return NativeHeapTracker::allocate(size);
+}
+
+void operator delete(void* pointer) noexcept { NativeHeapTracker::release(pointer); }
+void operator delete[](void* pointer) noexcept { NativeHeapTracker::release(pointer); }
+void operator delete(void* pointer, size_t) noexcept { NativeHeapTracker::release(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { NativeHeapTracker::release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { NativeHeapTracker::release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { NativeHeapTracker::release(pointer); }
+
+#endif
+
+#endif
+
+// Heap stats for the whole device.
+// Reading a channel samples it right then; wrap it in an InputToEventStream with a throttle
+// if you want it to feed a GreenhouseState field or an alarm.
+class MemoryTelemetry : public MultiInput<MemoryTelemetryChannel, size_t> {
+  public:
+    virtual size_t readChannel(MemoryTelemetryChannel channel) {
+      switch (channel) {
+#ifdef PLATFORM_ARDUINO
+        case MemoryTelemetryChannel::freeHeap:
+          return ESP.getFreeHeap();
+        case MemoryTelemetryChannel::minFreeHeap:
+          return ESP.getMinFreeHeap();
+        case MemoryTelemetryChannel::largestFreeBlock:
+          return ESP.getMaxAllocHeap();
+#else
+#ifdef PLATFORM_DEV_MACHINE
+        case MemoryTelemetryChannel::freeHeap:
+          return NativeHeapTracker::freeBytes();
+        case MemoryTelemetryChannel::minFreeHeap:
+          return NativeHeapTracker::minFreeBytes();
+        case MemoryTelemetryChannel::largestFreeBlock:
+          // The notional heap is one big arena with no fragmentation.
+          return NativeHeapTracker::freeBytes();
+#endif
+#endif
+        default:
+          return 0;
+      }
+    }
+};
+
+// The least amount of stack, in bytes, that a FreeRTOS task has ever had left.
+// Empty if the task doesn't exist (yet), or if there aren't any tasks, like on the dev machine.
+class TaskStackHighWaterMark : public Input<std::optional<size_t>> {
+  private:
+    const char* _taskName;
+#ifdef PLATFORM_ARDUINO
+    TaskHandle_t _task;
+#endif
+
+  public:
+    // Some handy task names on the ESP32 Arduino core are
+    // "loopTask" (where Runner::run() happens) and "async_tcp" (where the web server callbacks happen).
+    TaskStackHighWaterMark(const char* taskName)
+    :
+      _taskName(taskName)
+#ifdef PLATFORM_ARDUINO
+      , _task(nullptr)
+#endif
+    { }
+
+    virtual std::optional<size_t> read() {
+#ifdef PLATFORM_ARDUINO
+      if (_task == nullptr) {
+        // Look it up lazily, because some tasks (like async_tcp) only start once the web server does.
+        _task = xTaskGetHandle(_taskName);
+        if (_task == nullptr) {
+          return std::nullopt;
+        }
+      }
+      // On the ESP32, stack sizes are in bytes rather than words.
+      return (size_t)uxTaskGetStackHighWaterMark(_task);
+#else
+      return std::nullopt;
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef RHEOSCAPE_SENSOR_READ_STATS_H
+#define RHEOSCAPE_SENSOR_READ_STATS_H
+
+#include <cstdint>
+
+#include <StatsRegistry.h>
+
+// How many of a sensor driver's reads have failed, e.g., a DS18B20 that's come loose,
+// counted where the driver actually talks to the hardware rather than every time someone reads the last value.
+// A sensor that's failing now and then is usually a wiring problem on its way to becoming a dead sensor.
+class SensorReadStats : public StatsRegistry<SensorReadStats> {
+  public:
+    const char* name;
+    uint32_t reads;
+    uint32_t failures;
+
+    SensorReadStats(const char* name)
+    :
+      name(name),
+      reads(0),
+      failures(0)
+    { }
+
+    void record(bool succeeded) {
+      reads ++;
+      if (!succeeded) {
+        failures ++;
+      }
+    }
+};
+
+#endif
@@ -1,9 +1,10 @@
 #ifndef RHEOSCAPE_SHT21_H
 #define RHEOSCAPE_SHT21_H
 
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
 #include <Arduino.h>
+#include <SampleTrace.h>
 #include <input/Input.h>
 #include <SHT2x.h>
 
@@ -17,6 +18,8 @@ class Sht21 : public MultiInput<Sht21Channel, std::optional<float>> {
     SHT21 _sensor;
     std::optional<float> _lastReadTemp;
     std::optional<float> _lastReadHum;
+    std::optional<unsigned long> _tempSampledAt;
+    std::optional<unsigned long> _humSampledAt;
 
     // What are we currently polling for?
     // Maps to the underlying library's request type:
@@ -41,6 +44,16 @@ class Sht21 : public MultiInput<Sht21Channel, std::optional<float>> {
     }
 
     std::optional<float> readChannel(Sht21Channel channel) {
+      std::optional<float> value = _readChannel(channel);
+      std::optional<unsigned long> sampledAt = channel == Sht21Channel::tempC ? _tempSampledAt : _humSampledAt;
+      if (sampledAt.has_value()) {
+        SampleTrace::stamp(sampledAt.value());
+      }
+      return value;
+    }
+
+  private:
+    std::optional<float> _readChannel(Sht21Channel channel) {
       switch (_mode) {
         case _SensorMode::NotPolling:
           // Not polling for anything. Start the poll on the requested channel.
@@ -65,6 +78,7 @@ class Sht21 : public MultiInput<Sht21Channel, std::optional<float>> {
               // get the temp and reset the polling mode so we know we can poll again.
               if (_sensor.reqTempReady() && _sensor.readTemperature()) {
                 _lastReadTemp = _sensor.getTemperature();
+                _tempSampledAt = Timekeeper::nowMicros();
                 _mode = _SensorMode::NotPolling;
               }
               return _lastReadTemp;
@@ -78,6 +92,7 @@ class Sht21 : public MultiInput<Sht21Channel, std::optional<float>> {
             case Sht21Channel::humidity:
               if (_sensor.reqHumReady() && _sensor.readHumidity()) {
                 _lastReadHum = _sensor.getHumidity();
+                _humSampledAt = Timekeeper::nowMicros();
                 _mode = _SensorMode::NotPolling;
               }
               return _lastReadHum;
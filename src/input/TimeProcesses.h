@@ -5,6 +5,7 @@
 
 //#include <helpers/string_format.h>
 #include <input/Input.h>
+#include <TickClock.h>
 #include <Timer.h>
 
 // Take 'continuous' values and 'snap' them to a time interval.
@@ -35,6 +36,40 @@ class TimeQuantisingProcess : public Input<T> {
     }
 };
 
+// How much a counter went up over the last full interval, e.g., messages per minute.
+// Counters that roll over are fine, as long as T is unsigned.
+// Read it at least once an interval, or the next interval's count will include the ones that were missed.
+template <typename T>
+class CounterDeltaProcess : public Input<T> {
+  private:
+    Input<T>* _wrappedInput;
+    T _lastCount;
+    T _delta;
+    Timer _timer;
+
+  public:
+    CounterDeltaProcess(Input<T>* wrappedInput, unsigned long interval)
+    :
+      _wrappedInput(wrappedInput),
+      _lastCount(wrappedInput->read()),
+      _delta(0),
+      _timer(Timer(
+        interval,
+        [this]() {
+          T count = _wrappedInput->read();
+          _delta = count - _lastCount;
+          _lastCount = count;
+        },
+        std::nullopt
+      ))
+    { }
+
+    virtual T read() {
+      _timer.run();
+      return _delta;
+    }
+};
+
 // Don't let a value change more frequently than every n milliseconds.
 // Kinda like TimeQuantisingProcess, except it doesn't 'snap' to the interval.
 template <typename T>
@@ -73,18 +108,33 @@ class ThrottlingProcess : public Input<T> {
 
 // Convert a boolean input to another boolean input,
 // where true is converted to a true/false pulse.
+// Give it a TickClock and it won't need its own timers;
+// the pulse is timed from the clock's phase rather than from when the input went true,
+// so every blinker on the same clock with the same cycle turns on and off together.
 class BlinkingProcess : public Input<bool> {
   private:
     Input<bool>* _wrappedInput;
-    Timer _offTimer;
-    Timer _fullCycleTimer;
+    unsigned long _cycle;
+    unsigned long _offTime;
+    TickClock* _clock;
+    // Only needed without a clock, so they're only made without one.
+    std::optional<Timer> _offTimer;
+    std::optional<Timer> _fullCycleTimer;
     bool _state;
   
   public:
-    BlinkingProcess(Input<bool>* wrappedInput, unsigned long onTime, unsigned long offTime)
+    BlinkingProcess(Input<bool>* wrappedInput, unsigned long onTime, unsigned long offTime, TickClock* clock = nullptr)
     :
       _wrappedInput(wrappedInput),
-      _offTimer(Timer(
+      _cycle(onTime + offTime),
+      _offTime(offTime),
+      _clock(clock),
+      _state(false)
+    {
+      if (clock != nullptr) {
+        return;
+      }
+      _offTimer.emplace(
         offTime,
         [this](){
           _state = false;
@@ -92,31 +142,36 @@ class BlinkingProcess : public Input<bool> {
         1,
         false,
         true
-      )),
-      _fullCycleTimer(Timer(
+      );
+      _fullCycleTimer.emplace(
         onTime + offTime,
         [this]() {
           _state = true;
-          _offTimer.restart();
+          _offTimer->restart();
         },
         std::nullopt,
         true,
         false
-      ))
-    { }
+      );
+    }
 
     virtual bool read() {
       bool innerValue = _wrappedInput->read();
+      if (_clock != nullptr) {
+        // Same shape as the timer version: high for the first offTime of the cycle.
+        _state = innerValue && _clock->phase(_cycle) < _offTime;
+        return _state;
+      }
       if (innerValue) {
-        if (!_fullCycleTimer.isRunning()) {
-          _fullCycleTimer.restart();
+        if (!_fullCycleTimer->isRunning()) {
+          _fullCycleTimer->restart();
         } else {
-          _fullCycleTimer.run();
+          _fullCycleTimer->run();
         }
-        _offTimer.run();
+        _offTimer->run();
       } else {
-        _fullCycleTimer.cancel();
-        _offTimer.cancel();
+        _fullCycleTimer->cancel();
+        _offTimer->cancel();
         _state = false;
       }
       return _state;
@@ -124,12 +179,16 @@ class BlinkingProcess : public Input<bool> {
 };
 
 // Convert a 0..1 float to a boolean suitable for using in slow PWM outputs.
+// The cycle starts when it's created,
+// or, with a TickClock, on the clock's cycle boundaries,
+// so outputs on the same clock with the same interval start their cycles together.
 class SlowPwmProcess : public Input<bool> {
   private:
-    Timer _timer;
-    bool _currentValue;
-    uint16_t _rollovers;
-    uint16_t _lastCounter;
+    Input<float>* _wrappedInput;
+    unsigned long _interval;
+    uint8_t _resolution;
+    TickClock* _clock;
+    unsigned long _startTime;
   
   public:
     SlowPwmProcess(
@@ -138,27 +197,14 @@ class SlowPwmProcess : public Input<bool> {
       unsigned long interval,
       // The number of steps in a cycle. interval / resolution = step duration.
       // Make sure this interval is divisible by resolution, cuz we aren't doing float math on timespans!
-      uint8_t resolution
+      uint8_t resolution,
+      TickClock* clock = nullptr
     ) :
-      _rollovers(0),
-      _lastCounter(0),
-      _timer(Timer(
-        interval / resolution,
-        [this, &wrappedInput, resolution](uint16_t count) {
-          // The resolution of the counter isn't enough to reliably cross rollovers.
-          // This keeps an internal rollover monitor and allows accurate rollover crossing.
-          if (_lastCounter > count) {
-            _rollovers ++;
-          }
-          _lastCounter = count;
-
-          float value = wrappedInput->read();
-          uint16_t stepsPassedInInterval = (count + UINT16_MAX % resolution * _rollovers + _rollovers) % resolution;
-          float stepsPassedAsFraction = (float)stepsPassedInInterval / (float)resolution;
-          _currentValue = stepsPassedAsFraction < value;
-        },
-        std::nullopt
-      ))
+      _wrappedInput(wrappedInput),
+      _interval(interval),
+      _resolution(resolution),
+      _clock(clock),
+      _startTime(Timekeeper::nowMillis())
     {
       if (interval % resolution != 0) {
         throw std::invalid_argument("Interval must be a multiple of resolution.");
@@ -166,8 +212,13 @@ class SlowPwmProcess : public Input<bool> {
     }
 
     bool read() {
-      _timer.run();
-      return _currentValue;
+      // Working from the time since the cycle started, rather than counting steps,
+      // means there's no step counter to roll over.
+      unsigned long phase = _clock != nullptr
+        ? _clock->phase(_interval)
+        : (Timekeeper::nowMillis() - _startTime) % _interval;
+      unsigned long stepsPassedInInterval = phase / (_interval / _resolution);
+      return (float)stepsPassedInInterval / (float)_resolution < _wrappedInput->read();
     }
 };
 
@@ -270,38 +321,67 @@ class ExponentialMovingAverageProcess : public Input<T> {
 
 // When the input goes true, emit true for a given number of milliseconds,
 // then revert to false regardless of whether the input is true or false.
+// With a TickClock, it times the latch from the clock instead of its own timer.
 class TimedLatchProcess : public Input<bool> {
   private:
     Input<bool>* _wrappedInput;
-    Timer _timer;
+    unsigned long _timeout;
+    TickClock* _clock;
+    std::optional<unsigned long> _latchedAt;
+    // Only made without a clock.
+    std::optional<Timer> _timer;
     bool _previousValue;
+
+    bool _isLatched() {
+      if (_clock == nullptr) {
+        _timer->run();
+        return _timer->isRunning();
+      }
+      if (_latchedAt.has_value() && _clock->nowMillis() - _latchedAt.value() >= _timeout) {
+        _latchedAt = std::nullopt;
+      }
+      return _latchedAt.has_value();
+    }
+
+    void _latch() {
+      if (_clock == nullptr) {
+        _timer->restart();
+      } else {
+        _latchedAt = _clock->nowMillis();
+      }
+    }
   
   public:
-    TimedLatchProcess(Input<bool>* wrappedInput, unsigned long timeout)
+    TimedLatchProcess(Input<bool>* wrappedInput, unsigned long timeout, TickClock* clock = nullptr)
     :
       _wrappedInput(wrappedInput),
-      _timer(Timer(
-        timeout,
-        []() {
-          // We don't actually need a value;
-          // we're just using this timer to test whether it's running.
-        },
-        1,
-        false,
-        false
-      ))
-    { }
+      _timeout(timeout),
+      _clock(clock),
+      _previousValue(false)
+    {
+      if (clock == nullptr) {
+        _timer.emplace(
+          timeout,
+          []() {
+            // We don't actually need a value;
+            // we're just using this timer to test whether it's running.
+          },
+          1,
+          false,
+          false
+        );
+      }
+    }
 
     virtual bool read() {
-      _timer.run();
-      if (_timer.isRunning()) {
+      if (_isLatched()) {
         // Within the timer window.
         return true;
       }
       bool inputValue = _wrappedInput->read();
       if (!_previousValue && inputValue) {
         // 'rising edge'
-        _timer.restart();
+        _latch();
         _previousValue = inputValue;
         return true;
       } else {
@@ -1,5 +1,6 @@
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <sstream>
 
@@ -11,6 +12,9 @@
 
 #include <Range.h>
 #include <Runnable.h>
+#include <RunnableCost.h>
+#include <TickClock.h>
+#include <LoopMonitor.h>
 #include <input/Input.h>
 #include <input/Ds18b20.h>
 #include <input/Bme280.h>
@@ -20,9 +24,12 @@
 #include <input/CombiningProcesses.h>
 #include <input/ControlProcesses.h>
 #include <input/LogicalProcesses.h>
+#include <input/MemoryTelemetry.h>
 #include <output/OutputFactories.h>
 #include <output/MotorDriver.h>
 #include <notifier/TwilioMessageNotifier.h>
+#include <event_stream/BufferedSubscriber.h>
+#include <event_stream/EventQueue.h>
 #include <event_stream/EventStreamProcesses.h>
 #include <helpers/string_format.h>
 #include <helpers/temperature.h>
@@ -53,12 +60,36 @@ const int GREEN_LED_PIN = 36;
 const int BLUE_LED_PIN = 37;
 const int BUZZER_PIN = 38;
 const unsigned long BH1750_SAMPLE_INTERVAL = 1000;
+const unsigned long TELEMETRY_SAMPLE_INTERVAL = 5000;
+// The DS18B20s and the SHT21 flicker in the last decimal place,
+// and every emit turns into a websocket broadcast, so only real changes get through.
+const EmitPolicy TEMP_EMIT_POLICY = EmitPolicy(0.1f, 0, 1000, 60000);
+const EmitPolicy HUMIDITY_EMIT_POLICY = EmitPolicy(0.5f, 0, 1000, 60000);
+const EmitPolicy LIGHT_EMIT_POLICY = EmitPolicy(0, 0.05f, 1000, 60000);
+// If a pass through the runnables takes longer than this, the alarms aren't being serviced often enough.
+const unsigned long LOOP_TICK_BUDGET_MICROS = 100000;
+// How long the fault light stays on after the last overrun.
+const unsigned long LOOP_OVERRUN_FAULT_HOLD = 3600000;
+// Settings written by the web server and alarm messages wait here to be dispatched at the end of each tick.
+const size_t EVENT_QUEUE_CAPACITY = 64;
+const size_t EVENT_QUEUE_MAX_DISPATCH_PER_TICK = 16;
+// A sensor burst can change a dozen fields in a second; every client gets them all in one message per interval instead.
+const unsigned long STATE_UPDATE_FLUSH_INTERVAL = 250;
+const unsigned long WEBSOCKET_TRAFFIC_INTERVAL = 60000;
+const size_t ALARM_MESSAGE_BACKLOG = 8;
+const size_t EVENT_HISTORY_LENGTH = 16;
+// The HTTPS client needs a lot of stack.
+const uint32_t ALARM_MESSAGE_TASK_STACK_SIZE = 8192;
 const std::string MY_WIFI_AP_SSID = "logiehouse2";
 const std::string MY_WIFI_AP_KEY = "";
 const std::string TWILIO_ACCT_ID;
 const std::string TWILIO_AUTH_TOKEN;
 const std::string TWILIO_SENDER;
 
+// The blinkers and beacons all take their time from this,
+// so it's one clock read per tick and the lights and buzzer blink in step.
+TickClock tickClock;
+
 StateInput tempDisplayUnits(TempUnit::celsius);
 TranslatingProcess<TempUnit, std::string> tempDisplayUnitsSymbol(&tempDisplayUnits, [](TempUnit value) { return displayUnit(value); });
 
@@ -222,10 +253,10 @@ TranslatingProcess<std::optional<std::tuple<float, float>>, std::optional<std::s
     }
   }
 );
-Beacon doorAlarmMessageEmitter(&doorAlarmThresholdMessageCreator, 1000 * 60 * 5);
-BlinkingProcess doorBuzzerBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&doorThresholdsCalculator, [](auto value) { return value.has_value(); }), 1000, 4000);
-BlinkingProcess doorBlueLightBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&doorThresholdsCalculator, [](auto value) { return value.has_value() && std::get<0>(value.value()) < 0.0f; }), 1000, 4000);
-BlinkingProcess doorRedLightBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&doorThresholdsCalculator, [](auto value) { return value.has_value() && std::get<0>(value.value()) > 0.0f; }), 1000, 4000);
+Beacon doorAlarmMessageEmitter(&doorAlarmThresholdMessageCreator, 1000 * 60 * 5, &tickClock);
+BlinkingProcess doorBuzzerBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&doorThresholdsCalculator, [](auto value) { return value.has_value(); }), 1000, 4000, &tickClock);
+BlinkingProcess doorBlueLightBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&doorThresholdsCalculator, [](auto value) { return value.has_value() && std::get<0>(value.value()) < 0.0f; }), 1000, 4000, &tickClock);
+BlinkingProcess doorRedLightBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&doorThresholdsCalculator, [](auto value) { return value.has_value() && std::get<0>(value.value()) > 0.0f; }), 1000, 4000, &tickClock);
 
 Merging2TupleProcess<Range<float>, Range<float>> environmentAndDangerThresholds(
   &environmentMinMaxTemps,
@@ -259,10 +290,10 @@ TranslatingProcess<std::optional<std::tuple<float, float>>, std::optional<std::s
     }
   }
 );
-Beacon dangerAlarmMessageEmitter(&dangerAlarmThresholdMessageCreator, 1000 * 60 * 5);
-BlinkingProcess dangerBuzzerBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&dangerThresholdsCalculator, [](auto value) { return value.has_value(); }), 1000, 500);
-BlinkingProcess dangerBlueLightBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&dangerThresholdsCalculator, [](auto value) { return value.has_value() && std::get<0>(value.value()) < 0.0f; }), 1000, 500);
-BlinkingProcess dangerRedLightBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&dangerThresholdsCalculator, [](auto value) { return value.has_value() && std::get<0>(value.value()) > 0.0f; }), 1000, 500);
+Beacon dangerAlarmMessageEmitter(&dangerAlarmThresholdMessageCreator, 1000 * 60 * 5, &tickClock);
+BlinkingProcess dangerBuzzerBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&dangerThresholdsCalculator, [](auto value) { return value.has_value(); }), 1000, 500, &tickClock);
+BlinkingProcess dangerBlueLightBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&dangerThresholdsCalculator, [](auto value) { return value.has_value() && std::get<0>(value.value()) < 0.0f; }), 1000, 500, &tickClock);
+BlinkingProcess dangerRedLightBlinker(new TranslatingProcess<std::optional<std::tuple<float, float>>, bool>(&dangerThresholdsCalculator, [](auto value) { return value.has_value() && std::get<0>(value.value()) > 0.0f; }), 1000, 500, &tickClock);
 
 std::vector<EventStream<std::string>*> alarmMessageEmitters = {
   &doorAlarmMessageEmitter,
@@ -270,16 +301,44 @@ std::vector<EventStream<std::string>*> alarmMessageEmitters = {
 };
 EventStreamCombiner alarmMessagesCombined(alarmMessageEmitters);
 
-TranslatingProcess<std::string, TwilioConfig> twilioConfig(&alarmPhone, [](std::string phone) {
+// The alarm message task reads this while the web and loop tasks might be changing alarmPhone,
+// so it gets its own copy, which trackAlarmRecipient() keeps up to date under a lock.
+std::mutex alarmRecipientMutex;
+std::string alarmRecipient = alarmPhone.read();
+
+FunctionInput<TwilioConfig> twilioConfig([]() {
+  std::lock_guard<std::mutex> lock(alarmRecipientMutex);
   return TwilioConfig {
     TWILIO_ACCT_ID,
     TWILIO_AUTH_TOKEN,
     TWILIO_SENDER,
-    phone
+    alarmRecipient
   };
 });
 
-TwilioMessageNotifier alarmNotifier(&alarmMessagesCombined, &twilioConfig);
+TwilioMessageNotifier alarmNotifier(&twilioConfig);
+// Sending a text takes seconds, so it happens on a task of its own, and the alarms never wait for it.
+// If Twilio's so slow that messages pile up, the newest ones are the ones worth sending.
+BufferedSubscriber<std::string> alarmMessageBuffer(
+  &alarmMessagesCombined,
+  [](const Event<std::string>& e) { alarmNotifier.sendMessage(e.value); },
+  ALARM_MESSAGE_BACKLOG,
+  BackpressurePolicy::dropOldest
+);
+auto alarmMessagesDropped = alarmMessageBuffer.getInputForChannel(BufferedSubscriberStat::dropped);
+
+void trackAlarmRecipient() {
+  alarmPhone.registerSubscriber([](const Event<std::string>& e) {
+    std::lock_guard<std::mutex> lock(alarmRecipientMutex);
+    alarmRecipient = e.value;
+  });
+}
+
+void sendAlarmMessages(void* parameters) {
+  while (true) {
+    alarmMessageBuffer.waitAndDrain(1000);
+  }
+}
 
 std::map<uint8_t, Input<bool>*> buzzerBlinkers = {
   { 0, &doorBuzzerBlinker },
@@ -327,31 +386,66 @@ FunctionInput<uint8_t> redLightSwitch([]() {
 InputSwitcher<uint8_t, bool> redLightSwitcher(&redLightBlinkers, &redLightSwitch);
 DigitalPinOutput redLight(RED_LED_PIN, HIGH, &redLightSwitcher);
 
-BlinkingProcess heartbeat(new ConstantInput(true), 500, 5000);
+BlinkingProcess heartbeat(new ConstantInput(true), 500, 5000, &tickClock);
 StateInput faultState(false);
+std::optional<unsigned long> lastLoopOverrunAt;
+// Overruns fade out of the fault light once there haven't been any for a while,
+// so that one hiccup at startup doesn't leave it on for good.
+FunctionInput<bool> faultLight([]() {
+  return faultState.read()
+    || (lastLoopOverrunAt.has_value() && tickClock.nowMillis() - lastLoopOverrunAt.value() < LOOP_OVERRUN_FAULT_HOLD);
+});
 std::map<bool, Input<bool>*> greenLightInputs = {
   { false, &heartbeat },
   { true, new ConstantInput(false) }
 };
-InputSwitcher greenLightSwitcher(&greenLightInputs, &faultState);
+InputSwitcher greenLightSwitcher(&greenLightInputs, &faultLight);
 DigitalPinOutput greenLight(GREEN_LED_PIN, HIGH, &greenLightSwitcher);
 
+MemoryTelemetry memoryTelemetry;
+auto freeHeap = memoryTelemetry.getInputForChannel(MemoryTelemetryChannel::freeHeap);
+auto minFreeHeap = memoryTelemetry.getInputForChannel(MemoryTelemetryChannel::minFreeHeap);
+auto largestFreeBlock = memoryTelemetry.getInputForChannel(MemoryTelemetryChannel::largestFreeBlock);
+TaskStackHighWaterMark loopTaskStackFree("loopTask");
+TaskStackHighWaterMark webServerTaskStackFree("async_tcp");
+
+LoopMonitor loopMonitor(LOOP_TICK_BUDGET_MICROS);
+auto loopDurationP50 = loopMonitor.getInputForChannel(LoopStat::tickDurationP50);
+auto loopDurationP99 = loopMonitor.getInputForChannel(LoopStat::tickDurationP99);
+auto loopDurationMax = loopMonitor.getInputForChannel(LoopStat::tickDurationMax);
+auto loopJitterP50 = loopMonitor.getInputForChannel(LoopStat::tickJitterP50);
+auto loopJitterP99 = loopMonitor.getInputForChannel(LoopStat::tickJitterP99);
+auto loopJitterMax = loopMonitor.getInputForChannel(LoopStat::tickJitterMax);
+auto loopIntervalMax = loopMonitor.getInputForChannel(LoopStat::tickIntervalMax);
+
+EventQueue eventQueue(EVENT_QUEUE_CAPACITY, EVENT_QUEUE_MAX_DISPATCH_PER_TICK);
+auto eventQueueHighWaterMark = eventQueue.getInputForChannel(EventQueueStat::highWaterMark);
+auto eventQueueDropped = eventQueue.getInputForChannel(EventQueueStat::dropped);
+
+// How much the batching saves: the messages there'd have been with one per change, against what actually went out.
+auto stateUpdatesRecorded = stateUpdateFrames.getInputForChannel(FrameCollectorStat::updates);
+auto stateUpdateFramesSent = stateUpdateFrames.getInputForChannel(FrameCollectorStat::frames);
+auto webSocketBytes = stateServer.getInputForChannel(StateServerStat::bytesSent);
+CounterDeltaProcess<uint32_t> stateUpdatesPerMinute(&stateUpdatesRecorded, WEBSOCKET_TRAFFIC_INTERVAL);
+CounterDeltaProcess<uint32_t> webSocketFramesPerMinute(&stateUpdateFramesSent, WEBSOCKET_TRAFFIC_INTERVAL);
+CounterDeltaProcess<uint32_t> webSocketBytesPerMinute(&webSocketBytes, WEBSOCKET_TRAFFIC_INTERVAL);
+
 GreenhouseState ghState;
 
 GreenhouseState initGreenhouseState() {
   GreenhouseState ghState;
   ghState.temp_unit = &tempDisplayUnits;
-  ghState.shelf_temp = new InputToEventStream(&shelfMaybeTempCalibrated);
+  ghState.shelf_temp = new InputToEventStream(&shelfMaybeTempCalibrated, 0, TEMP_EMIT_POLICY);
   ghState.shelf_temp_calibration = &shelfTempCalibration;
-  ghState.shelf_hum = new InputToEventStream(&shelfMaybeHum);
-  ghState.shelf_light = new InputToEventStream(&shelfLight);
-  ghState.ground_temp = new InputToEventStream(&groundMaybeTempCalibrated);
+  ghState.shelf_hum = new InputToEventStream(&shelfMaybeHum, 0, HUMIDITY_EMIT_POLICY);
+  ghState.shelf_light = new InputToEventStream(&shelfLight, 0, LIGHT_EMIT_POLICY);
+  ghState.ground_temp = new InputToEventStream(&groundMaybeTempCalibrated, 0, TEMP_EMIT_POLICY);
   ghState.ground_temp_calibration = &groundTempCalibration;
-  ghState.ceiling_temp = new InputToEventStream(&ceilingMaybeTempCalibrated);
+  ghState.ceiling_temp = new InputToEventStream(&ceilingMaybeTempCalibrated, 0, TEMP_EMIT_POLICY);
   ghState.ceiling_temp_calibration = &ceilingTempCalibration;
-  ghState.yuzu_temp = new InputToEventStream(&yuzuMaybeTempCalibrated);
+  ghState.yuzu_temp = new InputToEventStream(&yuzuMaybeTempCalibrated, 0, TEMP_EMIT_POLICY);
   ghState.yuzu_temp_calibration = &yuzuTempCalibration;
-  ghState.fish_tank_temp = new InputToEventStream(&fishTankMaybeTempCalibrated);
+  ghState.fish_tank_temp = new InputToEventStream(&fishTankMaybeTempCalibrated, 0, TEMP_EMIT_POLICY);
   ghState.fish_tank_temp_calibration = &fishTankTempCalibration;
   ghState.fan_status = new InputToEventStream(&fanThermostat);
   ghState.fan = &fanTempSetting;
@@ -367,44 +461,217 @@ GreenhouseState initGreenhouseState() {
   ghState.roof_vents_sensor_status = new InputToEventStream(&roofVentSensor);
   ghState.roof_vents = &roofVentsTempSetting;
   ghState.mat_1_status = new InputToEventStream(&mat1Thermostat);
-  ghState.mat_1_temp = new InputToEventStream(&mat1MaybeTempCalibrated);
+  ghState.mat_1_temp = new InputToEventStream(&mat1MaybeTempCalibrated, 0, TEMP_EMIT_POLICY);
   ghState.mat_1_temp_calibration = &mat1TempCalibration;
   ghState.mat_1 = &mat1TempSetting;
   ghState.mat_2_status = new InputToEventStream(&mat2Thermostat);
-  ghState.mat_2_temp = new InputToEventStream(&mat2MaybeTempCalibrated);
+  ghState.mat_2_temp = new InputToEventStream(&mat2MaybeTempCalibrated, 0, TEMP_EMIT_POLICY);
   ghState.mat_2_temp_calibration = &mat2TempCalibration;
   ghState.mat_2 = &mat2TempSetting;
+  ghState.free_heap = new InputToEventStream(&freeHeap, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.min_free_heap = new InputToEventStream(&minFreeHeap, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.largest_free_block = new InputToEventStream(&largestFreeBlock, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.loop_task_stack_free = new InputToEventStream(&loopTaskStackFree, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.web_server_task_stack_free = new InputToEventStream(&webServerTaskStackFree, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.loop_duration_p50 = new InputToEventStream(&loopDurationP50, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.loop_duration_p99 = new InputToEventStream(&loopDurationP99, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.loop_duration_max = new InputToEventStream(&loopDurationMax, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.loop_jitter_p50 = new InputToEventStream(&loopJitterP50, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.loop_jitter_p99 = new InputToEventStream(&loopJitterP99, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.loop_jitter_max = new InputToEventStream(&loopJitterMax, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.loop_interval_max = new InputToEventStream(&loopIntervalMax, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.event_queue_high_water_mark = new InputToEventStream(&eventQueueHighWaterMark, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.event_queue_dropped = new InputToEventStream(&eventQueueDropped, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.alarm_messages_dropped = new InputToEventStream(&alarmMessagesDropped, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.state_updates_per_minute = new InputToEventStream(&stateUpdatesPerMinute, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.websocket_frames_per_minute = new InputToEventStream(&webSocketFramesPerMinute, TELEMETRY_SAMPLE_INTERVAL);
+  ghState.websocket_bytes_per_minute = new InputToEventStream(&webSocketBytesPerMinute, TELEMETRY_SAMPLE_INTERVAL);
   return ghState;
 }
 
+// The telemetry streams aren't in here; they're too quiet to be worth counting.
+void enableEventStreamStats(GreenhouseState* ghState) {
+  ghState->temp_unit->enableStats("temp_unit");
+  ghState->shelf_temp->enableStats("shelf_temp");
+  ghState->shelf_temp_calibration->enableStats("shelf_temp_calibration");
+  ghState->shelf_hum->enableStats("shelf_hum");
+  ghState->shelf_light->enableStats("shelf_light");
+  ghState->ground_temp->enableStats("ground_temp");
+  ghState->ground_temp_calibration->enableStats("ground_temp_calibration");
+  ghState->ceiling_temp->enableStats("ceiling_temp");
+  ghState->ceiling_temp_calibration->enableStats("ceiling_temp_calibration");
+  ghState->yuzu_temp->enableStats("yuzu_temp");
+  ghState->yuzu_temp_calibration->enableStats("yuzu_temp_calibration");
+  ghState->fish_tank_temp->enableStats("fish_tank_temp");
+  ghState->fish_tank_temp_calibration->enableStats("fish_tank_temp_calibration");
+  ghState->fan_status->enableStats("fan_status");
+  ghState->fan->enableStats("fan");
+  ghState->heater_status->enableStats("heater_status");
+  ghState->heater->enableStats("heater");
+  ghState->west_door_status->enableStats("west_door_status");
+  ghState->east_door_status->enableStats("east_door_status");
+  ghState->extreme_temp_alarm_control->enableStats("extreme_temp_alarm_control");
+  ghState->door_alarm_control->enableStats("door_alarm_control");
+  ghState->alarm_noise->enableStats("alarm_noise");
+  ghState->alarm_phone->enableStats("alarm_phone");
+  ghState->roof_vents_status->enableStats("roof_vents_status");
+  ghState->roof_vents_sensor_status->enableStats("roof_vents_sensor_status");
+  ghState->roof_vents->enableStats("roof_vents");
+  ghState->mat_1_status->enableStats("mat_1_status");
+  ghState->mat_1_temp->enableStats("mat_1_temp");
+  ghState->mat_1_temp_calibration->enableStats("mat_1_temp_calibration");
+  ghState->mat_1->enableStats("mat_1");
+  ghState->mat_2_status->enableStats("mat_2_status");
+  ghState->mat_2_temp->enableStats("mat_2_temp");
+  ghState->mat_2_temp_calibration->enableStats("mat_2_temp_calibration");
+  ghState->mat_2->enableStats("mat_2");
+  doorAlarmMessageEmitter.enableStats("door_alarm_messages");
+  dangerAlarmMessageEmitter.enableStats("danger_alarm_messages");
+  alarmMessagesCombined.enableStats("alarm_messages");
+  loopMonitor.enableStats("loop_overruns");
+}
+
+// The settings get written from the web server's task;
+// deferring them means everything downstream of them, like websocket broadcasts, runs on the loop's task instead.
+// Only the latest value of a setting matters, so they can drop old ones.
+// Alarm messages must never be dropped, so if the queue's full they go straight to the notifier's buffer.
+void deferEventStreams(GreenhouseState* ghState) {
+  const size_t settingBacklog = 2;
+  ghState->temp_unit->deferTo(&eventQueue, settingBacklog);
+  ghState->shelf_temp_calibration->deferTo(&eventQueue, settingBacklog);
+  ghState->ground_temp_calibration->deferTo(&eventQueue, settingBacklog);
+  ghState->ceiling_temp_calibration->deferTo(&eventQueue, settingBacklog);
+  ghState->yuzu_temp_calibration->deferTo(&eventQueue, settingBacklog);
+  ghState->fish_tank_temp_calibration->deferTo(&eventQueue, settingBacklog);
+  ghState->fan->deferTo(&eventQueue, settingBacklog);
+  ghState->heater->deferTo(&eventQueue, settingBacklog);
+  ghState->extreme_temp_alarm_control->deferTo(&eventQueue, settingBacklog);
+  ghState->door_alarm_control->deferTo(&eventQueue, settingBacklog);
+  ghState->alarm_noise->deferTo(&eventQueue, settingBacklog);
+  ghState->alarm_phone->deferTo(&eventQueue, settingBacklog);
+  ghState->roof_vents->deferTo(&eventQueue, settingBacklog);
+  ghState->mat_1_temp_calibration->deferTo(&eventQueue, settingBacklog);
+  ghState->mat_1->deferTo(&eventQueue, settingBacklog);
+  ghState->mat_2_temp_calibration->deferTo(&eventQueue, settingBacklog);
+  ghState->mat_2->deferTo(&eventQueue, settingBacklog);
+  alarmMessagesCombined.deferTo(&eventQueue, 4, EventOverflowPolicy::dispatchNow);
+}
+
+// The transitions people want to see after the fact, like when a door was opened.
+// The sensor streams are left out; their current value is all that matters.
+void enableEventHistory(GreenhouseState* ghState) {
+  ghState->fan_status->enableHistory(EVENT_HISTORY_LENGTH);
+  ghState->heater_status->enableHistory(EVENT_HISTORY_LENGTH);
+  ghState->west_door_status->enableHistory(EVENT_HISTORY_LENGTH);
+  ghState->east_door_status->enableHistory(EVENT_HISTORY_LENGTH);
+  ghState->roof_vents_status->enableHistory(EVENT_HISTORY_LENGTH);
+  ghState->roof_vents_sensor_status->enableHistory(EVENT_HISTORY_LENGTH);
+  ghState->mat_1_status->enableHistory(EVENT_HISTORY_LENGTH);
+  ghState->mat_2_status->enableHistory(EVENT_HISTORY_LENGTH);
+}
+
+// What /history/export can give back. The status streams' own histories only hold their last few changes;
+// this is for seeing how the temperatures went overnight, and what the outputs were doing about it.
+void enableSampleHistory(GreenhouseState* ghState) {
+  sampleHistory.track("shelf_temp", ghState->shelf_temp);
+  sampleHistory.track("shelf_hum", ghState->shelf_hum);
+  sampleHistory.track("shelf_light", ghState->shelf_light);
+  sampleHistory.track("ground_temp", ghState->ground_temp);
+  sampleHistory.track("ceiling_temp", ghState->ceiling_temp);
+  sampleHistory.track("yuzu_temp", ghState->yuzu_temp);
+  sampleHistory.track("fish_tank_temp", ghState->fish_tank_temp);
+  sampleHistory.track("mat_1_temp", ghState->mat_1_temp);
+  sampleHistory.track("mat_2_temp", ghState->mat_2_temp);
+  sampleHistory.track("fan_status", ghState->fan_status);
+  sampleHistory.track("heater_status", ghState->heater_status);
+  sampleHistory.track("roof_vents_status", ghState->roof_vents_status);
+  sampleHistory.track("mat_1_status", ghState->mat_1_status);
+  sampleHistory.track("mat_2_status", ghState->mat_2_status);
+  sampleHistory.track("west_door_status", ghState->west_door_status);
+  sampleHistory.track("east_door_status", ghState->east_door_status);
+}
+
+void enableSensorReadStats() {
+  dallasTherms.enableReadStats("dallas_therms");
+}
+
+// The lights and buzzer are left out; they're driven by alarms and the clock, not sensors.
+void enableOutputStalenessTracking() {
+  mat1Control.enableStalenessTracking("mat_1_control");
+  mat2Control.enableStalenessTracking("mat_2_control");
+  roofVentsControl.enableStalenessTracking("roof_vents_control");
+  fanControl.enableStalenessTracking("fan_control");
+  heaterControl.enableStalenessTracking("heater_control");
+}
+
+// Everything gets timed, so /metrics can say where the loop's time goes.
+void registerCostedRunnable(const char* name, Runnable* runnable) {
+  Runner::registerRunnable(new CostedRunnable(name, runnable));
+}
+
 void registerRunnables(GreenhouseState* ghState) {
-  Runner::registerRunnable(&mat1Control);
-  Runner::registerRunnable(&mat2Control);
-  Runner::registerRunnable(&roofVentsControl);
-  Runner::registerRunnable(&fanControl);
-  Runner::registerRunnable(&heaterControl);
-  Runner::registerRunnable(&doorAlarmMessageEmitter);
-  Runner::registerRunnable(&dangerAlarmMessageEmitter);
-  Runner::registerRunnable(&buzzer);
-  Runner::registerRunnable(&blueLight);
-  Runner::registerRunnable(&redLight);
-  Runner::registerRunnable(&greenLight);
-  Runner::registerRunnable(ghState->shelf_temp);
-  Runner::registerRunnable(ghState->shelf_hum);
-  Runner::registerRunnable(ghState->shelf_light);
-  Runner::registerRunnable(ghState->ground_temp);
-  Runner::registerRunnable(ghState->ceiling_temp);
-  Runner::registerRunnable(ghState->yuzu_temp);
-  Runner::registerRunnable(ghState->fan_status);
-  Runner::registerRunnable(ghState->heater_status);
-  Runner::registerRunnable(ghState->west_door_status);
-  Runner::registerRunnable(ghState->east_door_status);
-  Runner::registerRunnable(ghState->roof_vents_status);
-  Runner::registerRunnable(ghState->roof_vents_sensor_status);
-  Runner::registerRunnable(ghState->mat_1_status);
-  Runner::registerRunnable(ghState->mat_1_temp);
-  Runner::registerRunnable(ghState->mat_2_status);
-  Runner::registerRunnable(ghState->mat_2_temp);
+  // First, so that it times everything else.
+  Runner::registerTickObserver(&loopMonitor);
+  // An overrun means the alarms might not have been serviced in time.
+  // Turn the fault light on for a while so that someone notices; the loop stats on the web page will say how bad it got.
+  loopMonitor.registerSubscriber([](Event<LoopOverrun> e) { lastLoopOverrunAt = tickClock.nowMillis(); });
+  // Before anything that might read it.
+  Runner::registerTickObserver(&tickClock);
+  // Before the event queue, so that the websocket message at the end of a tick includes the deferred events.
+  stateUpdateFrames.setFlushInterval(STATE_UPDATE_FLUSH_INTERVAL);
+  Runner::registerTickObserver(&stateUpdateFrames);
+  // After the loop monitor, so that dispatching deferred events counts towards the tick time.
+  Runner::registerTickObserver(&eventQueue);
+  registerCostedRunnable("mat_1_control", &mat1Control);
+  registerCostedRunnable("mat_2_control", &mat2Control);
+  registerCostedRunnable("roof_vents_control", &roofVentsControl);
+  registerCostedRunnable("fan_control", &fanControl);
+  registerCostedRunnable("heater_control", &heaterControl);
+  registerCostedRunnable("door_alarm_message_emitter", &doorAlarmMessageEmitter);
+  registerCostedRunnable("danger_alarm_message_emitter", &dangerAlarmMessageEmitter);
+  registerCostedRunnable("buzzer", &buzzer);
+  registerCostedRunnable("blue_light", &blueLight);
+  registerCostedRunnable("red_light", &redLight);
+  registerCostedRunnable("green_light", &greenLight);
+  registerCostedRunnable("shelf_temp", ghState->shelf_temp);
+  registerCostedRunnable("shelf_hum", ghState->shelf_hum);
+  registerCostedRunnable("shelf_light", ghState->shelf_light);
+  registerCostedRunnable("ground_temp", ghState->ground_temp);
+  registerCostedRunnable("ceiling_temp", ghState->ceiling_temp);
+  registerCostedRunnable("yuzu_temp", ghState->yuzu_temp);
+  registerCostedRunnable("fish_tank_temp", ghState->fish_tank_temp);
+  registerCostedRunnable("fan_status", ghState->fan_status);
+  registerCostedRunnable("heater_status", ghState->heater_status);
+  registerCostedRunnable("west_door_status", ghState->west_door_status);
+  registerCostedRunnable("east_door_status", ghState->east_door_status);
+  registerCostedRunnable("roof_vents_status", ghState->roof_vents_status);
+  registerCostedRunnable("roof_vents_sensor_status", ghState->roof_vents_sensor_status);
+  registerCostedRunnable("mat_1_status", ghState->mat_1_status);
+  registerCostedRunnable("mat_1_temp", ghState->mat_1_temp);
+  registerCostedRunnable("mat_2_status", ghState->mat_2_status);
+  registerCostedRunnable("mat_2_temp", ghState->mat_2_temp);
+  registerCostedRunnable("free_heap", ghState->free_heap);
+  registerCostedRunnable("min_free_heap", ghState->min_free_heap);
+  registerCostedRunnable("largest_free_block", ghState->largest_free_block);
+  registerCostedRunnable("loop_task_stack_free", ghState->loop_task_stack_free);
+  registerCostedRunnable("web_server_task_stack_free", ghState->web_server_task_stack_free);
+  registerCostedRunnable("loop_duration_p50", ghState->loop_duration_p50);
+  registerCostedRunnable("loop_duration_p99", ghState->loop_duration_p99);
+  registerCostedRunnable("loop_duration_max", ghState->loop_duration_max);
+  registerCostedRunnable("loop_jitter_p50", ghState->loop_jitter_p50);
+  registerCostedRunnable("loop_jitter_p99", ghState->loop_jitter_p99);
+  registerCostedRunnable("loop_jitter_max", ghState->loop_jitter_max);
+  registerCostedRunnable("loop_interval_max", ghState->loop_interval_max);
+  registerCostedRunnable("event_queue_high_water_mark", ghState->event_queue_high_water_mark);
+  registerCostedRunnable("event_queue_dropped", ghState->event_queue_dropped);
+  registerCostedRunnable("alarm_messages_dropped", ghState->alarm_messages_dropped);
+  registerCostedRunnable("state_updates_per_minute", ghState->state_updates_per_minute);
+  registerCostedRunnable("websocket_frames_per_minute", ghState->websocket_frames_per_minute);
+  registerCostedRunnable("websocket_bytes_per_minute", ghState->websocket_bytes_per_minute);
+  // Keeps trying websocket clients that were too busy for the last state update.
+  registerCostedRunnable("state_server", &stateServer);
+  // Last, so that each row has the values from the tick it was taken in.
+  registerCostedRunnable("sample_history", &sampleHistory);
 }
 
 void setup() {
@@ -423,9 +690,17 @@ void setup() {
   Serial.println(WiFi.localIP());
   Serial.println("Starting up web server...");
   ghState = initGreenhouseState();
+  enableEventStreamStats(&ghState);
+  enableEventHistory(&ghState);
+  enableOutputStalenessTracking();
+  enableSensorReadStats();
+  enableSampleHistory(&ghState);
+  deferEventStreams(&ghState);
   setupWebServer(&ghState);
   Serial.println("Web server started!");
   registerRunnables(&ghState);
+  trackAlarmRecipient();
+  xTaskCreate(sendAlarmMessages, "alarm_messages", ALARM_MESSAGE_TASK_STACK_SIZE, nullptr, 1, nullptr);
 }
 
 void loop() {
@@ -27,11 +27,17 @@ class TwilioMessageNotifier {
     Twilio _client;
   
   public:
-    TwilioMessageNotifier(EventStream<std::string>* eventStream, Input<TwilioConfig>* configInput)
+    // Call sendMessage() yourself, e.g., from a BufferedSubscriber, so the HTTPS call happens off the loop's task.
+    TwilioMessageNotifier(Input<TwilioConfig>* configInput)
     :
       _configInput(configInput),
       _lastSeenConfig(configInput->read()),
       _client(_lastSeenConfig.accountId.c_str(), _lastSeenConfig.authToken.c_str())
+    { }
+
+    // Sends every message the stream emits, right there on the emitter's task.
+    TwilioMessageNotifier(EventStream<std::string>* eventStream, Input<TwilioConfig>* configInput)
+    : TwilioMessageNotifier(configInput)
     {
       eventStream->registerSubscriber([this](Event<std::string> e) { this->sendMessage(e.value); });
     }
@@ -1,7 +1,7 @@
 #ifndef RHEOSCAPE_ANALOG_PIN_OUTPUT_H
 #define RHEOSCAPE_ANALOG_PIN_OUTPUT_H
 
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
 #include <Arduino.h>
 #include <input/Input.h>
@@ -11,6 +11,7 @@ class AnalogPinOutput : public Output {
   private:
     uint8_t _pin;
     Input<float>* _input;
+    std::optional<int> _lastValue;
 
   public:
     AnalogPinOutput(uint8_t pin, Input<float>* input)
@@ -22,7 +23,13 @@ class AnalogPinOutput : public Output {
     }
 
     virtual void run() {
-      analogWrite(_pin, _input->read() * 255);
+      SampleTrace trace;
+      int value = _input->read() * 255;
+      if (_lastValue != value) {
+        _recordStaleness(trace);
+        _lastValue = value;
+      }
+      analogWrite(_pin, value);
     }
 };
 
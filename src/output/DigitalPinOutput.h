@@ -1,8 +1,9 @@
 #ifndef RHEOSCAPE_DIGITAL_PIN_OUTPUT_H
 #define RHEOSCAPE_DIGITAL_PIN_OUTPUT_H
 
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
+#include <Arduino.h>
 #include <Runnable.h>
 #include <input/Input.h>
 #include <output/Output.h>
@@ -13,6 +14,7 @@ class DigitalPinOutput : public Output {
     bool _onState;
     uint8_t _pin;
     Input<bool>* _input;
+    std::optional<bool> _lastLevel;
 
   public:
     DigitalPinOutput(uint8_t pin, bool onState, Input<bool>* input)
@@ -25,7 +27,13 @@ class DigitalPinOutput : public Output {
     }
 
     virtual void run() {
-      digitalWrite(_pin, _input->read() ? _onState : !_onState);
+      SampleTrace trace;
+      bool level = _input->read() ? _onState : !_onState;
+      if (_lastLevel != level) {
+        _recordStaleness(trace);
+        _lastLevel = level;
+      }
+      digitalWrite(_pin, level);
     }
 };
 
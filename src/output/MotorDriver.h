@@ -1,8 +1,9 @@
 #ifndef RHEOSCAPE_MOTOR_DRIVER_H
 #define RHEOSCAPE_MOTOR_DRIVER_H
 
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
+#include <Arduino.h>
 #include <input/Input.h>
 #include <output/Output.h>
 
@@ -14,6 +15,7 @@ class MotorDriver : public Output {
     // Does setting a pin HIGH activate it or deactivate it?
     bool _controlPinActiveState;
     Input<float>* _input;
+    std::optional<float> _lastValue;
 
   public:
     MotorDriver(uint8_t forwardPin, uint8_t backwardPin, uint8_t pwmPin, bool controlPinActiveState, Input<float>* input)
@@ -31,11 +33,17 @@ class MotorDriver : public Output {
     }
 
     virtual void run() {
+      SampleTrace trace;
       std::optional<float> value = _input->read();
       if (!value.has_value()) {
         return;
       }
 
+      if (_lastValue != value) {
+        _recordStaleness(trace);
+        _lastValue = value;
+      }
+
       if (_pwmPin > 0) {
         // Normalise -1...0 to 0...1023 and 0...1 to 0...1023 too, to drive PWM pins.
         // Positive vs negative happens in the next step.
@@ -1,7 +1,13 @@
 #ifndef RHEOSCAPE_OUTPUT_H
 #define RHEOSCAPE_OUTPUT_H
 
+#include <memory>
+#include <vector>
+
+#include <Histogram.h>
 #include <Runnable.h>
+#include <SampleTrace.h>
+#include <StatsRegistry.h>
 
 // An output is not a special type of thing with its own class;
 // it's just a pattern of taking an input and implementing a run() function,
@@ -15,6 +21,52 @@
 // Be even gentler with things that have inductive loads in them.
 #define INDUCTIVE_LOAD_CYCLE_TIME 1000 * 60
 
-class Output : public Runnable { };
+// How old the sensor samples behind an output's value were when the output acted on it,
+// e.g., from a DS18B20 finishing its conversion to the mat heater's relay switching.
+// That covers timer polling, calibration, control processes, everything.
+class OutputStaleness : public StatsRegistry<OutputStaleness> {
+  public:
+    const char* name;
+    LogBucketHistogram micros;
+    // How many times the output has actually changed what it's doing, e.g., relay clicks.
+    uint32_t changes;
+
+    OutputStaleness(const char* name)
+    :
+      name(name),
+      changes(0)
+    { }
+};
+
+class Output : public Runnable {
+  private:
+    std::shared_ptr<OutputStaleness> _staleness;
+
+  protected:
+    // Outputs should read their input inside a SampleTrace,
+    // then call this with it whenever they actually change what they're doing.
+    void _recordStaleness(const SampleTrace& trace) {
+      if (!_staleness) {
+        return;
+      }
+      _staleness->changes ++;
+      std::optional<unsigned long> age = trace.getAge();
+      if (age.has_value()) {
+        _staleness->micros.record(age.value());
+      }
+    }
+
+  public:
+    // The name shows up wherever OutputStaleness::all() gets reported.
+    void enableStalenessTracking(const char* name) {
+      if (!_staleness) {
+        _staleness = OutputStaleness::create(name);
+      }
+    }
+
+    std::shared_ptr<OutputStaleness> getStaleness() const {
+      return _staleness;
+    }
+};
 
 #endif
\ No newline at end of file
@@ -1,7 +1,7 @@
 #ifndef RHEOSCAPE_OUTPUT_FACTORIES_H
 #define RHEOSCAPE_OUTPUT_FACTORIES_H
 
-#ifdef PLATFORM_ARDUINO
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_DEV_MACHINE)
 
 #include <input/Input.h>
 #include <input/TimeProcesses.h>
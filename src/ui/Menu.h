@@ -34,7 +34,8 @@ class Menu : public InteractiveWidget {
 
       // Never bubble, because all the children's event streams are already piped through this one.
       // Including the selected child.
-      // FIXME: Is this a performance problem? Should I be doing some sort of smart routing of events instead?
+      // Menus whose items are known at compile time can use NavFocus from ui/NavRouter.h instead,
+      // which only calls the selected item and skips the rebroadcasting.
       return false;
     }
   
@@ -1,18 +1,23 @@
 #ifndef RHEOSCAPE_NAV_BUTTON_CLUSTER_H
 #define RHEOSCAPE_NAV_BUTTON_CLUSTER_H
 
+#include <cstdint>
+
 #include <event_stream/EventStream.h>
 #include <event_stream/FancyPushbutton.h>
 
-enum NavButton {
-  navbutton_up,
-  navbutton_down,
-  navbutton_left,
-  navbutton_right,
-  navbutton_ok,
-  navbutton_back
+// Bit flags, so that you can OR them together to ask about more than one button at a time.
+enum NavButton : uint8_t {
+  navbutton_up = 1,
+  navbutton_down = 2,
+  navbutton_left = 4,
+  navbutton_right = 8,
+  navbutton_ok = 16,
+  navbutton_back = 32
 };
 
+const uint8_t navbutton_all = navbutton_up | navbutton_down | navbutton_left | navbutton_right | navbutton_ok | navbutton_back;
+
 struct NavButtonClusterEvent {
   NavButton button;
   FancyPushbuttonEvent event;
@@ -20,20 +25,29 @@ struct NavButtonClusterEvent {
   NavButtonClusterEvent(NavButton button, FancyPushbuttonEvent event)
   : button(button), event(event) { }
 
-  bool isPressed(NavButton buttons) {
-    return button | buttons && event == button_press;
+  bool isPressed(uint8_t buttons) const {
+    return (button & buttons) && event == button_press;
   }
 };
 
+// Merges the six buttons into one stream.
+// The buttons have to outlive it; it only subscribes to them.
 class NavButtonCluster : public EventStream<NavButtonClusterEvent> {
+  private:
+    void _forward(FancyPushbutton* pushbutton, NavButton button) {
+      pushbutton->registerSubscriber([this, button](const Event<FancyPushbuttonEvent>& event) {
+        this->_emit(Event<NavButtonClusterEvent>(event.timestamp, NavButtonClusterEvent(button, event.value)));
+      });
+    }
+
   public:
-    NavButtonCluster(FancyPushbutton upButton, FancyPushbutton downButton, FancyPushbutton leftButton, FancyPushbutton rightButton, FancyPushbutton okButton, FancyPushbutton backButton) {
-      upButton.registerSubscriber([this](Event<FancyPushbuttonEvent> event) { this->_emit(Event<NavButtonClusterEvent>(event.timestamp, NavButtonClusterEvent(navbutton_up, event.value))); });
-      downButton.registerSubscriber([this](Event<FancyPushbuttonEvent> event) { this->_emit(Event<NavButtonClusterEvent>(event.timestamp, NavButtonClusterEvent(navbutton_down, event.value))); });
-      leftButton.registerSubscriber([this](Event<FancyPushbuttonEvent> event) { this->_emit(Event<NavButtonClusterEvent>(event.timestamp, NavButtonClusterEvent(navbutton_left, event.value))); });
-      rightButton.registerSubscriber([this](Event<FancyPushbuttonEvent> event) { this->_emit(Event<NavButtonClusterEvent>(event.timestamp, NavButtonClusterEvent(navbutton_right, event.value))); });
-      okButton.registerSubscriber([this](Event<FancyPushbuttonEvent> event) { this->_emit(Event<NavButtonClusterEvent>(event.timestamp, NavButtonClusterEvent(navbutton_ok, event.value))); });
-      backButton.registerSubscriber([this](Event<FancyPushbuttonEvent> event) { this->_emit(Event<NavButtonClusterEvent>(event.timestamp, NavButtonClusterEvent(navbutton_back, event.value))); });
+    NavButtonCluster(FancyPushbutton* upButton, FancyPushbutton* downButton, FancyPushbutton* leftButton, FancyPushbutton* rightButton, FancyPushbutton* okButton, FancyPushbutton* backButton) {
+      _forward(upButton, navbutton_up);
+      _forward(downButton, navbutton_down);
+      _forward(leftButton, navbutton_left);
+      _forward(rightButton, navbutton_right);
+      _forward(okButton, navbutton_ok);
+      _forward(backButton, navbutton_back);
     }
 };
 
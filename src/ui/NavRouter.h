@@ -0,0 +1,127 @@
+#ifndef RHEOSCAPE_NAV_ROUTER_H
+#define RHEOSCAPE_NAV_ROUTER_H
+
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <event_stream/EventStream.h>
+#include <ui/NavButtonCluster.h>
+
+// Routes nav button events to widgets through a tree that's put together at compile time,
+// so handing an event down is a chain of direct (and mostly inlined) calls
+// rather than a walk through a vector of std::functions at every level.
+//
+// A nav handler is anything with a method
+//
+//   bool handleNavEvent(const Event<NavButtonClusterEvent>& event)
+//
+// that returns true if the event should bubble on to the next handler, like the widgets' _handle...AndShouldBubble() methods.
+// It can also have a
+//
+//   static constexpr uint8_t navButtons
+//
+// of the NavButton flags it cares about, and it won't even be called for the others.
+// The routers below are nav handlers themselves, so they nest.
+
+template <typename THandler, typename = void>
+struct NavButtonsOf {
+  static constexpr uint8_t value = navbutton_all;
+};
+
+template <typename THandler>
+struct NavButtonsOf<THandler, std::void_t<decltype(THandler::navButtons)>> {
+  static constexpr uint8_t value = THandler::navButtons;
+};
+
+template <typename THandler>
+inline bool offerNavEvent(THandler& handler, const Event<NavButtonClusterEvent>& event) {
+  if (!(event.value.button & NavButtonsOf<THandler>::value)) {
+    return true;
+  }
+  return handler.handleNavEvent(event);
+}
+
+// Offers every event to each handler in turn, until one of them captures it.
+template <typename... THandlers>
+class NavChain {
+  private:
+    std::tuple<THandlers&...> _handlers;
+
+  public:
+    static constexpr uint8_t navButtons = (NavButtonsOf<THandlers>::value | ... | 0);
+
+    NavChain(THandlers&... handlers)
+    : _handlers(handlers...)
+    { }
+
+    bool handleNavEvent(const Event<NavButtonClusterEvent>& event) {
+      return std::apply([&event](auto&... handlers) { return (offerNavEvent(handlers, event) && ...); }, _handlers);
+    }
+};
+
+// Only lets the focused child see events, e.g., the selected item in a menu.
+// Which child that is can change at run time, but the set of children can't;
+// dispatch goes through a table of function pointers that's built at compile time.
+template <typename... TChildren>
+class NavFocus {
+  private:
+    using Children = std::tuple<TChildren&...>;
+    using Dispatcher = bool (*)(Children&, const Event<NavButtonClusterEvent>&);
+
+    template <size_t I>
+    static bool _dispatchTo(Children& children, const Event<NavButtonClusterEvent>& event) {
+      return offerNavEvent(std::get<I>(children), event);
+    }
+
+    template <size_t... I>
+    static constexpr std::array<Dispatcher, sizeof...(TChildren)> _makeTable(std::index_sequence<I...>) {
+      return { &_dispatchTo<I>... };
+    }
+
+    static constexpr std::array<Dispatcher, sizeof...(TChildren)> _table = _makeTable(std::index_sequence_for<TChildren...>());
+
+    Children _children;
+    size_t _focused;
+
+  public:
+    static constexpr uint8_t navButtons = (NavButtonsOf<TChildren>::value | ... | 0);
+
+    NavFocus(TChildren&... children)
+    :
+      _children(children...),
+      _focused(0)
+    { }
+
+    bool handleNavEvent(const Event<NavButtonClusterEvent>& event) {
+      return _table[_focused](_children, event);
+    }
+
+    // Out-of-range indexes are ignored.
+    void focus(size_t index) {
+      if (index < sizeof...(TChildren)) {
+        _focused = index;
+      }
+    }
+
+    size_t getFocus() const {
+      return _focused;
+    }
+
+    static constexpr size_t size() {
+      return sizeof...(TChildren);
+    }
+};
+
+// Hook the top of a routing tree up to a stream, usually a NavButtonCluster.
+// That's the only std::function call between a button and the widget that handles it.
+template <typename TRouter>
+Subscription routeNavEvents(EventStream<NavButtonClusterEvent>* eventStream, TRouter* router) {
+  return eventStream->registerSubscriber([router](const Event<NavButtonClusterEvent>& event) {
+    offerNavEvent(*router, event);
+  });
+}
+
+#endif
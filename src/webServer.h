@@ -2,201 +2,501 @@
 #define WEB_SERVER_H
 
 #include <string>
+#include <vector>
 #include <WiFi.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
-#include <Range.h>
 #include <helpers/string_format.h>
 #include <input/Input.h>
 #include <input/GpioInputs.h>
+#include <input/SensorReadStats.h>
+#include <event_stream/ChangeFrame.h>
 #include <output/OutputFactories.h>
 #include <GreenhouseState.h>
+#include <HistoryExport.h>
 #include <JsonConverters.h>
+#include <PrometheusWriter.h>
+#include <RunnableCost.h>
+#include <SampleHistory.h>
+#include <StateProtocol.h>
+#include <StateServer.h>
 
 extern const uint8_t src_greenhouse_index_html_start[] asm("_binary_src_greenhouse_index_html_start");
 extern const uint8_t src_greenhouse_index_html_end[]   asm("_binary_src_greenhouse_index_html_end");
+extern const uint8_t src_greenhouse_index_html_gz_start[] asm("_binary_src_greenhouse_index_html_gz_start");
+extern const uint8_t src_greenhouse_index_html_gz_end[]   asm("_binary_src_greenhouse_index_html_gz_end");
+
+// scripts/compress_web_assets.py works this out from the page when it builds the gzipped copy.
+// Without it, the build time will do; it only has to change when the page does.
+#ifndef GREENHOUSE_INDEX_HASH
+#define GREENHOUSE_INDEX_HASH __DATE__ " " __TIME__
+#endif
 
 static AsyncWebServer server(80);
 static AsyncWebSocket ws("/ws");
 
-enum WebSocketMessageType {
-  stateUpdated,
+// Sends StateServer's messages through ESPAsyncWebServer.
+// A message going to more than one client goes in one buffer that they all share, like textAll() does.
+class AsyncWebSocketTransport : public WebSocketTransport {
+  public:
+    // A client isn't ready when AsyncTCP's queue for it is full;
+    // its outbox holds on to what it's owed until it is.
+    bool isReady(uint32_t clientId) {
+      AsyncWebSocketClient* client = ws.client(clientId);
+      return client && !client->queueIsFull();
+    }
+
+    size_t send(const std::vector<uint32_t>& clientIds, const uint8_t* message, size_t length, bool binary) {
+      // The message is already written, so the buffer can be made exactly the right size and filled with one copy.
+      AsyncWebSocketMessageBuffer* buffer = ws.makeBuffer(length);
+      if (!buffer) {
+        return 0;
+      }
+      memcpy(buffer->get(), message, length);
+      size_t bytesSent = 0;
+      buffer->lock();
+      for (uint32_t id : clientIds) {
+        AsyncWebSocketClient* client = ws.client(id);
+        if (!client) {
+          continue;
+        }
+        if (binary) {
+          client->binary(buffer);
+        } else {
+          client->text(buffer);
+        }
+        bytesSent += length;
+      }
+      buffer->unlock();
+      ws._cleanBuffers();
+      return bytesSent;
+    }
 };
 
+static AsyncWebSocketTransport webSocketTransport;
+
+// Collects the changes to the greenhouse state over a tick (or longer, with a flush interval),
+// so they can go out in one websocket message.
+// Register it as a tick observer.
+static FrameCollector<JsonDocument> stateUpdateFrames;
+
+// A client gets every field until it sends {"type":"subscribe","data":{"keys":[...],"prefixes":[...]}},
+// after which it only gets frames with those fields in them, and only those fields.
+// Subscribing with neither keys nor prefixes goes back to everything.
+//
+// Each client has its own outbox, so one that's slow to take its messages just gets fewer, fresher ones,
+// rather than filling up AsyncTCP's queue.
+static StateServer stateServer(&stateUpdateFrames.getKeys(), &webSocketTransport);
+
+// A day of five-minute samples of the sensors and outputs, for /history/export.
+// Track its fields before registering it as a runnable.
+static SampleHistory sampleHistory(288, 300000);
+
+void publishStateUpdated(ChangeFrame<JsonDocument> frame) {
+  publishStateFrame(&stateServer, frame);
+}
+
 template <typename T>
-struct WebSocketMessage {
-  WebSocketMessageType type;
-  T data;
+void broadcastChangesOf(const char* key, EventStream<T>* stream) {
+  stateUpdateFrames.track(key, stream, [](const T& value) {
+    JsonDocument valueAsJson;
+    valueAsJson.set(value);
+    return valueAsJson;
+  });
+}
+
+// A file that's embedded in flash, along with a gzipped copy of it.
+// The two copies are different representations, so they get different ETags.
+struct EmbeddedAsset {
+  const char* contentType;
+  const uint8_t* content;
+  size_t size;
+  const char* etag;
+  const uint8_t* gzipContent;
+  size_t gzipSize;
+  const char* gzipEtag;
 };
 
-template <typename T>
-void sendWebSocketMessage(WebSocketMessage<T> message) {
-  JsonObject jsonDoc;
-  jsonDoc["type"] = message.type;
-  jsonDoc["data"] = message.data;
-  size_t len = measureJson(jsonDoc);
-  AsyncWebSocketMessageBuffer* buffer = ws.makeBuffer(len);
-  if (buffer) {
-    serializeJson(jsonDoc, (char*)buffer->get(), len);
-    ws.textAll(buffer);
+// Sends the asset straight out of flash, gzipped if the browser can take it,
+// or just a 304 if the browser's copy is still the right one.
+// Browsers check back every time (no-cache), but that's cheap now.
+void sendEmbeddedAsset(AsyncWebServerRequest* request, const EmbeddedAsset& asset) {
+  bool gzip = request->hasHeader("Accept-Encoding") && request->header("Accept-Encoding").indexOf("gzip") >= 0;
+  const char* etag = gzip ? asset.gzipEtag : asset.etag;
+  AsyncWebServerResponse* response;
+  if (request->hasHeader("If-None-Match") && request->header("If-None-Match").indexOf(etag) >= 0) {
+    response = request->beginResponse(304);
+  } else if (gzip) {
+    response = request->beginResponse_P(200, asset.contentType, asset.gzipContent, asset.gzipSize);
+    response->addHeader("Content-Encoding", "gzip");
+  } else {
+    response = request->beginResponse_P(200, asset.contentType, asset.content, asset.size);
   }
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-cache");
+  response->addHeader("Vary", "Accept-Encoding");
+  request->send(response);
 }
 
-void sendStateUpdatedMessages(std::map<std::string, JsonDocument> messages) {
-  JsonObject data;
-  for (std::pair<std::string, JsonDocument> const kvp : messages) {
-    data[kvp.first] = kvp.second;
+static const EmbeddedAsset greenhouseIndexHtml {
+  "text/html",
+  src_greenhouse_index_html_start,
+  // Embedded text files get a null terminator, which isn't part of the page.
+  (size_t)(src_greenhouse_index_html_end - src_greenhouse_index_html_start) - 1,
+  "\"" GREENHOUSE_INDEX_HASH "\"",
+  src_greenhouse_index_html_gz_start,
+  (size_t)(src_greenhouse_index_html_gz_end - src_greenhouse_index_html_gz_start),
+  "\"" GREENHOUSE_INDEX_HASH "-gzip\""
+};
+
+// Adds the events after the sequence number in the request's `key` parameter, if there is one.
+// `complete` says whether the history went back far enough; if it didn't, fetch /allState instead.
+template <typename T>
+void addEventHistory(JsonObject dest, const char* key, EventStream<T>* stream, AsyncWebServerRequest* request) {
+  if (!request->hasParam(key)) {
+    return;
   }
-  WebSocketMessage<JsonObject> message = { WebSocketMessageType::stateUpdated, data };
-  sendWebSocketMessage(message);
+  uint32_t afterSequence = request->getParam(key)->value().toInt();
+  JsonObject history = dest[key].to<JsonObject>();
+  bool complete = stream->historyCovers(afterSequence);
+  history["complete"] = complete;
+  // The sequence number to pick up from next time is the last one that actually went out,
+  // so that anything emitted after forEachInHistory() finished doesn't get skipped.
+  // If there's nothing to send and the client has to start over, it's wherever the stream is now.
+  uint32_t lastSequence = complete ? afterSequence : stream->getSequence();
+  JsonArray events = history["events"].to<JsonArray>();
+  stream->forEachInHistory(afterSequence, [&events, &lastSequence](const Event<T>& event, uint32_t sequence) {
+    JsonObject entry = events.add<JsonObject>();
+    entry["sequence"] = sequence;
+    entry["timestamp"] = event.timestamp;
+    entry["value"] = event.value;
+    lastSequence = sequence;
+  });
+  history["sequence"] = lastSequence;
 }
 
-template <typename T>
-void sendStateUpdatedMessage(std::string key, T value) {
-  JsonDocument valueAsJson;
-  valueAsJson.set(value);
-  std::map<std::string, JsonDocument> obj;
-  obj[key] = valueAsJson;
-  sendStateUpdatedMessages(obj);
+// For parameters that might not fit in the long that String::toInt() gives back, like uptimes in milliseconds.
+unsigned long getUnsignedParam(AsyncWebServerRequest* request, const char* key, unsigned long defaultValue) {
+  if (!request->hasParam(key)) {
+    return defaultValue;
+  }
+  return strtoul(request->getParam(key)->value().c_str(), nullptr, 10);
 }
 
-void updateTwoPointCalibrationValue(StateInput<TwoPointCalibration<float>>* input, std::string prop, float newPropValue) {
-  TwoPointCalibration<float> oldValue = input->read();
-  input->write(TwoPointCalibration(
-    prop == "low_reference" ? newPropValue : oldValue.lowReference,
-    prop == "low_raw" ? newPropValue : oldValue.lowRaw,
-    prop == "high_reference" ? newPropValue : oldValue.highReference,
-    prop == "high_raw" ? newPropValue : oldValue.highRaw
-  ));
+// For a connect event, the arg is the upgrade request, which is where the client says what encoding it wants.
+void registerWebSocketClient(AsyncWebSocketClient* client, AsyncWebServerRequest* request) {
+  WebSocketEncoding encoding = request->hasParam("encoding") && request->getParam("encoding")->value() == "msgpack"
+    ? WebSocketEncoding::msgpack
+    : WebSocketEncoding::json;
+  stateServer.connect(client->id(), encoding);
 }
 
 void receiveWebSocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len, GreenhouseState* ghState) {
-  if (type == WS_EVT_DATA) {
-    uint8_t* messageData;
+  if (type == WS_EVT_CONNECT) {
+    registerWebSocketClient(client, (AsyncWebServerRequest*)arg);
+  } else if (type == WS_EVT_DISCONNECT) {
+    stateServer.disconnect(client->id());
+  } else if (type == WS_EVT_DATA) {
     AwsFrameInfo* info = (AwsFrameInfo*) arg;
-
-    if (info->final && info->index == 0 && info->len == len) {
-      // The whole message is in a single frame and we got all of its data.
-      data[len] = 0;
-      messageData = data;
-    } else {
-      // Given that a frame can theoretically be 9 exabytes long,
-      // and I don't imagine I'll ever try to stream fragmented frames,
-      // we're not going to try to figure out how to compile multiple frames into one byte array.
+    // Given that a frame can theoretically be 9 exabytes long,
+    // and I don't imagine I'll ever try to stream fragmented frames,
+    // we're not going to try to figure out how to compile multiple frames into one byte array.
+    if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
+      receiveStateMessage(&stateServer, client->id(), (const char*)data, len, ghState);
     }
+  }
+}
 
-    JsonDocument messageJson;
-    deserializeJson(messageJson, messageData);
-
-    if (strcmp(messageJson["type"], "setState")) {
-      JsonObject setStateData = messageJson["data"];
-      for (JsonPair kvp : setStateData) {
-        std::string stateToUpdate = std::string(kvp.key().c_str());
-        if (stateToUpdate == "temp_unit") {
-          std::string newTempUnit = kvp.value().as<std::string>();
-          if (newTempUnit == "celsius") {
-            ghState->temp_unit->write(TempUnit::celsius);
-          } else if (newTempUnit == "fahrenheit") {
-            ghState->temp_unit->write(TempUnit::fahrenheit);
-          } else if (newTempUnit == "kelvin") {
-            ghState->temp_unit->write(TempUnit::kelvin);
-          }
-        } else if (stateToUpdate == "fan_control_setpoint") {
-          ghState->fan->write(SetpointAndHysteresis(kvp.value().as<float>(), ghState->fan->read().hysteresis));
-        } else if (stateToUpdate == "fan_control_hysteresis") {
-          ghState->fan->write(SetpointAndHysteresis(ghState->fan->read().setpoint, kvp.value().as<float>()));
-        } else if (stateToUpdate == "heater_control_setpoint") {
-          ghState->heater->write(SetpointAndHysteresis(kvp.value().as<float>(), ghState->heater->read().hysteresis));
-        } else if (stateToUpdate == "heater_control_hysteresis") {
-          ghState->heater->write(SetpointAndHysteresis(ghState->heater->read().setpoint, kvp.value().as<float>()));
-        } else if (stateToUpdate == "extreme_temp_alarm_control_min") {
-          ghState->extreme_temp_alarm_control->write(Range(kvp.value().as<float>(), ghState->extreme_temp_alarm_control->read().max));
-        } else if (stateToUpdate == "extreme_temp_alarm_control_max") {
-          ghState->extreme_temp_alarm_control->write(Range(ghState->extreme_temp_alarm_control->read().min, kvp.value().as<float>()));
-        } else if (stateToUpdate == "door_alarm_control_min") {
-          ghState->door_alarm_control->write(Range(kvp.value().as<float>(), ghState->door_alarm_control->read().max));
-        } else if (stateToUpdate == "door_alarm_control_max") {
-          ghState->door_alarm_control->write(Range(ghState->door_alarm_control->read().min, kvp.value().as<float>()));
-        } else if (stateToUpdate == "roof_vents_control_setpoint") {
-          ghState->roof_vents->write(SetpointAndHysteresis(kvp.value().as<float>(), ghState->roof_vents->read().hysteresis));
-        } else if (stateToUpdate == "roof_vents_control_hysteresis") {
-          ghState->roof_vents->write(SetpointAndHysteresis(ghState->roof_vents->read().setpoint, kvp.value().as<float>()));
-        } else if (stateToUpdate == "mat_1_control_setpoint") {
-          ghState->mat_1->write(SetpointAndHysteresis(kvp.value().as<float>(), ghState->mat_1->read().hysteresis));
-        } else if (stateToUpdate == "mat_1_control_hysteresis") {
-          ghState->mat_1->write(SetpointAndHysteresis(ghState->mat_1->read().setpoint, kvp.value().as<float>()));
-        } else if (stateToUpdate == "mat_2_control_setpoint") {
-          ghState->mat_2->write(SetpointAndHysteresis(kvp.value().as<float>(), ghState->mat_2->read().hysteresis));
-        } else if (stateToUpdate == "mat_2_control_hysteresis") {
-          ghState->mat_2->write(SetpointAndHysteresis(ghState->mat_2->read().setpoint, kvp.value().as<float>()));
-        } else if (stateToUpdate.substr(0, 22) == "shelf_temp_calibration") {
-          updateTwoPointCalibrationValue(ghState->shelf_temp_calibration, stateToUpdate.substr(22), kvp.value().as<float>());
-        } else if (stateToUpdate.substr(0, 23) == "ground_temp_calibration") {
-          updateTwoPointCalibrationValue(ghState->ground_temp_calibration, stateToUpdate.substr(23), kvp.value().as<float>());
-        } else if (stateToUpdate.substr(0, 24) == "ceiling_temp_calibration") {
-          updateTwoPointCalibrationValue(ghState->ceiling_temp_calibration, stateToUpdate.substr(24), kvp.value().as<float>());
-        } else if (stateToUpdate.substr(0, 21) == "yuzu_temp_calibration") {
-          updateTwoPointCalibrationValue(ghState->yuzu_temp_calibration, stateToUpdate.substr(21), kvp.value().as<float>());
-        } else if (stateToUpdate.substr(0, 21) == "fish_tank_temp_calibration") {
-          updateTwoPointCalibrationValue(ghState->fish_tank_temp_calibration, stateToUpdate.substr(21), kvp.value().as<float>());
-        } else if (stateToUpdate.substr(0, 22) == "mat_1_temp_calibration") {
-          updateTwoPointCalibrationValue(ghState->mat_1_temp_calibration, stateToUpdate.substr(22), kvp.value().as<float>());
-        } else if (stateToUpdate.substr(0, 22) == "mat_2_temp_calibration") {
-          updateTwoPointCalibrationValue(ghState->mat_2_temp_calibration, stateToUpdate.substr(22), kvp.value().as<float>());
-        }
-      }
-    }
+template <typename TSink, typename T>
+void writeScaledSample(PrometheusWriter<TSink>& writer, const char* name, std::initializer_list<PrometheusLabel> labels, T value, double scale) {
+  writer.sample(name, labels, value * scale);
+}
+
+// A reading that isn't there, like a stack that can't be measured on this build, just gets left out.
+template <typename TSink, typename T>
+void writeScaledSample(PrometheusWriter<TSink>& writer, const char* name, std::initializer_list<PrometheusLabel> labels, std::optional<T> value, double scale) {
+  if (value.has_value()) {
+    writeScaledSample(writer, name, labels, value.value(), scale);
+  }
+}
+
+// The latest value a telemetry stream has emitted, if it's emitted one.
+template <typename TSink, typename T>
+void writeLastValue(PrometheusWriter<TSink>& writer, const char* name, std::initializer_list<PrometheusLabel> labels, EventStream<T>* stream, double scale = 1) {
+  std::optional<Event<T>> last = stream->getLastEvent();
+  if (last.has_value()) {
+    writeScaledSample(writer, name, labels, last.value().value, scale);
+  }
+}
+
+// Everything /metrics reports. Times are in seconds and sizes in bytes, like Prometheus likes them.
+// It reads the same counters the other diagnostic endpoints do, without copying them anywhere first.
+template <typename TSink>
+void writeMetrics(PrometheusWriter<TSink>& writer, GreenhouseState* ghState) {
+  // Prometheus keeps the quantile label for summaries, which need a _sum and _count as well,
+  // so these are plain gauges with a label of their own.
+  writer.family("greenhouse_loop_duration_seconds", "gauge", "How long one pass through all the runnables takes.");
+  writeLastValue(writer, "greenhouse_loop_duration_seconds", { { "stat", "p50" } }, ghState->loop_duration_p50, 1e-6);
+  writeLastValue(writer, "greenhouse_loop_duration_seconds", { { "stat", "p99" } }, ghState->loop_duration_p99, 1e-6);
+  writeLastValue(writer, "greenhouse_loop_duration_seconds", { { "stat", "max" } }, ghState->loop_duration_max, 1e-6);
+  writer.family("greenhouse_loop_jitter_seconds", "gauge", "How much the time between passes changes from one pass to the next.");
+  writeLastValue(writer, "greenhouse_loop_jitter_seconds", { { "stat", "p50" } }, ghState->loop_jitter_p50, 1e-6);
+  writeLastValue(writer, "greenhouse_loop_jitter_seconds", { { "stat", "p99" } }, ghState->loop_jitter_p99, 1e-6);
+  writeLastValue(writer, "greenhouse_loop_jitter_seconds", { { "stat", "max" } }, ghState->loop_jitter_max, 1e-6);
+  writer.family("greenhouse_loop_interval_max_seconds", "gauge", "The longest time between the starts of two passes.");
+  writeLastValue(writer, "greenhouse_loop_interval_max_seconds", {}, ghState->loop_interval_max, 1e-6);
+
+  writer.family("greenhouse_runnable_runs_total", "counter", "How many times each runnable has run.");
+  for (auto const& cost : RunnableCost::all()) {
+    writer.sample("greenhouse_runnable_runs_total", { { "runnable", cost->name } }, cost->runs);
+  }
+  writer.family("greenhouse_runnable_seconds_total", "counter", "How long each runnable has spent running, all told.");
+  for (auto const& cost : RunnableCost::all()) {
+    writer.sample("greenhouse_runnable_seconds_total", { { "runnable", cost->name } }, cost->totalMicros * 1e-6);
+  }
+  writer.family("greenhouse_runnable_max_seconds", "gauge", "The longest each runnable has ever taken to run once.");
+  for (auto const& cost : RunnableCost::all()) {
+    writer.sample("greenhouse_runnable_max_seconds", { { "runnable", cost->name } }, cost->maxMicros * 1e-6);
+  }
+
+  writer.family("greenhouse_free_heap_bytes", "gauge", "Free heap.");
+  writeLastValue(writer, "greenhouse_free_heap_bytes", {}, ghState->free_heap);
+  writer.family("greenhouse_min_free_heap_bytes", "gauge", "The least free heap there's been since boot.");
+  writeLastValue(writer, "greenhouse_min_free_heap_bytes", {}, ghState->min_free_heap);
+  writer.family("greenhouse_largest_free_block_bytes", "gauge", "The biggest block that could be allocated right now.");
+  writeLastValue(writer, "greenhouse_largest_free_block_bytes", {}, ghState->largest_free_block);
+  writer.family("greenhouse_task_stack_free_bytes", "gauge", "The least stack each task has had left.");
+  writeLastValue(writer, "greenhouse_task_stack_free_bytes", { { "task", "loop" } }, ghState->loop_task_stack_free);
+  writeLastValue(writer, "greenhouse_task_stack_free_bytes", { { "task", "web_server" } }, ghState->web_server_task_stack_free);
+
+  writer.family("greenhouse_websocket_clients", "gauge", "Connected websocket clients.");
+  writer.sample("greenhouse_websocket_clients", stateServer.readChannel(StateServerStat::clients));
+  writer.family("greenhouse_websocket_bytes_sent_total", "counter", "Websocket bytes sent, counting every client's copy.");
+  writer.sample("greenhouse_websocket_bytes_sent_total", stateServer.readChannel(StateServerStat::bytesSent));
+  writer.family("greenhouse_websocket_messages_sent_total", "counter", "Websocket messages sent, counting every client's copy.");
+  writer.sample("greenhouse_websocket_messages_sent_total", stateServer.readChannel(StateServerStat::messagesSent));
+  writer.family("greenhouse_websocket_superseded_total", "counter", "Values replaced in a client's outbox before the client was ready for them.");
+  writer.sample("greenhouse_websocket_superseded_total", stateServer.readChannel(StateServerStat::superseded));
+  writer.family("greenhouse_websocket_client_outbox_depth", "gauge", "How many fields are waiting to go out to each client.");
+  stateServer.forEachClient([&writer](uint32_t id, WebSocketEncoding encoding, const ClientOutbox& outbox) {
+    char idText[11];
+    snprintf(idText, sizeof(idText), "%u", (unsigned)id);
+    writer.sample("greenhouse_websocket_client_outbox_depth", { { "client", idText }, { "encoding", encoding == WebSocketEncoding::msgpack ? "msgpack" : "json" } }, outbox.getDepth());
+  });
+  writer.family("greenhouse_state_updates_total", "counter", "Greenhouse state changes recorded for websocket clients.");
+  writer.sample("greenhouse_state_updates_total", stateUpdateFrames.readChannel(FrameCollectorStat::updates));
+  writer.family("greenhouse_state_frames_total", "counter", "Frames of state changes sent to websocket clients.");
+  writer.sample("greenhouse_state_frames_total", stateUpdateFrames.readChannel(FrameCollectorStat::frames));
+
+  writer.family("greenhouse_event_stream_emits_total", "counter", "Events emitted by each stream that has stats switched on.");
+  for (auto const& stats : EventStreamStats::all()) {
+    writer.sample("greenhouse_event_stream_emits_total", { { "stream", stats->name } }, stats->emitCount);
+  }
+  writer.family("greenhouse_event_stream_emits_per_second", "gauge", "Each stream's event rate over the last second or so.");
+  for (auto const& stats : EventStreamStats::all()) {
+    writer.sample("greenhouse_event_stream_emits_per_second", { { "stream", stats->name } }, stats->emitsPerSecond());
+  }
+  writer.family("greenhouse_event_stream_subscriber_seconds_total", "counter", "How long each stream's subscribers have spent handling its events.");
+  for (auto const& stats : EventStreamStats::all()) {
+    writer.sample("greenhouse_event_stream_subscriber_seconds_total", { { "stream", stats->name } }, stats->totalSubscriberTime * 1e-6);
+  }
+  writer.family("greenhouse_event_queue_high_water_mark", "gauge", "The most deferred events that have ever been waiting at once.");
+  writeLastValue(writer, "greenhouse_event_queue_high_water_mark", {}, ghState->event_queue_high_water_mark);
+  writer.family("greenhouse_event_queue_dropped_total", "counter", "Deferred events thrown away by an overflow policy.");
+  writeLastValue(writer, "greenhouse_event_queue_dropped_total", {}, ghState->event_queue_dropped);
+
+  writer.family("greenhouse_output_changes_total", "counter", "How many times each output has changed what it's doing, e.g., relay clicks.");
+  for (auto const& staleness : OutputStaleness::all()) {
+    writer.sample("greenhouse_output_changes_total", { { "output", staleness->name } }, staleness->changes);
+  }
+
+  writer.family("greenhouse_sensor_reads_total", "counter", "Reads from each sensor that has read stats switched on.");
+  for (auto const& stats : SensorReadStats::all()) {
+    writer.sample("greenhouse_sensor_reads_total", { { "sensor", stats->name } }, stats->reads);
+  }
+  writer.family("greenhouse_sensor_read_failures_total", "counter", "Reads from each sensor that failed.");
+  for (auto const& stats : SensorReadStats::all()) {
+    writer.sample("greenhouse_sensor_read_failures_total", { { "sensor", stats->name } }, stats->failures);
   }
 }
 
 void setupWebServer(GreenhouseState* ghState) {
-  ghState->temp_unit->registerSubscriber([](Event<TempUnit> v) { sendStateUpdatedMessage("temp_unit", v.value); });
+  // One stateUpdated message per frame, with the latest value of everything that changed in it.
+  stateUpdateFrames.registerConsumer(publishStateUpdated);
+  broadcastChangesOf("temp_unit", ghState->temp_unit);
   ws.onEvent([ghState](AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) { receiveWebSocketEvent(server, client, type, arg, data, len, ghState); });
-  ghState->shelf_temp->registerSubscriber([](Event<std::optional<float>> e) { sendStateUpdatedMessage("shelf_temp", e.value); });
-  ghState->shelf_temp_calibration->registerSubscriber([](Event<TwoPointCalibration<float>> e) { sendStateUpdatedMessage("shelf_temp_calibration", e.value); });
-  ghState->shelf_hum->registerSubscriber([](Event<std::optional<float>> e) { sendStateUpdatedMessage("shelf_hum", e.value); });
-  ghState->shelf_light->registerSubscriber([](Event<float> e) { sendStateUpdatedMessage("shelf_light", e.value); });
-  ghState->ground_temp->registerSubscriber([](Event<std::optional<float>> e) { sendStateUpdatedMessage("ground_temp", e.value); });
-  ghState->ground_temp_calibration->registerSubscriber([](Event<TwoPointCalibration<float>> e) { sendStateUpdatedMessage("ground_temp_calibration", e.value); });
-  ghState->ceiling_temp->registerSubscriber([](Event<std::optional<float>> e) { sendStateUpdatedMessage("ceiling_temp", e.value); });
-  ghState->ceiling_temp_calibration->registerSubscriber([](Event<TwoPointCalibration<float>> e) { sendStateUpdatedMessage("ceiling_temp_calibration", e.value); });
-  ghState->yuzu_temp->registerSubscriber([](Event<std::optional<float>> e) { sendStateUpdatedMessage("yuzu_temp", e.value); });
-  ghState->yuzu_temp_calibration->registerSubscriber([](Event<TwoPointCalibration<float>> e) { sendStateUpdatedMessage("yuzu_temp_calibration", e.value); });
-  ghState->fish_tank_temp->registerSubscriber([](Event<std::optional<float>> e) { sendStateUpdatedMessage("fish_tank_temp", e.value); });
-  ghState->fish_tank_temp_calibration->registerSubscriber([](Event<TwoPointCalibration<float>> e) { sendStateUpdatedMessage("fish_tank_temp_calibration", e.value); });
-  ghState->fan_status->registerSubscriber([](Event<bool> e) { sendStateUpdatedMessage("fan_status", e.value); });
-  ghState->fan->registerSubscriber([](Event<SetpointAndHysteresis<float>> e) { sendStateUpdatedMessage("fan", e.value); });
-  ghState->heater_status->registerSubscriber([](Event<bool> e) { sendStateUpdatedMessage("heater_status", e.value); });
-  ghState->heater->registerSubscriber([](Event<SetpointAndHysteresis<float>> e) { sendStateUpdatedMessage("heater", e.value); });
-  ghState->west_door_status->registerSubscriber([](Event<DoorState> e) { sendStateUpdatedMessage("west_door_status", e.value); });
-  ghState->east_door_status->registerSubscriber([](Event<DoorState> e) { sendStateUpdatedMessage("east_door_status", e.value); });
-  ghState->extreme_temp_alarm_control->registerSubscriber([](Event<Range<float>> e) { sendStateUpdatedMessage("extreme_temp_alarm_control", e.value); });
-  ghState->door_alarm_control->registerSubscriber([](Event<Range<float>> e) { sendStateUpdatedMessage("door_alarm_control", e.value); });
-  ghState->alarm_noise->registerSubscriber([](Event<bool> e) { sendStateUpdatedMessage("alarm_noise", e.value); });
-  ghState->alarm_phone->registerSubscriber([](Event<std::string> e) { sendStateUpdatedMessage("alarm_phone", e.value); });
-  ghState->roof_vents_status->registerSubscriber([](Event<CoverAction> e) { sendStateUpdatedMessage("roof_vents_status", e.value); });
-  ghState->roof_vents_sensor_status->registerSubscriber([](Event<DoorState> e) { sendStateUpdatedMessage("roof_vents_sensor_status", e.value); });
-  ghState->roof_vents->registerSubscriber([](Event<SetpointAndHysteresis<float>> e) { sendStateUpdatedMessage("roof_vents", e.value); });
-  ghState->mat_1_status->registerSubscriber([](Event<bool> e) { sendStateUpdatedMessage("mat_1_status", e.value); });
-  ghState->mat_1_temp->registerSubscriber([](Event<std::optional<float>> e) { sendStateUpdatedMessage("mat_1_temp", e.value); });
-  ghState->mat_1_temp_calibration->registerSubscriber([](Event<TwoPointCalibration<float>> e) { sendStateUpdatedMessage("mat_1_temp_calibration", e.value); });
-  ghState->mat_1->registerSubscriber([](Event<SetpointAndHysteresis<float>> e) { sendStateUpdatedMessage("mat_1", e.value); });
-  ghState->mat_2_status->registerSubscriber([](Event<bool> e) { sendStateUpdatedMessage("mat_2_status", e.value); });
-  ghState->mat_2_temp->registerSubscriber([](Event<std::optional<float>> e) { sendStateUpdatedMessage("mat_2_temp", e.value); });
-  ghState->mat_2_temp_calibration->registerSubscriber([](Event<TwoPointCalibration<float>> e) { sendStateUpdatedMessage("mat_2_temp_calibration", e.value); });
-  ghState->mat_2->registerSubscriber([](Event<SetpointAndHysteresis<float>> e) { sendStateUpdatedMessage("mat_2", e.value); });
+  broadcastChangesOf("shelf_temp", ghState->shelf_temp);
+  broadcastChangesOf("shelf_temp_calibration", ghState->shelf_temp_calibration);
+  broadcastChangesOf("shelf_hum", ghState->shelf_hum);
+  broadcastChangesOf("shelf_light", ghState->shelf_light);
+  broadcastChangesOf("ground_temp", ghState->ground_temp);
+  broadcastChangesOf("ground_temp_calibration", ghState->ground_temp_calibration);
+  broadcastChangesOf("ceiling_temp", ghState->ceiling_temp);
+  broadcastChangesOf("ceiling_temp_calibration", ghState->ceiling_temp_calibration);
+  broadcastChangesOf("yuzu_temp", ghState->yuzu_temp);
+  broadcastChangesOf("yuzu_temp_calibration", ghState->yuzu_temp_calibration);
+  broadcastChangesOf("fish_tank_temp", ghState->fish_tank_temp);
+  broadcastChangesOf("fish_tank_temp_calibration", ghState->fish_tank_temp_calibration);
+  broadcastChangesOf("fan_status", ghState->fan_status);
+  broadcastChangesOf("fan", ghState->fan);
+  broadcastChangesOf("heater_status", ghState->heater_status);
+  broadcastChangesOf("heater", ghState->heater);
+  broadcastChangesOf("west_door_status", ghState->west_door_status);
+  broadcastChangesOf("east_door_status", ghState->east_door_status);
+  broadcastChangesOf("extreme_temp_alarm_control", ghState->extreme_temp_alarm_control);
+  broadcastChangesOf("door_alarm_control", ghState->door_alarm_control);
+  broadcastChangesOf("alarm_noise", ghState->alarm_noise);
+  broadcastChangesOf("alarm_phone", ghState->alarm_phone);
+  broadcastChangesOf("roof_vents_status", ghState->roof_vents_status);
+  broadcastChangesOf("roof_vents_sensor_status", ghState->roof_vents_sensor_status);
+  broadcastChangesOf("roof_vents", ghState->roof_vents);
+  broadcastChangesOf("mat_1_status", ghState->mat_1_status);
+  broadcastChangesOf("mat_1_temp", ghState->mat_1_temp);
+  broadcastChangesOf("mat_1_temp_calibration", ghState->mat_1_temp_calibration);
+  broadcastChangesOf("mat_1", ghState->mat_1);
+  broadcastChangesOf("mat_2_status", ghState->mat_2_status);
+  broadcastChangesOf("mat_2_temp", ghState->mat_2_temp);
+  broadcastChangesOf("mat_2_temp_calibration", ghState->mat_2_temp_calibration);
+  broadcastChangesOf("mat_2", ghState->mat_2);
+  broadcastChangesOf("free_heap", ghState->free_heap);
+  broadcastChangesOf("min_free_heap", ghState->min_free_heap);
+  broadcastChangesOf("largest_free_block", ghState->largest_free_block);
+  broadcastChangesOf("loop_task_stack_free", ghState->loop_task_stack_free);
+  broadcastChangesOf("web_server_task_stack_free", ghState->web_server_task_stack_free);
+  broadcastChangesOf("loop_duration_p50", ghState->loop_duration_p50);
+  broadcastChangesOf("loop_duration_p99", ghState->loop_duration_p99);
+  broadcastChangesOf("loop_duration_max", ghState->loop_duration_max);
+  broadcastChangesOf("loop_jitter_p50", ghState->loop_jitter_p50);
+  broadcastChangesOf("loop_jitter_p99", ghState->loop_jitter_p99);
+  broadcastChangesOf("loop_jitter_max", ghState->loop_jitter_max);
+  broadcastChangesOf("loop_interval_max", ghState->loop_interval_max);
+  broadcastChangesOf("event_queue_high_water_mark", ghState->event_queue_high_water_mark);
+  broadcastChangesOf("event_queue_dropped", ghState->event_queue_dropped);
+  broadcastChangesOf("alarm_messages_dropped", ghState->alarm_messages_dropped);
+  broadcastChangesOf("state_updates_per_minute", ghState->state_updates_per_minute);
+  broadcastChangesOf("websocket_frames_per_minute", ghState->websocket_frames_per_minute);
+  broadcastChangesOf("websocket_bytes_per_minute", ghState->websocket_bytes_per_minute);
+  seedStateServer(&stateServer, stateUpdateFrames.getKeys(), ghState);
   server.addHandler(&ws);
 
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-    request->send(200, "text/html", String(src_greenhouse_index_html_start, src_greenhouse_index_html_end - src_greenhouse_index_html_start));
+    sendEmbeddedAsset(request, greenhouseIndexHtml);
+  });
+
+  // Copied straight out of the snapshot as the response goes out;
+  // holding on to it keeps it alive even if a newer one gets published in the meantime.
+  server.on("/allState", HTTP_GET, [](AsyncWebServerRequest *request) {
+    std::shared_ptr<const std::string> snapshot = stateServer.getAllState();
+    request->send(request->beginResponse("text/json", snapshot->size(), [snapshot](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      size_t len = std::min(maxLen, snapshot->size() - index);
+      memcpy(buffer, snapshot->data() + index, len);
+      return len;
+    }));
+  });
+
+  // Catch up on what's happened since you last looked, e.g., after a reconnect.
+  // Pass the last sequence number you saw for each stream you're interested in,
+  // e.g., /history?west_door_status=12&heater_status=0
+  server.on("/history", HTTP_GET, [ghState](AsyncWebServerRequest *request) {
+    JsonDocument historyJson;
+    JsonObject histories = historyJson.to<JsonObject>();
+    addEventHistory(histories, "fan_status", ghState->fan_status, request);
+    addEventHistory(histories, "heater_status", ghState->heater_status, request);
+    addEventHistory(histories, "west_door_status", ghState->west_door_status, request);
+    addEventHistory(histories, "east_door_status", ghState->east_door_status, request);
+    addEventHistory(histories, "roof_vents_status", ghState->roof_vents_status, request);
+    addEventHistory(histories, "roof_vents_sensor_status", ghState->roof_vents_sensor_status, request);
+    addEventHistory(histories, "mat_1_status", ghState->mat_1_status, request);
+    addEventHistory(histories, "mat_2_status", ghState->mat_2_status, request);
+    String buffer;
+    serializeJson(historyJson, buffer);
+    request->send(200, "text/json", buffer);
+  });
+
+  // The sample history as CSV (the default) or NDJSON, e.g.,
+  // /history/export?format=ndjson&fields=shelf_temp,heater_status&from=3600000&to=7200000&step=900000
+  // `fields` is a comma-separated list of keys; leave it out for all of them.
+  // Unknown keys are ignored, but if none of them are known, it's a 400.
+  // `from` and `to` are uptimes in milliseconds, like the timestamps, and `step` averages rows into buckets that long.
+  // It goes out in chunks, a row at a time, so it takes the same memory however much of the history is asked for.
+  server.on("/history/export", HTTP_GET, [](AsyncWebServerRequest *request) {
+    HistoryFormat format = request->hasParam("format") && request->getParam("format")->value() == "ndjson"
+      ? HistoryFormat::ndjson
+      : HistoryFormat::csv;
+    std::vector<size_t> fields = HistoryExport::fieldsFromList(
+      sampleHistory.getKeys(),
+      request->hasParam("fields") ? request->getParam("fields")->value().c_str() : nullptr
+    );
+    if (fields.empty()) {
+      request->send(400, "text/plain", "None of those fields are in the history");
+      return;
+    }
+    auto historyExport = std::make_shared<HistoryExport>(
+      &sampleHistory,
+      format,
+      fields,
+      getUnsignedParam(request, "from", 0),
+      getUnsignedParam(request, "to", ULONG_MAX),
+      getUnsignedParam(request, "step", 0)
+    );
+    request->send(request->beginChunkedResponse(
+      format == HistoryFormat::ndjson ? "application/x-ndjson" : "text/csv",
+      [historyExport](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        return historyExport->read(buffer, maxLen);
+      }
+    ));
+  });
+
+  // Counters for every stream that's had enableStats() called on it.
+  // Sort by max_subscriber_micros to find out who's stalling the loop.
+  server.on("/eventStreams", HTTP_GET, [](AsyncWebServerRequest *request) {
+    JsonDocument statsJson;
+    JsonArray streams = statsJson.to<JsonArray>();
+    for (auto stats : EventStreamStats::all()) {
+      streams.add(*stats);
+    }
+    String buffer;
+    serializeJson(statsJson, buffer);
+    request->send(200, "text/json", buffer);
+  });
+
+  // How old the sensor readings were by the time each output acted on them.
+  server.on("/outputStaleness", HTTP_GET, [](AsyncWebServerRequest *request) {
+    JsonDocument stalenessJson;
+    JsonArray outputs = stalenessJson.to<JsonArray>();
+    for (auto staleness : OutputStaleness::all()) {
+      outputs.add(*staleness);
+    }
+    String buffer;
+    serializeJson(stalenessJson, buffer);
+    request->send(200, "text/json", buffer);
+  });
+
+  // For Prometheus, or a curl loop; see writeMetrics().
+  // It goes straight into the response's stream as it's written, with no String or JsonDocument in between.
+  server.on("/metrics", HTTP_GET, [ghState](AsyncWebServerRequest *request) {
+    AsyncResponseStream* response = request->beginResponseStream("text/plain; version=0.0.4");
+    PrometheusWriter<AsyncResponseStream> writer(response);
+    writeMetrics(writer, ghState);
+    request->send(response);
   });
 
-  server.on("/allState", HTTP_GET, [ghState](AsyncWebServerRequest *request) {
-    JsonDocument allStateJson;
-    allStateJson.set(ghState);
+  // How far behind each websocket client is.
+  server.on("/webSocketClients", HTTP_GET, [](AsyncWebServerRequest *request) {
+    JsonDocument clientsJson;
+    JsonArray clients = clientsJson.to<JsonArray>();
+    stateServer.forEachClient([&clients](uint32_t id, WebSocketEncoding encoding, const ClientOutbox& outbox) {
+      JsonObject client = clients.add<JsonObject>();
+      client["id"] = id;
+      client["encoding"] = encoding == WebSocketEncoding::msgpack ? "msgpack" : "json";
+      client["outbox_depth"] = outbox.getDepth();
+      client["outbox_max_depth"] = outbox.getMaxDepth();
+      client["superseded"] = outbox.getSupersededCount();
+      client["messages_sent"] = outbox.getMessagesSent();
+    });
     String buffer;
-    serializeJson(allStateJson, buffer);
+    serializeJson(clientsJson, buffer);
     request->send(200, "text/json", buffer);
   });
 }
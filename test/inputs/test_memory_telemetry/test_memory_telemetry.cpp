@@ -0,0 +1,53 @@
+#include <vector>
+
+#include <unity.h>
+
+// This is the only translation unit in the test, so it gets to replace operator new and delete.
+#define RHEOSCAPE_TRACK_NATIVE_HEAP
+#include <input/Input.h>
+#include <input/MemoryTelemetry.h>
+
+void test_free_heap_goes_down_and_up_with_allocations() {
+  MemoryTelemetry telemetry;
+  auto freeHeap = telemetry.getInputForChannel(MemoryTelemetryChannel::freeHeap);
+  size_t before = freeHeap.read();
+  auto block = new std::vector<char>(10000);
+  size_t during = freeHeap.read();
+  TEST_ASSERT_TRUE(during <= before - 10000);
+  delete block;
+  TEST_ASSERT_EQUAL(before, freeHeap.read());
+}
+
+void test_min_free_heap_remembers_the_worst() {
+  MemoryTelemetry telemetry;
+  auto freeHeap = telemetry.getInputForChannel(MemoryTelemetryChannel::freeHeap);
+  auto minFreeHeap = telemetry.getInputForChannel(MemoryTelemetryChannel::minFreeHeap);
+  size_t freeBefore = freeHeap.read();
+  TEST_ASSERT_TRUE(minFreeHeap.read() <= freeBefore);
+  auto block = new char[100000];
+  size_t worstDuring = minFreeHeap.read();
+  delete[] block;
+  TEST_ASSERT_TRUE(worstDuring <= freeBefore - 100000);
+  // Freeing doesn't make the low-water mark recover.
+  TEST_ASSERT_EQUAL(worstDuring, minFreeHeap.read());
+  TEST_ASSERT_TRUE(freeHeap.read() > minFreeHeap.read());
+}
+
+void test_largest_free_block_fits_in_free_heap() {
+  MemoryTelemetry telemetry;
+  TEST_ASSERT_TRUE(telemetry.readChannel(MemoryTelemetryChannel::largestFreeBlock) <= telemetry.readChannel(MemoryTelemetryChannel::freeHeap));
+}
+
+void test_task_stack_high_water_mark_is_empty_without_tasks() {
+  TaskStackHighWaterMark loopStack("loopTask");
+  TEST_ASSERT_FALSE(loopStack.read().has_value());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_free_heap_goes_down_and_up_with_allocations);
+  RUN_TEST(test_min_free_heap_remembers_the_worst);
+  RUN_TEST(test_largest_free_block_fits_in_free_heap);
+  RUN_TEST(test_task_stack_high_water_mark_is_empty_without_tasks);
+  UNITY_END();
+}
@@ -6,6 +6,7 @@
 #include <helpers/string_format.h>
 #include <input/Input.h>
 #include <input/TimeProcesses.h>
+#include <TickClock.h>
 
 void test_time_quantising_process() {
   Timekeeper::setSource(TimekeeperSource::simTime);
@@ -31,6 +32,23 @@ void test_throttling_process() {
   TEST_ASSERT_EQUAL(22, clockyStepper.read());
 }
 
+void test_counter_delta_process() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  StateInput<uint32_t> counter(UINT32_MAX - 4);
+  CounterDeltaProcess<uint32_t> perTen(&counter, 10);
+  TEST_ASSERT_EQUAL(0, perTen.read());
+  counter.write(UINT32_MAX);
+  Timekeeper::tick(5);
+  // Nothing until the interval's over.
+  TEST_ASSERT_EQUAL(0, perTen.read());
+  // It gets across a rollover.
+  counter.write(5);
+  Timekeeper::tick(5);
+  TEST_ASSERT_EQUAL(10, perTen.read());
+  Timekeeper::tick(10);
+  TEST_ASSERT_EQUAL(0, perTen.read());
+}
+
 void test_blinking_process() {
   Timekeeper::setSource(TimekeeperSource::simTime);
   StateInput switcher(false);
@@ -45,6 +63,33 @@ void test_blinking_process() {
   TEST_ASSERT_TRUE_MESSAGE(blinker.read(), "should be on the second time");
 }
 
+void test_blinking_processes_on_a_clock_blink_together() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  TickClock clock;
+  StateInput firstSwitch(true);
+  StateInput secondSwitch(false);
+  BlinkingProcess first(&firstSwitch, 10, 5, &clock);
+  BlinkingProcess second(&secondSwitch, 10, 5, &clock);
+  Timekeeper::setNowSim(3);
+  clock.beforeTick();
+  secondSwitch.write(true);
+  // The second one comes in partway through the cycle, and picks it up where the first one is.
+  TEST_ASSERT_TRUE(first.read());
+  TEST_ASSERT_TRUE(second.read());
+  Timekeeper::setNowSim(5);
+  clock.beforeTick();
+  TEST_ASSERT_FALSE(first.read());
+  TEST_ASSERT_FALSE(second.read());
+  // Nothing changes until the clock ticks.
+  Timekeeper::setNowSim(15);
+  TEST_ASSERT_FALSE(first.read());
+  clock.beforeTick();
+  TEST_ASSERT_TRUE(first.read());
+  TEST_ASSERT_TRUE(second.read());
+  secondSwitch.write(false);
+  TEST_ASSERT_FALSE(second.read());
+}
+
 void test_slow_pwm_process() {
   Timekeeper::setSource(TimekeeperSource::simTime);
   StateInput dutyCycle(0.5f);
@@ -96,6 +141,20 @@ void test_slow_pwm_process() {
   }
 }
 
+void test_slow_pwm_process_on_a_clock() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  TickClock clock;
+  StateInput dutyCycle(0.25f);
+  // Cycles line up with the clock, not with when it was created.
+  Timekeeper::setNowSim(30);
+  SlowPwmProcess pwm(&dutyCycle, 100, 10, &clock);
+  for (unsigned long i = 100; i < 200; i ++) {
+    Timekeeper::setNowSim(i);
+    clock.beforeTick();
+    TEST_ASSERT_EQUAL_MESSAGE(i < 130, pwm.read(), string_format("wrong value at %d ms", i).c_str());
+  }
+}
+
 void test_hysteresis_process() {
   Timekeeper::setSource(TimekeeperSource::simTime);
   StateInput reading(0);
@@ -171,14 +230,39 @@ void test_timed_latch_process() {
   TEST_ASSERT_FALSE(latch.read());
 }
 
+void test_timed_latch_process_on_a_clock() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  TickClock clock;
+  StateInput sensor(false);
+  TimedLatchProcess latch(&sensor, 10, &clock);
+  TEST_ASSERT_FALSE(latch.read());
+  Timekeeper::tick();
+  clock.beforeTick();
+  sensor.write(true);
+  TEST_ASSERT_TRUE(latch.read());
+  sensor.write(false);
+  for (uint8_t i = 0; i < 9; i ++) {
+    Timekeeper::tick();
+    clock.beforeTick();
+    TEST_ASSERT_TRUE(latch.read());
+  }
+  Timekeeper::tick();
+  clock.beforeTick();
+  TEST_ASSERT_FALSE(latch.read());
+}
+
 int main(int argc, char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_time_quantising_process);
   RUN_TEST(test_throttling_process);
+  RUN_TEST(test_counter_delta_process);
   RUN_TEST(test_blinking_process);
+  RUN_TEST(test_blinking_processes_on_a_clock_blink_together);
   RUN_TEST(test_slow_pwm_process);
+  RUN_TEST(test_slow_pwm_process_on_a_clock);
   RUN_TEST(test_hysteresis_process);
   RUN_TEST(test_exponential_moving_average_process);
   RUN_TEST(test_timed_latch_process);
+  RUN_TEST(test_timed_latch_process_on_a_clock);
   UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+#ifdef PLATFORM_DEV_MACHINE
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <OneWire.h>
+#include <hal/FakeHardware.h>
+#include <input/Bme280.h>
+#include <input/Ds18b20.h>
+#include <input/GpioInputs.h>
+#include <input/Max6675.h>
+#include <input/Sht21.h>
+
+void setUp() {
+  FakeHardware::reset();
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  Timekeeper::setNowSim(0);
+}
+
+void tearDown() { }
+
+void test_door_sensor_reads_pin() {
+  DoorSensor door(4, INPUT_PULLUP);
+  // Pulled up means the switch is open.
+  TEST_ASSERT_EQUAL(DoorState::doorOpen, door.read());
+  FakeHardware::pin(4).level = LOW;
+  TEST_ASSERT_EQUAL(DoorState::doorClosed, door.read());
+}
+
+void test_ds18b20_reads_every_device_on_the_bus() {
+  FakeHardware::oneWireDevices(1).push_back(FakeDs18b20(0x28FF000011112222, 21.7f));
+  FakeHardware::oneWireDevices(1).push_back(FakeDs18b20(0x28FF000033334444, 19.2f));
+  OneWire bus(1);
+  Ds18b20 therms(&bus);
+  therms.enableReadStats("dallas_therms");
+  // Nothing to read until the first conversion is done.
+  TEST_ASSERT_FALSE(therms.readChannel(0x28FF000011112222).has_value());
+  Timekeeper::tick(93);
+  // The reading is truncated to the resolution, which defaults to half a degree.
+  TEST_ASSERT_EQUAL_FLOAT(21.5f, therms.readChannel(0x28FF000011112222).value());
+  TEST_ASSERT_EQUAL_FLOAT(19.0f, therms.readChannel(0x28FF000033334444).value());
+  TEST_ASSERT_FALSE(therms.readChannel(0xDEADBEEF).has_value());
+
+  FakeHardware::oneWireDevices(1)[1].connected = false;
+  // It takes two conversions for the disconnect to show up:
+  // one that was already started while it was connected...
+  Timekeeper::tick(93);
+  therms.read();
+  Timekeeper::tick(93);
+  TEST_ASSERT_FALSE(therms.readChannel(0x28FF000033334444).has_value());
+  TEST_ASSERT_TRUE(therms.readChannel(0x28FF000011112222).has_value());
+  // Two devices over three conversions, and the loose one failed in both of the conversions since it came loose.
+  TEST_ASSERT_EQUAL(6, therms.getReadStats()->reads);
+  TEST_ASSERT_EQUAL(2, therms.getReadStats()->failures);
+}
+
+void test_ds18b20_bus_time() {
+  FakeHardware::oneWireDevices(1).push_back(FakeDs18b20(1, 20.0f));
+  FakeHardware::oneWireDevices(1).push_back(FakeDs18b20(2, 20.0f));
+  OneWire bus(1);
+  Ds18b20 therms(&bus);
+  Timekeeper::tick(93);
+  uint64_t before = FakeHardware::oneWire().getBusyNanos();
+  therms.read();
+  // Two scratchpad reads and a convert request; that's a lot of time to block the loop for.
+  unsigned long spent = (FakeHardware::oneWire().getBusyNanos() - before) / 1000;
+  TEST_ASSERT_UINT32_WITHIN(1000, 23700, spent);
+  // Until the next conversion is done, reading is free.
+  before = FakeHardware::oneWire().getBusyNanos();
+  therms.read();
+  TEST_ASSERT_EQUAL(before, FakeHardware::oneWire().getBusyNanos());
+}
+
+void test_bme280_keeps_measuring_in_forced_mode() {
+  FakeHardware::environment().airTempC = 22.5f;
+  FakeHardware::environment().humidity = 40.0f;
+  FakeHardware::environment().pressureMbar = 1000.0f;
+  Bme280 sensor(&Wire);
+  TEST_ASSERT_FALSE(sensor.readChannel(Bme280Channel::tempC).has_value());
+  Timekeeper::tick(8);
+  TEST_ASSERT_EQUAL_FLOAT(22.5f, sensor.readChannel(Bme280Channel::tempC).value());
+  TEST_ASSERT_EQUAL_FLOAT(40.0f, sensor.readChannel(Bme280Channel::humidity).value());
+  TEST_ASSERT_EQUAL_FLOAT(100.0f, sensor.readChannel(Bme280Channel::pressureKpa).value());
+
+  FakeHardware::environment().airTempC = 25.0f;
+  Timekeeper::tick(8);
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, sensor.readChannel(Bme280Channel::tempC).value());
+}
+
+void test_sht21_polls_one_channel_at_a_time() {
+  FakeHardware::environment().airTempC = 18.0f;
+  FakeHardware::environment().humidity = 70.0f;
+  Sht21 sensor(&Wire);
+  TEST_ASSERT_FALSE(sensor.readChannel(Sht21Channel::tempC).has_value());
+  Timekeeper::tick(84);
+  TEST_ASSERT_FALSE(sensor.readChannel(Sht21Channel::tempC).has_value());
+  Timekeeper::tick(1);
+  TEST_ASSERT_EQUAL_FLOAT(18.0f, sensor.readChannel(Sht21Channel::tempC).value());
+  TEST_ASSERT_FALSE(sensor.readChannel(Sht21Channel::humidity).has_value());
+  Timekeeper::tick(29);
+  TEST_ASSERT_EQUAL_FLOAT(70.0f, sensor.readChannel(Sht21Channel::humidity).value());
+}
+
+void test_max6675_reports_open_thermocouple() {
+  FakeHardware::environment().thermocoupleTempC = 301.3f;
+  Max6675 thermocouple(5, &SPI);
+  TEST_ASSERT_EQUAL_FLOAT(301.25f, thermocouple.read().value());
+  FakeHardware::environment().thermocoupleOpen = true;
+  // It's throttled, so the old reading sticks around for a bit.
+  TEST_ASSERT_TRUE(thermocouple.read().has_value());
+  Timekeeper::tick(220);
+  TEST_ASSERT_FALSE(thermocouple.read().has_value());
+}
+
+void test_transactions_can_take_sim_time() {
+  FakeHardware::setTransactionsTakeTime(true);
+  SHT21 sensor;
+  sensor.requestTemperature();
+  // Two bytes, at nine clocks each plus start and stop, at 100 kHz.
+  TEST_ASSERT_EQUAL(200, Timekeeper::nowMicros());
+  Wire.setClock(400000);
+  sensor.requestTemperature();
+  TEST_ASSERT_EQUAL(250, Timekeeper::nowMicros());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_door_sensor_reads_pin);
+  RUN_TEST(test_ds18b20_reads_every_device_on_the_bus);
+  RUN_TEST(test_ds18b20_bus_time);
+  RUN_TEST(test_bme280_keeps_measuring_in_forced_mode);
+  RUN_TEST(test_sht21_polls_one_channel_at_a_time);
+  RUN_TEST(test_max6675_reports_open_thermocouple);
+  RUN_TEST(test_transactions_can_take_sim_time);
+  UNITY_END();
+}
+
+#else
+
+void setup() {}
+
+void loop() {}
+
+#endif
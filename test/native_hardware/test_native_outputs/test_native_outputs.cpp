@@ -0,0 +1,142 @@
+#ifdef PLATFORM_DEV_MACHINE
+
+#include <unity.h>
+#include <Arduino.h>
+#include <hal/FakeHardware.h>
+#include <OneWire.h>
+#include <input/ControlProcesses.h>
+#include <input/Ds18b20.h>
+#include <input/Input.h>
+#include <input/TranslatingProcesses.h>
+#include <output/AnalogPinOutput.h>
+#include <output/DigitalPinOutput.h>
+#include <output/MotorDriver.h>
+#include <output/OutputFactories.h>
+
+void setUp() {
+  FakeHardware::reset();
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  Timekeeper::setNowSim(0);
+}
+
+void tearDown() { }
+
+void test_digital_pin_output() {
+  StateInput<bool> pinState(false);
+  DigitalPinOutput relay(2, LOW, &pinState);
+  TEST_ASSERT_EQUAL(OUTPUT, FakeHardware::pin(2).mode);
+  relay.run();
+  TEST_ASSERT_EQUAL(HIGH, FakeHardware::pin(2).level);
+  pinState.write(true);
+  relay.run();
+  TEST_ASSERT_EQUAL(LOW, FakeHardware::pin(2).level);
+  // Writing the same level again isn't a transition.
+  relay.run();
+  TEST_ASSERT_EQUAL(2, FakeHardware::pin(2).transitions);
+}
+
+void test_relay_throttling_limits_clicks() {
+  StateInput<bool> flapping(false);
+  DigitalPinOutput relay = makeRelay(2, HIGH, 2000, &flapping);
+  // Flap the input every 100 ms for ten seconds.
+  for (int i = 0; i < 100; i ++) {
+    flapping.write(i % 2);
+    relay.run();
+    Timekeeper::tick(100);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(6, FakeHardware::pin(2).transitions);
+}
+
+void test_analog_pin_output() {
+  StateInput<float> level(0.5f);
+  AnalogPinOutput led(3, &level);
+  led.run();
+  TEST_ASSERT_EQUAL(127, FakeHardware::pin(3).analogWriteValue);
+}
+
+void test_motor_driver() {
+  StateInput<float> speed(-0.5f);
+  MotorDriver motor(6, 7, 8, HIGH, &speed);
+  motor.run();
+  TEST_ASSERT_EQUAL(LOW, FakeHardware::pin(6).level);
+  TEST_ASSERT_EQUAL(HIGH, FakeHardware::pin(7).level);
+  TEST_ASSERT_EQUAL(512, FakeHardware::pin(8).analogWriteValue);
+  speed.write(1.0f);
+  motor.run();
+  TEST_ASSERT_EQUAL(HIGH, FakeHardware::pin(6).level);
+  TEST_ASSERT_EQUAL(LOW, FakeHardware::pin(7).level);
+  TEST_ASSERT_EQUAL(1023, FakeHardware::pin(8).analogWriteValue);
+  speed.write(0.0f);
+  motor.run();
+  TEST_ASSERT_EQUAL(LOW, FakeHardware::pin(6).level);
+  TEST_ASSERT_EQUAL(LOW, FakeHardware::pin(7).level);
+}
+
+void test_bus_time_monitor_measures_each_tick() {
+  FakeBusTimeMonitor gpioTime(&FakeHardware::gpio());
+  StateInput<float> speed(1.0f);
+  MotorDriver motor(6, 7, 8, HIGH, &speed);
+  Runner::registerTickObserver(&gpioTime);
+  Runner::registerRunnable(&motor);
+  for (int i = 0; i < 10; i ++) {
+    Runner::run();
+  }
+  // One PWM write and two digital writes every tick.
+  uint32_t expected = (FakeHardware::analogWriteNanos + 2 * FakeHardware::gpioNanos) / 1000;
+  TEST_ASSERT_EQUAL(10, gpioTime.getPerTickMicros().count());
+  TEST_ASSERT_EQUAL(expected, gpioTime.getPerTickMicros().max());
+}
+
+void test_mat_heater_staleness() {
+  FakeHardware::oneWireDevices(1).push_back(FakeDs18b20(1, 25.0f));
+  OneWire bus(1);
+  Ds18b20 therms(&bus);
+  auto maybeTemp = therms.getInputForChannel(1);
+  StateInput calibration(TwoPointCalibration<float>::waterReference());
+  TwoPointCalibrationOptionalProcess<float> maybeTempCalibrated(&maybeTemp, &calibration);
+  OptionalPinningProcess temp(&maybeTempCalibrated, -127.0f);
+  StateInput setting(SetpointAndHysteresis(20.0f, 1.0f));
+  DirectionToBooleanProcess thermostat(new BangBangProcess<float>(&temp, &setting), true);
+  DigitalPinOutput matControl(2, HIGH, &thermostat);
+  matControl.enableStalenessTracking("mat_control");
+
+  // The loop comes around every 10 ms.
+  for (int i = 0; i < 100; i ++) {
+    matControl.run();
+    Timekeeper::tick(10);
+  }
+  // It gets cold, and the heater comes on once the next conversion is read.
+  FakeHardware::oneWireDevices(1)[0].tempC = 15.0f;
+  for (int i = 0; i < 30; i ++) {
+    matControl.run();
+    Timekeeper::tick(10);
+  }
+  TEST_ASSERT_EQUAL(HIGH, FakeHardware::pin(2).level);
+  const LogBucketHistogram& staleness = matControl.getStaleness()->micros;
+  // Once on startup and once when the heater came on.
+  TEST_ASSERT_EQUAL(2, staleness.count());
+  // On while there was no reading yet, off once there was, then on again.
+  TEST_ASSERT_EQUAL(3, matControl.getStaleness()->changes);
+  // The timer only notices a finished conversion on the next pass through the loop.
+  TEST_ASSERT_TRUE(staleness.max() <= 10000);
+  TEST_ASSERT_EQUAL(1, OutputStaleness::all().size());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_digital_pin_output);
+  RUN_TEST(test_relay_throttling_limits_clicks);
+  RUN_TEST(test_analog_pin_output);
+  RUN_TEST(test_motor_driver);
+  RUN_TEST(test_bus_time_monitor_measures_each_tick);
+  RUN_TEST(test_mat_heater_staleness);
+  UNITY_END();
+}
+
+#else
+
+void setup() {}
+
+void loop() {}
+
+#endif
@@ -0,0 +1,318 @@
+#ifdef PLATFORM_DEV_MACHINE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <unity.h>
+#include <StateServer.h>
+#include <hal/PosixWebSocketServer.h>
+
+// A blocking websocket client, just good enough to talk to PosixWebSocketServer.
+class TestClient {
+  private:
+    int _fd;
+    std::string _received;
+
+    bool _fill() {
+      char buffer[4096];
+      ssize_t count = recv(_fd, buffer, sizeof(buffer), 0);
+      if (count <= 0) {
+        return false;
+      }
+      _received.append(buffer, count);
+      return true;
+    }
+
+  public:
+    TestClient(uint16_t port)
+    :
+      _fd(socket(AF_INET, SOCK_STREAM, 0))
+    {
+      sockaddr_in address {};
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      address.sin_port = htons(port);
+      connect(_fd, (sockaddr*)&address, sizeof(address));
+    }
+
+    ~TestClient() {
+      close(_fd);
+    }
+
+    int getFd() const {
+      return _fd;
+    }
+
+    void sendRaw(const std::string& data) {
+      ::send(_fd, data.data(), data.size(), MSG_NOSIGNAL);
+    }
+
+    // The whole of an HTTP response, for requests that close the connection afterwards.
+    std::string get(const char* path) {
+      sendRaw(std::string("GET ") + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+      while (_fill()) { }
+      return _received;
+    }
+
+    // Returns the response headers.
+    std::string upgrade(const char* path) {
+      sendRaw(std::string("GET ") + path + " HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n\r\n");
+      while (_received.find("\r\n\r\n") == std::string::npos && _fill()) { }
+      size_t headersEnd = _received.find("\r\n\r\n") + 4;
+      std::string headers = _received.substr(0, headersEnd);
+      _received.erase(0, headersEnd);
+      return headers;
+    }
+
+    // Client frames have to be masked; an all-zero mask is still a mask.
+    void sendText(const std::string& text) {
+      std::string frame;
+      frame += (char)0x81;
+      frame += (char)(0x80 | text.size());
+      frame.append(4, '\0');
+      frame += text;
+      sendRaw(frame);
+    }
+
+    // A frame's payload if there's a whole one buffered up, without waiting for any more to arrive.
+    bool takeFrame(std::string& payload, bool& binary) {
+      if (_received.size() < 2) {
+        return false;
+      }
+      const uint8_t* bytes = (const uint8_t*)_received.data();
+      size_t length = bytes[1] & 0x7f;
+      size_t headerLength = 2;
+      if (length == 126) {
+        if (_received.size() < 4) {
+          return false;
+        }
+        length = bytes[2] << 8 | bytes[3];
+        headerLength = 4;
+      }
+      if (_received.size() < headerLength + length) {
+        return false;
+      }
+      binary = (bytes[0] & 0x0f) == 0x2;
+      payload = _received.substr(headerLength, length);
+      _received.erase(0, headerLength + length);
+      return true;
+    }
+
+    std::string readFrame(bool* binary = nullptr) {
+      std::string payload;
+      bool isBinary;
+      while (!takeFrame(payload, isBinary)) {
+        if (!_fill()) {
+          return "";
+        }
+      }
+      if (binary) {
+        *binary = isBinary;
+      }
+      return payload;
+    }
+
+    // For the load generator, which polls lots of clients on one thread.
+    bool receiveAvailable() {
+      return _fill();
+    }
+};
+
+static std::vector<const char*> keys = { "temp_unit", "shelf_temp", "fan_status" };
+
+void setJson(StateServer& stateServer, size_t slot, const std::string& json) {
+  stateServer.setField(slot, [json](std::string& valueJson, std::string& valueMsgPack) {
+    valueJson = json;
+    valueMsgPack = "\xc0";
+  });
+}
+
+// Waits for the server thread to get through a client's handshake or message.
+template <typename TCondition>
+bool waitFor(TCondition condition) {
+  for (int i = 0; i < 1000 && !condition(); i ++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return condition();
+}
+
+void test_handshake_accept_key() {
+  // The example from RFC 6455.
+  TEST_ASSERT_EQUAL_STRING("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", websocket_handshake::acceptKey("dGhlIHNhbXBsZSBub25jZQ==").c_str());
+}
+
+void test_state_goes_out_to_clients() {
+  PosixWebSocketServer server;
+  StateServer stateServer(&keys, &server);
+  server.setStateServer(&stateServer);
+  server.begin();
+
+  TestClient jsonClient(server.getPort());
+  std::string headers = jsonClient.upgrade("/ws");
+  TEST_ASSERT_TRUE(headers.find("101 Switching Protocols") != std::string::npos);
+  TEST_ASSERT_TRUE(headers.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos);
+  TestClient msgPackClient(server.getPort());
+  msgPackClient.upgrade("/ws?encoding=msgpack");
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"fieldIds\",\"data\":[\"temp_unit\",\"shelf_temp\",\"fan_status\"]}", msgPackClient.readFrame().c_str());
+  TEST_ASSERT_TRUE(waitFor([&stateServer]() { return stateServer.readChannel(StateServerStat::clients) == 2; }));
+
+  setJson(stateServer, 1, "21.5");
+  stateServer.publish();
+  bool binary = true;
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"stateUpdated\",\"data\":{\"shelf_temp\":21.5}}", jsonClient.readFrame(&binary).c_str());
+  TEST_ASSERT_FALSE(binary);
+  std::string expected("\x92\x00\x81\x01\xc0", 5);
+  TEST_ASSERT_TRUE(expected == msgPackClient.readFrame(&binary));
+  TEST_ASSERT_TRUE(binary);
+
+  TestClient httpClient(server.getPort());
+  std::string allState = httpClient.get("/allState");
+  TEST_ASSERT_TRUE(allState.find("200 OK") != std::string::npos);
+  TEST_ASSERT_TRUE(allState.find("\r\n\r\n{\"shelf_temp\":21.5}") != std::string::npos);
+  TestClient notFoundClient(server.getPort());
+  TEST_ASSERT_TRUE(notFoundClient.get("/nope").find("404 Not Found") != std::string::npos);
+  server.stop();
+  TEST_ASSERT_EQUAL(0, stateServer.readChannel(StateServerStat::clients));
+}
+
+void test_client_messages_go_to_the_handler() {
+  PosixWebSocketServer server;
+  StateServer stateServer(&keys, &server);
+  server.setStateServer(&stateServer);
+  // receiveStateMessage() needs ArduinoJson, so this just subscribes to whatever key it's sent.
+  server.onMessage([&stateServer](uint32_t clientId, const char* data, size_t length) {
+    stateServer.subscribe(clientId, { std::string(data, length) }, {});
+  });
+  server.begin();
+
+  TestClient client(server.getPort());
+  client.upgrade("/ws");
+  client.sendText("fan_status");
+  TEST_ASSERT_TRUE(waitFor([&stateServer]() {
+    bool subscribed = false;
+    stateServer.forEachClient([&subscribed](uint32_t id, WebSocketEncoding encoding, const ClientOutbox& outbox) { subscribed = true; });
+    return subscribed;
+  }));
+  // There's no way to see the subscription from outside, so wait for it to take effect.
+  std::string frame;
+  bool binary;
+  for (int attempt = 0; attempt < 100; attempt ++) {
+    setJson(stateServer, 1, "21.5");
+    setJson(stateServer, 2, "true");
+    stateServer.publish();
+    frame = client.readFrame(&binary);
+    if (frame.find("shelf_temp") == std::string::npos) {
+      break;
+    }
+  }
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"stateUpdated\",\"data\":{\"fan_status\":true}}", frame.c_str());
+  server.stop();
+}
+
+// The load generator: opens a lot of clients, then publishes a frame every millisecond,
+// with the time it was published in it, and sees how long it takes each client to get it.
+// Set WEBSOCKET_LOAD_CLIENTS to try it with a different number of clients.
+void test_load() {
+  const char* clientsSetting = getenv("WEBSOCKET_LOAD_CLIENTS");
+  const size_t clientCount = clientsSetting ? atoi(clientsSetting) : 32;
+  const int frameCount = 500;
+
+  PosixWebSocketServer server;
+  StateServer stateServer(&keys, &server);
+  server.setStateServer(&stateServer);
+  server.begin();
+
+  std::vector<std::unique_ptr<TestClient>> clients;
+  for (size_t i = 0; i < clientCount; i ++) {
+    clients.emplace_back(new TestClient(server.getPort()));
+    clients.back()->upgrade("/ws");
+  }
+  TEST_ASSERT_TRUE(waitFor([&stateServer, clientCount]() { return stateServer.readChannel(StateServerStat::clients) == clientCount; }));
+
+  auto nowNanos = []() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  };
+  std::vector<uint64_t> latencies;
+  std::atomic<bool> publishing(true);
+  std::thread receiver([&]() {
+    std::vector<pollfd> fds;
+    for (auto& client : clients) {
+      fds.push_back({ client->getFd(), POLLIN, 0 });
+    }
+    std::string payload;
+    bool binary;
+    while (publishing || poll(fds.data(), fds.size(), 50) > 0) {
+      if (poll(fds.data(), fds.size(), 10) <= 0) {
+        continue;
+      }
+      for (size_t i = 0; i < fds.size(); i ++) {
+        if (!(fds[i].revents & POLLIN) || !clients[i]->receiveAvailable()) {
+          continue;
+        }
+        uint64_t receivedAt = nowNanos();
+        while (clients[i]->takeFrame(payload, binary)) {
+          size_t value = payload.find("\"shelf_temp\":");
+          if (value != std::string::npos) {
+            latencies.push_back(receivedAt - strtoull(payload.c_str() + value + 13, nullptr, 10));
+          }
+        }
+      }
+    }
+  });
+
+  uint64_t serverCpuBefore = server.getCpuNanos();
+  timespec publisherCpuBefore;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &publisherCpuBefore);
+  uint64_t startedAt = nowNanos();
+  for (int frame = 0; frame < frameCount; frame ++) {
+    setJson(stateServer, 1, std::to_string(nowNanos()));
+    stateServer.publish();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  uint64_t elapsed = nowNanos() - startedAt;
+  timespec publisherCpuAfter;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &publisherCpuAfter);
+  uint64_t serverCpu = server.getCpuNanos() - serverCpuBefore;
+  uint64_t publisherCpu = (publisherCpuAfter.tv_sec - publisherCpuBefore.tv_sec) * 1000000000ull + publisherCpuAfter.tv_nsec - publisherCpuBefore.tv_nsec;
+  publishing = false;
+  receiver.join();
+  server.stop();
+
+  TEST_ASSERT_TRUE(latencies.size() > 0);
+  std::sort(latencies.begin(), latencies.end());
+  printf("%zu clients, %d frames over %.0f ms: %zu messages delivered (%.0f/s), %u superseded\n",
+    clientCount, frameCount, elapsed / 1e6, latencies.size(), latencies.size() / (elapsed / 1e9),
+    stateServer.readChannel(StateServerStat::superseded));
+  printf("latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+    latencies[latencies.size() / 2] / 1e3, latencies[latencies.size() * 99 / 100] / 1e3, latencies.back() / 1e3);
+  printf("CPU per client per frame: %.2f us on the server thread, %.2f us publishing\n",
+    serverCpu / 1e3 / clientCount / frameCount, publisherCpu / 1e3 / clientCount / frameCount);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_handshake_accept_key);
+  RUN_TEST(test_state_goes_out_to_clients);
+  RUN_TEST(test_client_messages_go_to_the_handler);
+  RUN_TEST(test_load);
+  UNITY_END();
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include <thread>
+#include <vector>
+
+#include <unity.h>
+
+#include <event_stream/BufferedSubscriber.h>
+#include <event_stream/EventStream.h>
+
+void test_events_wait_until_drained() {
+  DumbEventStream<int> stream;
+  std::vector<int> received;
+  BufferedSubscriber<int> buffered(&stream, [&received](const Event<int>& e) { received.push_back(e.value); }, 4);
+  stream.emit(1);
+  stream.emit(2);
+  TEST_ASSERT_EQUAL(0, received.size());
+  TEST_ASSERT_EQUAL(2, buffered.readChannel(BufferedSubscriberStat::depth));
+  TEST_ASSERT_EQUAL(1, buffered.drain(1));
+  TEST_ASSERT_EQUAL(1, buffered.drain());
+  TEST_ASSERT_EQUAL(2, received.size());
+  TEST_ASSERT_EQUAL(1, received[0]);
+  TEST_ASSERT_EQUAL(2, received[1]);
+  TEST_ASSERT_EQUAL(2, buffered.readChannel(BufferedSubscriberStat::delivered));
+  TEST_ASSERT_EQUAL(2, buffered.readChannel(BufferedSubscriberStat::highWaterMark));
+}
+
+void test_drop_oldest() {
+  DumbEventStream<int> stream;
+  std::vector<int> received;
+  BufferedSubscriber<int> buffered(&stream, [&received](const Event<int>& e) { received.push_back(e.value); }, 2, BackpressurePolicy::dropOldest);
+  for (int i = 1; i <= 4; i ++) {
+    stream.emit(i);
+  }
+  buffered.drain();
+  TEST_ASSERT_EQUAL(2, received.size());
+  TEST_ASSERT_EQUAL(3, received[0]);
+  TEST_ASSERT_EQUAL(4, received[1]);
+  TEST_ASSERT_EQUAL(2, buffered.readChannel(BufferedSubscriberStat::dropped));
+}
+
+void test_drop_newest() {
+  DumbEventStream<int> stream;
+  std::vector<int> received;
+  BufferedSubscriber<int> buffered(&stream, [&received](const Event<int>& e) { received.push_back(e.value); }, 2, BackpressurePolicy::dropNewest);
+  for (int i = 1; i <= 4; i ++) {
+    stream.emit(i);
+  }
+  buffered.drain();
+  TEST_ASSERT_EQUAL(2, received.size());
+  TEST_ASSERT_EQUAL(1, received[0]);
+  TEST_ASSERT_EQUAL(2, received[1]);
+  TEST_ASSERT_EQUAL(2, buffered.readChannel(BufferedSubscriberStat::dropped));
+}
+
+void test_latest_value_wins() {
+  DumbEventStream<int> stream;
+  std::vector<int> received;
+  BufferedSubscriber<int> buffered(&stream, [&received](const Event<int>& e) { received.push_back(e.value); }, 8, BackpressurePolicy::latestValueWins);
+  for (int i = 1; i <= 4; i ++) {
+    stream.emit(i);
+  }
+  buffered.drain();
+  TEST_ASSERT_EQUAL(1, received.size());
+  TEST_ASSERT_EQUAL(4, received[0]);
+  TEST_ASSERT_EQUAL(3, buffered.readChannel(BufferedSubscriberStat::dropped));
+}
+
+void test_block_with_timeout_gives_up() {
+  DumbEventStream<int> stream;
+  std::vector<int> received;
+  BufferedSubscriber<int> buffered(&stream, [&received](const Event<int>& e) { received.push_back(e.value); }, 1, BackpressurePolicy::blockWithTimeout, 10);
+  stream.emit(1);
+  // Nobody's draining, so this one waits 10 ms and then gets dropped.
+  stream.emit(2);
+  TEST_ASSERT_EQUAL(1, buffered.readChannel(BufferedSubscriberStat::timedOut));
+  TEST_ASSERT_EQUAL(1, buffered.readChannel(BufferedSubscriberStat::dropped));
+  buffered.drain();
+  TEST_ASSERT_EQUAL(1, received.size());
+  TEST_ASSERT_EQUAL(1, received[0]);
+}
+
+void test_block_with_timeout_waits_for_consumer_task() {
+  DumbEventStream<int> stream;
+  std::vector<int> received;
+  BufferedSubscriber<int> buffered(&stream, [&received](const Event<int>& e) { received.push_back(e.value); }, 1, BackpressurePolicy::blockWithTimeout, 5000);
+  std::thread consumer([&buffered, &received]() {
+    while (received.size() < 10) {
+      buffered.waitAndDrain(100);
+    }
+  });
+  for (int i = 0; i < 10; i ++) {
+    stream.emit(i);
+  }
+  consumer.join();
+  TEST_ASSERT_EQUAL(10, received.size());
+  for (int i = 0; i < 10; i ++) {
+    TEST_ASSERT_EQUAL(i, received[i]);
+  }
+  TEST_ASSERT_EQUAL(0, buffered.readChannel(BufferedSubscriberStat::dropped));
+}
+
+void test_stops_buffering_when_destroyed() {
+  DumbEventStream<int> stream;
+  {
+    BufferedSubscriber<int> buffered(&stream, [](const Event<int>& e) { }, 1);
+  }
+  // Would write to a dead buffer if the subscription were still there.
+  stream.emit(1);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_events_wait_until_drained);
+  RUN_TEST(test_drop_oldest);
+  RUN_TEST(test_drop_newest);
+  RUN_TEST(test_latest_value_wins);
+  RUN_TEST(test_block_with_timeout_gives_up);
+  RUN_TEST(test_block_with_timeout_waits_for_consumer_task);
+  RUN_TEST(test_stops_buffering_when_destroyed);
+  UNITY_END();
+}
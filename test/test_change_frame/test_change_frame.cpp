@@ -0,0 +1,206 @@
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include <Runnable.h>
+#include <Timer.h>
+#include <event_stream/ChangeFrame.h>
+#include <event_stream/EventQueue.h>
+#include <event_stream/EventStream.h>
+
+void test_changes_are_delivered_once_per_tick() {
+  FrameCollector<float> collector;
+  DumbEventStream<float> shelf;
+  DumbEventStream<float> ground;
+  collector.track("shelf", &shelf);
+  collector.track("ground", &ground);
+  int frames = 0;
+  std::vector<std::string> keys;
+  std::vector<float> values;
+  collector.registerConsumer([&](ChangeFrame<float> frame) {
+    frames ++;
+    for (auto& update : frame) {
+      keys.push_back(update.key);
+      values.push_back(update.value);
+    }
+  });
+  shelf.emit(20.0f);
+  ground.emit(15.0f);
+  TEST_ASSERT_EQUAL(0, frames);
+  collector.afterTick();
+  TEST_ASSERT_EQUAL(1, frames);
+  TEST_ASSERT_EQUAL(2, keys.size());
+  TEST_ASSERT_EQUAL_STRING("shelf", keys[0].c_str());
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, values[0]);
+  TEST_ASSERT_EQUAL_STRING("ground", keys[1].c_str());
+  TEST_ASSERT_EQUAL_FLOAT(15.0f, values[1]);
+}
+
+void test_empty_ticks_deliver_nothing() {
+  FrameCollector<float> collector;
+  DumbEventStream<float> shelf;
+  collector.track("shelf", &shelf);
+  int frames = 0;
+  collector.registerConsumer([&frames](ChangeFrame<float> frame) { frames ++; });
+  collector.afterTick();
+  TEST_ASSERT_EQUAL(0, frames);
+  shelf.emit(1.0f);
+  collector.afterTick();
+  collector.afterTick();
+  TEST_ASSERT_EQUAL(1, frames);
+  TEST_ASSERT_EQUAL(1, collector.getFrameCount());
+}
+
+void test_repeated_changes_are_coalesced() {
+  FrameCollector<float> collector;
+  DumbEventStream<float> shelf;
+  DumbEventStream<float> ground;
+  collector.track("shelf", &shelf);
+  collector.track("ground", &ground);
+  std::vector<std::string> keys;
+  std::vector<float> values;
+  collector.registerConsumer([&](ChangeFrame<float> frame) {
+    for (auto& update : frame) {
+      keys.push_back(update.key);
+      values.push_back(update.value);
+    }
+  });
+  shelf.emit(20.0f);
+  ground.emit(15.0f);
+  shelf.emit(21.0f);
+  collector.afterTick();
+  // The shelf keeps its place, but it's got its latest value.
+  TEST_ASSERT_EQUAL(2, keys.size());
+  TEST_ASSERT_EQUAL_STRING("shelf", keys[0].c_str());
+  TEST_ASSERT_EQUAL_FLOAT(21.0f, values[0]);
+  TEST_ASSERT_EQUAL(1, collector.getCoalescedCount());
+  // And the next frame starts fresh.
+  keys.clear();
+  values.clear();
+  ground.emit(16.0f);
+  collector.afterTick();
+  TEST_ASSERT_EQUAL(1, keys.size());
+  TEST_ASSERT_EQUAL_STRING("ground", keys[0].c_str());
+}
+
+void test_updates_carry_their_slot() {
+  FrameCollector<int> collector;
+  DumbEventStream<int> a;
+  DumbEventStream<int> b;
+  collector.track("a", &a);
+  collector.track("b", &b);
+  TEST_ASSERT_EQUAL(2, collector.getKeys().size());
+  TEST_ASSERT_EQUAL_STRING("b", collector.getKeys()[1]);
+  size_t slot = 99;
+  collector.registerConsumer([&slot](ChangeFrame<int> frame) { slot = frame[0].slot; });
+  b.emit(1);
+  collector.afterTick();
+  TEST_ASSERT_EQUAL(1, slot);
+}
+
+void test_values_are_converted() {
+  FrameCollector<std::string> collector;
+  DumbEventStream<int> count;
+  collector.track("count", &count, [](const int& value) { return std::to_string(value); });
+  std::string received;
+  collector.registerConsumer([&received](ChangeFrame<std::string> frame) { received = frame[0].value; });
+  count.emit(42);
+  collector.afterTick();
+  TEST_ASSERT_EQUAL_STRING("42", received.c_str());
+}
+
+void test_emits_from_consumers_go_into_the_next_frame() {
+  FrameCollector<int> collector;
+  DumbEventStream<int> a;
+  DumbEventStream<int> b;
+  collector.track("a", &a);
+  collector.track("b", &b);
+  std::vector<size_t> frameSizes;
+  collector.registerConsumer([&](ChangeFrame<int> frame) {
+    frameSizes.push_back(frame.size());
+    if (frame[0].value == 1) {
+      b.emit(2);
+    }
+  });
+  a.emit(1);
+  collector.afterTick();
+  collector.afterTick();
+  TEST_ASSERT_EQUAL(2, frameSizes.size());
+  TEST_ASSERT_EQUAL(1, frameSizes[0]);
+  TEST_ASSERT_EQUAL(1, frameSizes[1]);
+}
+
+void test_deferred_events_land_in_the_same_frame() {
+  FrameCollector<int> collector;
+  EventQueue queue(16);
+  DumbEventStream<int> sensor;
+  DumbEventStream<int> setting;
+  setting.deferTo(&queue);
+  collector.track("sensor", &sensor);
+  collector.track("setting", &setting);
+  std::vector<size_t> frameSizes;
+  collector.registerConsumer([&frameSizes](ChangeFrame<int> frame) { frameSizes.push_back(frame.size()); });
+  Runner::registerTickObserver(&collector);
+  Runner::registerTickObserver(&queue);
+  sensor.emit(1);
+  setting.emit(2);
+  Runner::run();
+  TEST_ASSERT_EQUAL(1, frameSizes.size());
+  TEST_ASSERT_EQUAL(2, frameSizes[0]);
+}
+
+void test_flush_interval_holds_frames_open() {
+  Timekeeper::setNowSim(0);
+  FrameCollector<int> collector(250);
+  DumbEventStream<int> shelf;
+  DumbEventStream<int> ground;
+  collector.track("shelf", &shelf);
+  collector.track("ground", &ground);
+  std::vector<size_t> frameSizes;
+  int lastShelf = 0;
+  collector.registerConsumer([&](ChangeFrame<int> frame) {
+    frameSizes.push_back(frame.size());
+    for (auto& update : frame) {
+      if (std::string(update.key) == "shelf") {
+        lastShelf = update.value;
+      }
+    }
+  });
+  // The first change after a quiet spell goes out right away.
+  shelf.emit(1);
+  collector.afterTick();
+  TEST_ASSERT_EQUAL(1, frameSizes.size());
+  // A burst of changes over the next few ticks...
+  for (int i = 2; i <= 20; i ++) {
+    Timekeeper::tick(10);
+    shelf.emit(i);
+    ground.emit(i);
+    collector.afterTick();
+  }
+  // ...waits for the interval, and only the latest of each goes out.
+  TEST_ASSERT_EQUAL(1, frameSizes.size());
+  Timekeeper::setNowSim(250);
+  collector.afterTick();
+  TEST_ASSERT_EQUAL(2, frameSizes.size());
+  TEST_ASSERT_EQUAL(2, frameSizes[1]);
+  TEST_ASSERT_EQUAL(20, lastShelf);
+  // 39 changes, 2 messages.
+  TEST_ASSERT_EQUAL(39, collector.readChannel(FrameCollectorStat::updates));
+  TEST_ASSERT_EQUAL(2, collector.readChannel(FrameCollectorStat::frames));
+  TEST_ASSERT_EQUAL(36, collector.readChannel(FrameCollectorStat::coalesced));
+}
+
+int main(int argc, char **argv) {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  UNITY_BEGIN();
+  RUN_TEST(test_changes_are_delivered_once_per_tick);
+  RUN_TEST(test_empty_ticks_deliver_nothing);
+  RUN_TEST(test_repeated_changes_are_coalesced);
+  RUN_TEST(test_updates_carry_their_slot);
+  RUN_TEST(test_values_are_converted);
+  RUN_TEST(test_emits_from_consumers_go_into_the_next_frame);
+  RUN_TEST(test_deferred_events_land_in_the_same_frame);
+  RUN_TEST(test_flush_interval_holds_frames_open);
+  UNITY_END();
+}
@@ -0,0 +1,94 @@
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include <ClientOutbox.h>
+#include <MsgPackWriter.h>
+#include <WebSocketMessages.h>
+
+void test_starts_empty() {
+  ClientOutbox outbox(4);
+  TEST_ASSERT_TRUE(outbox.empty());
+  TEST_ASSERT_EQUAL(0, outbox.getDepth());
+  TEST_ASSERT_EQUAL(4, outbox.pending().size());
+}
+
+void test_newer_values_replace_waiting_ones() {
+  ClientOutbox outbox(4);
+  outbox.push(1);
+  outbox.push(3);
+  outbox.push(1);
+  outbox.push(1);
+  TEST_ASSERT_EQUAL(2, outbox.getDepth());
+  TEST_ASSERT_EQUAL(2, outbox.getSupersededCount());
+  std::vector<bool> expected = { false, true, false, true };
+  TEST_ASSERT_TRUE(expected == outbox.pending());
+}
+
+void test_a_stalled_client_never_holds_more_than_one_per_field() {
+  ClientOutbox outbox(3);
+  for (int frame = 0; frame < 1000; frame ++) {
+    outbox.push(frame % 3);
+  }
+  TEST_ASSERT_EQUAL(3, outbox.getDepth());
+  TEST_ASSERT_EQUAL(3, outbox.getMaxDepth());
+  TEST_ASSERT_EQUAL(997, outbox.getSupersededCount());
+}
+
+void test_clearing_after_a_send() {
+  ClientOutbox outbox(3);
+  outbox.push(0);
+  outbox.push(2);
+  outbox.clear();
+  TEST_ASSERT_TRUE(outbox.empty());
+  TEST_ASSERT_EQUAL(1, outbox.getMessagesSent());
+  TEST_ASSERT_EQUAL(2, outbox.getMaxDepth());
+  // Nothing was waiting, so nothing was sent.
+  outbox.clear();
+  TEST_ASSERT_EQUAL(1, outbox.getMessagesSent());
+  // And it still has all its slots, so it compares with other clients' outboxes.
+  outbox.push(1);
+  std::vector<bool> expected = { false, true, false };
+  TEST_ASSERT_TRUE(expected == outbox.pending());
+}
+
+void test_clients_owed_the_same_fields_match() {
+  ClientOutbox caughtUp(3);
+  ClientOutbox slow(3);
+  caughtUp.push(2);
+  slow.push(2);
+  slow.push(2);
+  TEST_ASSERT_TRUE(caughtUp.pending() == slow.pending());
+  slow.push(0);
+  TEST_ASSERT_FALSE(caughtUp.pending() == slow.pending());
+}
+
+void test_msgpack_message_from_waiting_fields() {
+  // 21.5f, true and null, already encoded.
+  std::vector<std::string> valuesMsgPack = {
+    std::string("\xca\x41\xac\x00\x00", 5),
+    std::string("\xc3", 1),
+    std::string("\xc0", 1)
+  };
+  ClientOutbox outbox(3);
+  outbox.push(2);
+  outbox.push(1);
+  uint8_t buffer[16];
+  MsgPackWriter writer(buffer, sizeof(buffer));
+  writeStateUpdatedMsgPack(writer, valuesMsgPack, outbox.pending());
+  std::vector<uint8_t> expected = { 0x92, 0x00, 0x82, 0x01, 0xc3, 0x02, 0xc0 };
+  TEST_ASSERT_EQUAL(expected.size(), writer.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), buffer, expected.size());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_starts_empty);
+  RUN_TEST(test_newer_values_replace_waiting_ones);
+  RUN_TEST(test_a_stalled_client_never_holds_more_than_one_per_field);
+  RUN_TEST(test_clearing_after_a_send);
+  RUN_TEST(test_clients_owed_the_same_fields_match);
+  RUN_TEST(test_msgpack_message_from_waiting_fields);
+  UNITY_END();
+}
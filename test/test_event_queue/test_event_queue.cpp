@@ -0,0 +1,205 @@
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include <event_stream/EventQueue.h>
+#include <event_stream/EventStream.h>
+#include <event_stream/EventStreamProcesses.h>
+
+void test_deferred_events_are_dispatched_in_order() {
+  EventQueue queue(16);
+  DumbEventStream<int> a;
+  DumbEventStream<int> b;
+  a.deferTo(&queue);
+  b.deferTo(&queue);
+  std::vector<int> received;
+  a.registerSubscriber([&received](const Event<int>& e) { received.push_back(e.value); });
+  b.registerSubscriber([&received](const Event<int>& e) { received.push_back(e.value * 10); });
+  a.emit(1);
+  b.emit(2);
+  a.emit(3);
+  TEST_ASSERT_EQUAL(0, received.size());
+  // The last event is still up to date, even though nobody's heard about it yet.
+  TEST_ASSERT_EQUAL(3, a.getLastEvent().value().value);
+  TEST_ASSERT_EQUAL(3, queue.readChannel(EventQueueStat::depth));
+  queue.afterTick();
+  TEST_ASSERT_EQUAL(3, received.size());
+  TEST_ASSERT_EQUAL(1, received[0]);
+  TEST_ASSERT_EQUAL(20, received[1]);
+  TEST_ASSERT_EQUAL(3, received[2]);
+  TEST_ASSERT_EQUAL(3, queue.readChannel(EventQueueStat::dispatched));
+  TEST_ASSERT_EQUAL(0, queue.readChannel(EventQueueStat::depth));
+}
+
+void test_cascades_do_not_grow_the_stack() {
+  EventQueue queue(16);
+  DumbEventStream<int> counter;
+  counter.deferTo(&queue);
+  int depth = 0;
+  int maxDepth = 0;
+  int lastValue = 0;
+  // Counts itself down to zero, one emit at a time.
+  counter.registerSubscriber([&](const Event<int>& e) {
+    depth ++;
+    maxDepth = std::max(depth, maxDepth);
+    lastValue = e.value;
+    if (e.value > 0) {
+      counter.emit(e.value - 1);
+    }
+    depth --;
+  });
+  // It goes through a translator too, which isn't deferred.
+  EventStreamTranslator<int, std::string> asString(&counter, [](int v) { return std::to_string(v); });
+  std::string lastString;
+  asString.registerSubscriber([&lastString](const Event<std::string>& e) { lastString = e.value; });
+  counter.emit(100);
+  queue.drain();
+  TEST_ASSERT_EQUAL(0, lastValue);
+  TEST_ASSERT_EQUAL_STRING("0", lastString.c_str());
+  TEST_ASSERT_EQUAL(1, maxDepth);
+  TEST_ASSERT_EQUAL(101, queue.readChannel(EventQueueStat::dispatched));
+}
+
+void test_dispatch_cap_leaves_the_rest_for_next_tick() {
+  EventQueue queue(16, 2);
+  DumbEventStream<int> stream;
+  stream.deferTo(&queue, 8);
+  int count = 0;
+  stream.registerSubscriber([&count](const Event<int>& e) { count ++; });
+  for (int i = 0; i < 5; i ++) {
+    stream.emit(i);
+  }
+  queue.afterTick();
+  TEST_ASSERT_EQUAL(2, count);
+  TEST_ASSERT_EQUAL(1, queue.readChannel(EventQueueStat::carriedOverTicks));
+  queue.afterTick();
+  queue.afterTick();
+  TEST_ASSERT_EQUAL(5, count);
+  TEST_ASSERT_EQUAL(2, queue.readChannel(EventQueueStat::carriedOverTicks));
+}
+
+void test_overflow_policies() {
+  EventQueue queue(4);
+  DumbEventStream<int> newestDropped;
+  DumbEventStream<int> oldestDropped;
+  DumbEventStream<int> immediate;
+  newestDropped.deferTo(&queue, 2, EventOverflowPolicy::dropNewest);
+  oldestDropped.deferTo(&queue, 2, EventOverflowPolicy::dropOldest);
+  immediate.deferTo(&queue, 2, EventOverflowPolicy::dispatchNow);
+  std::vector<int> received;
+  auto record = [&received](const Event<int>& e) { received.push_back(e.value); };
+  newestDropped.registerSubscriber(record);
+  oldestDropped.registerSubscriber(record);
+  immediate.registerSubscriber(record);
+
+  // Each stream's own backlog only holds two.
+  newestDropped.emit(1);
+  newestDropped.emit(2);
+  newestDropped.emit(3);
+  oldestDropped.emit(11);
+  oldestDropped.emit(12);
+  oldestDropped.emit(13);
+  TEST_ASSERT_EQUAL(2, queue.readChannel(EventQueueStat::dropped));
+  TEST_ASSERT_EQUAL(4, queue.readChannel(EventQueueStat::depth));
+  // The queue's full now, so this one can't wait.
+  immediate.emit(21);
+  TEST_ASSERT_EQUAL(1, received.size());
+  TEST_ASSERT_EQUAL(21, received[0]);
+  TEST_ASSERT_EQUAL(1, queue.readChannel(EventQueueStat::dispatchedImmediately));
+
+  queue.drain();
+  TEST_ASSERT_EQUAL(5, received.size());
+  TEST_ASSERT_EQUAL(1, received[1]);
+  TEST_ASSERT_EQUAL(2, received[2]);
+  TEST_ASSERT_EQUAL(12, received[3]);
+  TEST_ASSERT_EQUAL(13, received[4]);
+  TEST_ASSERT_EQUAL(4, queue.readChannel(EventQueueStat::highWaterMark));
+}
+
+void test_full_queue_drops_oldest_across_streams() {
+  EventQueue queue(2);
+  DumbEventStream<int> a;
+  DumbEventStream<int> b;
+  a.deferTo(&queue);
+  b.deferTo(&queue);
+  std::vector<int> received;
+  a.registerSubscriber([&received](const Event<int>& e) { received.push_back(e.value); });
+  b.registerSubscriber([&received](const Event<int>& e) { received.push_back(e.value); });
+  a.emit(1);
+  b.emit(2);
+  b.emit(3);
+  queue.drain();
+  TEST_ASSERT_EQUAL(2, received.size());
+  TEST_ASSERT_EQUAL(2, received[0]);
+  TEST_ASSERT_EQUAL(3, received[1]);
+}
+
+void test_full_queue_only_drops_events_from_dropoldest_streams() {
+  EventQueue queue(3);
+  DumbEventStream<int> alarm;
+  DumbEventStream<int> setting;
+  DumbEventStream<int> telemetry;
+  alarm.deferTo(&queue, 2, EventOverflowPolicy::dispatchNow);
+  setting.deferTo(&queue, 2, EventOverflowPolicy::dropNewest);
+  telemetry.deferTo(&queue, 4, EventOverflowPolicy::dropOldest);
+  std::vector<int> received;
+  auto record = [&received](const Event<int>& e) { received.push_back(e.value); };
+  alarm.registerSubscriber(record);
+  setting.registerSubscriber(record);
+  telemetry.registerSubscriber(record);
+  alarm.emit(1);
+  setting.emit(2);
+  telemetry.emit(3);
+  // Pushes out the telemetry's own waiting event, not the alarm or the setting that are older.
+  telemetry.emit(4);
+  TEST_ASSERT_EQUAL(1, queue.readChannel(EventQueueStat::dropped));
+  queue.drain();
+  TEST_ASSERT_EQUAL(3, received.size());
+  TEST_ASSERT_EQUAL(1, received[0]);
+  TEST_ASSERT_EQUAL(2, received[1]);
+  TEST_ASSERT_EQUAL(4, received[2]);
+
+  // With nothing it's allowed to push out, the newest telemetry gets dropped instead.
+  received.clear();
+  alarm.emit(5);
+  setting.emit(6);
+  alarm.emit(7);
+  telemetry.emit(8);
+  TEST_ASSERT_EQUAL(2, queue.readChannel(EventQueueStat::dropped));
+  queue.drain();
+  TEST_ASSERT_EQUAL(3, received.size());
+  TEST_ASSERT_EQUAL(5, received[0]);
+  TEST_ASSERT_EQUAL(6, received[1]);
+  TEST_ASSERT_EQUAL(7, received[2]);
+}
+
+void test_destroyed_streams_are_forgotten() {
+  EventQueue queue(4);
+  DumbEventStream<int> survivor;
+  survivor.deferTo(&queue);
+  int count = 0;
+  survivor.registerSubscriber([&count](const Event<int>& e) { count ++; });
+  {
+    DumbEventStream<int> doomed;
+    doomed.deferTo(&queue);
+    doomed.emit(1);
+    survivor.emit(2);
+    doomed.emit(3);
+  }
+  TEST_ASSERT_EQUAL(1, queue.readChannel(EventQueueStat::depth));
+  queue.drain();
+  TEST_ASSERT_EQUAL(1, count);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_deferred_events_are_dispatched_in_order);
+  RUN_TEST(test_cascades_do_not_grow_the_stack);
+  RUN_TEST(test_dispatch_cap_leaves_the_rest_for_next_tick);
+  RUN_TEST(test_overflow_policies);
+  RUN_TEST(test_full_queue_drops_oldest_across_streams);
+  RUN_TEST(test_full_queue_only_drops_events_from_dropoldest_streams);
+  RUN_TEST(test_destroyed_streams_are_forgotten);
+  UNITY_END();
+}
@@ -1,9 +1,12 @@
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include <unity.h>
 
 #include <helpers/string_format.h>
 #include <Timer.h>
+#include <event_stream/EventQueue.h>
 #include <event_stream/EventStreamProcesses.h>
 
 void test_honours_receive_last_event_flag() {
@@ -55,6 +58,112 @@ void test_input_to_event_stream() {
   TEST_ASSERT_EQUAL(15, value);
 }
 
+void test_input_to_event_stream_deadband() {
+  Timekeeper::setNowSim(0);
+  StateInput<std::optional<float>> input(20.0f);
+  InputToEventStream inputToEventStream(&input, 0, EmitPolicy(0.1f));
+  int emits = 0;
+  std::optional<float> value;
+  inputToEventStream.registerSubscriber([&emits, &value](const Event<std::optional<float>>& e) {
+    emits ++;
+    value = e.value;
+  });
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(1, emits);
+  // Flicker in the last decimal doesn't count...
+  input.write(20.06f);
+  inputToEventStream.run();
+  input.write(19.95f);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(1, emits);
+  // ...but creeping past the deadband from the last emitted value does.
+  input.write(20.15f);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(2, emits);
+  TEST_ASSERT_EQUAL_FLOAT(20.15f, value.value());
+  // Losing the sensor always counts.
+  input.write(std::nullopt);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(3, emits);
+  TEST_ASSERT_FALSE(value.has_value());
+}
+
+void test_input_to_event_stream_relative_deadband() {
+  Timekeeper::setNowSim(0);
+  StateInput<float> input(1000.0f);
+  InputToEventStream inputToEventStream(&input, 0, EmitPolicy(0, 0.05f));
+  int emits = 0;
+  inputToEventStream.registerSubscriber([&emits](const Event<float>& e) { emits ++; });
+  inputToEventStream.run();
+  input.write(1040.0f);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(1, emits);
+  input.write(1060.0f);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(2, emits);
+}
+
+void test_input_to_event_stream_min_interval() {
+  Timekeeper::setNowSim(0);
+  StateInput input(0);
+  InputToEventStream inputToEventStream(&input, 0, EmitPolicy(0, 0, 10));
+  int emits = 0;
+  int value = 0;
+  inputToEventStream.registerSubscriber([&emits, &value](const Event<int>& e) {
+    emits ++;
+    value = e.value;
+  });
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(1, emits);
+  for (int i = 1; i < 10; i ++) {
+    Timekeeper::setNowSim(i);
+    input.write(i);
+    inputToEventStream.run();
+  }
+  TEST_ASSERT_EQUAL(1, emits);
+  // Once the interval's up, the latest value that was held back comes through.
+  Timekeeper::setNowSim(10);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(2, emits);
+  TEST_ASSERT_EQUAL(9, value);
+  // A change that gets undone before the interval's up never gets emitted.
+  Timekeeper::setNowSim(12);
+  input.write(5);
+  inputToEventStream.run();
+  Timekeeper::setNowSim(14);
+  input.write(9);
+  inputToEventStream.run();
+  Timekeeper::setNowSim(30);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(2, emits);
+}
+
+void test_input_to_event_stream_heartbeat() {
+  Timekeeper::setNowSim(0);
+  StateInput input(7);
+  InputToEventStream inputToEventStream(&input, 0, EmitPolicy(0, 0, 0, 100));
+  int emits = 0;
+  inputToEventStream.registerSubscriber([&emits](const Event<int>& e) { emits ++; });
+  for (int i = 0; i < 100; i ++) {
+    Timekeeper::setNowSim(i);
+    inputToEventStream.run();
+  }
+  TEST_ASSERT_EQUAL(1, emits);
+  Timekeeper::setNowSim(100);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(2, emits);
+  // A real change resets the heartbeat.
+  Timekeeper::setNowSim(150);
+  input.write(8);
+  inputToEventStream.run();
+  Timekeeper::setNowSim(200);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(3, emits);
+  Timekeeper::setNowSim(250);
+  inputToEventStream.run();
+  TEST_ASSERT_EQUAL(4, emits);
+}
+
 void test_event_stream_filter() {
   DumbEventStream<int> unfiltered;
   int filteredEventsCount = 0;
@@ -203,6 +312,34 @@ void test_event_stream_debouncer() {
   TEST_ASSERT_FALSE(receivedValue);
 }
 
+void test_event_stream_debouncer_on_a_clock() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  TickClock clock;
+  DumbEventStream<bool> noisyButton;
+  EventStreamDebouncer<bool> cleanButton(&noisyButton, 10, &clock);
+  std::vector<bool> received;
+  cleanButton.registerSubscriber([&received](Event<bool> e) { received.push_back(e.value); });
+
+  noisyButton.emit(true);
+  noisyButton.emit(false);
+  noisyButton.emit(true);
+  // No need to run it; the clock wakes it up when the delay's over.
+  Timekeeper::setNowSim(9);
+  clock.beforeTick();
+  TEST_ASSERT_EQUAL(0, received.size());
+  Timekeeper::setNowSim(10);
+  clock.beforeTick();
+  TEST_ASSERT_EQUAL(1, received.size());
+  TEST_ASSERT_TRUE(received[0]);
+
+  // A value that doesn't hold doesn't get through.
+  noisyButton.emit(false);
+  noisyButton.emit(true);
+  Timekeeper::setNowSim(20);
+  clock.beforeTick();
+  TEST_ASSERT_EQUAL(1, received.size());
+}
+
 void test_event_stream_switcher() {
   Timekeeper::setNowSim(0);
   auto alice = new DumbEventStream<const char*>();
@@ -333,19 +470,226 @@ void test_beacon_with_optional_value_input() {
   }
 }
 
+void test_beacons_on_a_clock_emit_together() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  TickClock clock;
+  ConstantInput valueInput(15);
+  StateInput firstStatus(true);
+  StateInput secondStatus(false);
+  Beacon first(&valueInput, &firstStatus, 1000, &clock);
+  Beacon second(&valueInput, &secondStatus, 1000, &clock);
+  std::vector<unsigned long> firstEmits;
+  std::vector<unsigned long> secondEmits;
+  first.registerSubscriber([&firstEmits](Event<int> e) { firstEmits.push_back(e.timestamp); });
+  second.registerSubscriber([&secondEmits](Event<int> e) { secondEmits.push_back(e.timestamp); });
+  for (unsigned long i = 0; i <= 3000; i += 100) {
+    Timekeeper::setNowSim(i);
+    clock.beforeTick();
+    if (i == 1500) {
+      secondStatus.write(true);
+    }
+    first.run();
+    second.run();
+  }
+  TEST_ASSERT_EQUAL(3, firstEmits.size());
+  TEST_ASSERT_EQUAL(1000, firstEmits[0]);
+  // The second one started halfway through an interval, but still emits on the same ticks as the first.
+  TEST_ASSERT_EQUAL(2, secondEmits.size());
+  TEST_ASSERT_EQUAL(2000, secondEmits[0]);
+  TEST_ASSERT_EQUAL(3000, secondEmits[1]);
+  // And it stops when its status goes false.
+  firstStatus.write(false);
+  first.run();
+  Timekeeper::setNowSim(4000);
+  clock.beforeTick();
+  TEST_ASSERT_EQUAL(3, firstEmits.size());
+  TEST_ASSERT_EQUAL(3, secondEmits.size());
+}
+
+void test_event_stream_stats() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  DumbEventStream<int> quiet;
+  quiet.emit(1);
+  TEST_ASSERT_FALSE((bool)quiet.getStats());
+
+  DumbEventStream<int> busy;
+  busy.registerSubscriber([](Event<int> e) { });
+  busy.enableStats("busy");
+  // A slow subscriber, like a websocket broadcast.
+  busy.registerSubscriber([](Event<int> e) { Timekeeper::tickMicros(e.value); });
+  auto stats = busy.getStats();
+  TEST_ASSERT_EQUAL_STRING("busy", stats->name);
+  TEST_ASSERT_EQUAL(2, stats->subscriberCount);
+  TEST_ASSERT_TRUE(EventStreamStats::all().back() == stats);
+
+  for (int i = 1; i <= 10; i ++) {
+    busy.emit(i * 100);
+  }
+  TEST_ASSERT_EQUAL(10, stats->emitCount);
+  TEST_ASSERT_EQUAL(5500, stats->totalSubscriberTime);
+  TEST_ASSERT_EQUAL(1000, stats->maxSubscriberTime);
+
+  // Ten emits in the first second...
+  Timekeeper::tick(1000);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 10.0f, stats->emitsPerSecond());
+  // ... and none in the next two.
+  Timekeeper::tick(2000);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, stats->emitsPerSecond());
+  // Reading the rate doesn't move the window along; only emitting does.
+  busy.emit(0);
+  busy.emit(0);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, stats->emitsPerSecond());
+  Timekeeper::tick(1000);
+  TEST_ASSERT_EQUAL_FLOAT(2.0f, stats->emitsPerSecond());
+}
+
+void test_subscription_can_be_cancelled() {
+  DumbEventStream<int> eventStream;
+  int firstCount = 0;
+  int secondCount = 0;
+  Subscription first = eventStream.registerSubscriber([&firstCount](const Event<int>& e) { firstCount ++; });
+  eventStream.registerSubscriber([&secondCount](const Event<int>& e) { secondCount ++; });
+  eventStream.emit(1);
+  TEST_ASSERT_TRUE(first.isActive());
+  first.cancel();
+  TEST_ASSERT_FALSE(first.isActive());
+  TEST_ASSERT_EQUAL(1, eventStream.getSubscriberCount());
+  eventStream.emit(2);
+  TEST_ASSERT_EQUAL(1, firstCount);
+  TEST_ASSERT_EQUAL(2, secondCount);
+  // Cancelling twice is harmless.
+  first.cancel();
+  TEST_ASSERT_EQUAL(1, eventStream.getSubscriberCount());
+}
+
+void test_subscribers_can_change_subscriptions_while_being_called() {
+  DumbEventStream<int> eventStream;
+  int selfCancellingCount = 0;
+  int lateCount = 0;
+  int laterCount = 0;
+  Subscription selfCancelling;
+  selfCancelling = eventStream.registerSubscriber([&](const Event<int>& e) {
+    selfCancellingCount ++;
+    selfCancelling.cancel();
+    // Registered mid-emit, so it doesn't hear this event.
+    eventStream.registerSubscriber([&lateCount](const Event<int>& e) { lateCount ++; });
+  });
+  Subscription later = eventStream.registerSubscriber([&laterCount](const Event<int>& e) { laterCount ++; });
+  // Cancelled by an earlier subscriber in the same emit.
+  eventStream.registerSubscriber([&later](const Event<int>& e) { later.cancel(); });
+  eventStream.emit(1);
+  TEST_ASSERT_EQUAL(1, selfCancellingCount);
+  TEST_ASSERT_EQUAL(0, lateCount);
+  TEST_ASSERT_EQUAL(1, laterCount);
+  eventStream.emit(2);
+  TEST_ASSERT_EQUAL(1, selfCancellingCount);
+  TEST_ASSERT_EQUAL(1, lateCount);
+  TEST_ASSERT_EQUAL(1, laterCount);
+  TEST_ASSERT_EQUAL(2, eventStream.getSubscriberCount());
+}
+
+void test_subscription_outlives_its_stream() {
+  Subscription subscription;
+  {
+    DumbEventStream<int> eventStream;
+    subscription = eventStream.registerSubscriber([](const Event<int>& e) { });
+  }
+  TEST_ASSERT_FALSE(subscription.isActive());
+  subscription.cancel();
+}
+
+void test_history_replays_to_late_subscribers() {
+  DumbEventStream<int> stream;
+  stream.enableHistory(3);
+  stream.emit(10);
+  TEST_ASSERT_EQUAL(1, stream.getSequence());
+  stream.emit(20);
+  stream.emit(30);
+  std::vector<int> values;
+  std::vector<uint32_t> sequences;
+  stream.registerSubscriberFrom(1, [&values, &sequences](const Event<int>& e, uint32_t sequence) {
+    values.push_back(e.value);
+    sequences.push_back(sequence);
+  });
+  TEST_ASSERT_EQUAL(2, values.size());
+  TEST_ASSERT_EQUAL(20, values[0]);
+  TEST_ASSERT_EQUAL(2, sequences[0]);
+  TEST_ASSERT_EQUAL(30, values[1]);
+  TEST_ASSERT_EQUAL(3, sequences[1]);
+  // And then it carries on with new ones.
+  stream.emit(40);
+  TEST_ASSERT_EQUAL(3, values.size());
+  TEST_ASSERT_EQUAL(40, values[2]);
+  TEST_ASSERT_EQUAL(4, sequences[2]);
+}
+
+void test_history_knows_when_it_has_forgotten() {
+  DumbEventStream<int> stream;
+  TEST_ASSERT_TRUE(stream.historyCovers(0));
+  stream.emit(1);
+  // No history, so there's no catching up.
+  TEST_ASSERT_FALSE(stream.historyCovers(0));
+  TEST_ASSERT_TRUE(stream.historyCovers(1));
+  stream.enableHistory(2);
+  for (int i = 2; i <= 5; i ++) {
+    stream.emit(i);
+  }
+  TEST_ASSERT_FALSE(stream.historyCovers(2));
+  TEST_ASSERT_TRUE(stream.historyCovers(3));
+  TEST_ASSERT_TRUE(stream.historyCovers(5));
+  // Someone who saw sequence numbers that haven't happened yet, e.g., before a reboot, has to start over.
+  TEST_ASSERT_FALSE(stream.historyCovers(9));
+  // Asking for more than's there gets you what's left.
+  std::vector<int> values;
+  stream.forEachInHistory(0, [&values](const Event<int>& e, uint32_t sequence) { values.push_back(e.value); });
+  TEST_ASSERT_EQUAL(2, values.size());
+  TEST_ASSERT_EQUAL(4, values[0]);
+  TEST_ASSERT_EQUAL(5, values[1]);
+}
+
+void test_history_only_has_dispatched_events() {
+  EventQueue queue(4);
+  DumbEventStream<int> stream;
+  stream.enableHistory(4);
+  stream.deferTo(&queue, 1, EventOverflowPolicy::dropOldest);
+  stream.emit(1);
+  stream.emit(2);
+  TEST_ASSERT_EQUAL(0, stream.getSequence());
+  queue.drain();
+  // The first one got dropped before anyone saw it, so it doesn't get a sequence number.
+  std::vector<int> values;
+  stream.registerSubscriberFrom(0, [&values](const Event<int>& e, uint32_t sequence) { values.push_back(e.value); });
+  TEST_ASSERT_EQUAL(1, values.size());
+  TEST_ASSERT_EQUAL(2, values[0]);
+  TEST_ASSERT_EQUAL(1, stream.getSequence());
+}
+
 int main(int argc, char **argv) {
   Timekeeper::setSource(TimekeeperSource::simTime);
   UNITY_BEGIN();
   RUN_TEST(test_honours_receive_last_event_flag);
   RUN_TEST(test_can_get_last_event);
   RUN_TEST(test_input_to_event_stream);
+  RUN_TEST(test_input_to_event_stream_deadband);
+  RUN_TEST(test_input_to_event_stream_relative_deadband);
+  RUN_TEST(test_input_to_event_stream_min_interval);
+  RUN_TEST(test_input_to_event_stream_heartbeat);
   RUN_TEST(test_event_stream_filter);
   RUN_TEST(test_event_stream_translator);
   RUN_TEST(test_event_stream_not_empty);
   RUN_TEST(test_event_stream_debouncer);
+  RUN_TEST(test_event_stream_debouncer_on_a_clock);
   RUN_TEST(test_event_stream_switcher);
   RUN_TEST(test_event_stream_combiner);
   RUN_TEST(test_beacon_with_boolean_status_input);
   RUN_TEST(test_beacon_with_optional_value_input);
+  RUN_TEST(test_beacons_on_a_clock_emit_together);
+  RUN_TEST(test_event_stream_stats);
+  RUN_TEST(test_subscription_can_be_cancelled);
+  RUN_TEST(test_subscribers_can_change_subscriptions_while_being_called);
+  RUN_TEST(test_subscription_outlives_its_stream);
+  RUN_TEST(test_history_replays_to_late_subscribers);
+  RUN_TEST(test_history_knows_when_it_has_forgotten);
+  RUN_TEST(test_history_only_has_dispatched_events);
   UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include <FieldSubscription.h>
+
+static const std::vector<const char*> allKeys = {
+  "temp_unit", "shelf_temp", "door_alarm_control", "extreme_temp_alarm_control", "alarm_noise", "alarm_phone"
+};
+
+void test_everything_by_default() {
+  FieldSubscription subscription;
+  TEST_ASSERT_TRUE(subscription.isEverything());
+  TEST_ASSERT_TRUE(subscription.wants(0));
+  // Even fields that got tracked after subscribing.
+  TEST_ASSERT_TRUE(subscription.wants(100));
+  FieldSubscription emptyRequest(allKeys, {}, {});
+  TEST_ASSERT_TRUE(emptyRequest.isEverything());
+}
+
+void test_keys_and_prefixes() {
+  FieldSubscription subscription(allKeys, { "door_alarm_control", "no_such_field" }, { "alarm_" });
+  TEST_ASSERT_FALSE(subscription.isEverything());
+  TEST_ASSERT_FALSE(subscription.wants(0));
+  TEST_ASSERT_FALSE(subscription.wants(1));
+  TEST_ASSERT_TRUE(subscription.wants(2));
+  TEST_ASSERT_FALSE(subscription.wants(3));
+  TEST_ASSERT_TRUE(subscription.wants(4));
+  TEST_ASSERT_TRUE(subscription.wants(5));
+  TEST_ASSERT_FALSE(subscription.wants(6));
+}
+
+void test_same_fields_asked_for_differently_are_equal() {
+  FieldSubscription byKeys(allKeys, { "alarm_noise", "alarm_phone" }, {});
+  FieldSubscription byPrefix(allKeys, {}, { "alarm_" });
+  FieldSubscription other(allKeys, { "shelf_temp" }, {});
+  TEST_ASSERT_TRUE(byKeys == byPrefix);
+  TEST_ASSERT_FALSE(byKeys == other);
+  // And they're ordered, so they can be map keys.
+  TEST_ASSERT_TRUE((byKeys < other) != (other < byKeys));
+  TEST_ASSERT_FALSE(byKeys < byPrefix);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_everything_by_default);
+  RUN_TEST(test_keys_and_prefixes);
+  RUN_TEST(test_same_fields_asked_for_differently_are_equal);
+  UNITY_END();
+}
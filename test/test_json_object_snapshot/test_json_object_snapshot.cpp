@@ -0,0 +1,73 @@
+#include <memory>
+#include <string>
+
+#include <unity.h>
+
+#include <JsonObjectSnapshot.h>
+
+void test_starts_empty() {
+  JsonObjectSnapshot snapshot;
+  TEST_ASSERT_EQUAL_STRING("{}", snapshot.get()->c_str());
+}
+
+void test_fields_come_out_in_slot_order() {
+  JsonObjectSnapshot snapshot;
+  snapshot.set(1, "heater", std::string("true"));
+  snapshot.set(0, "shelf_temp", std::string("21.5"));
+  // Nothing changes until it's published.
+  TEST_ASSERT_EQUAL_STRING("{}", snapshot.get()->c_str());
+  snapshot.publish();
+  TEST_ASSERT_EQUAL_STRING("{\"shelf_temp\":21.5,\"heater\":true}", snapshot.get()->c_str());
+}
+
+void test_patching_a_field_replaces_it() {
+  JsonObjectSnapshot snapshot;
+  snapshot.set(0, "shelf_temp", std::string("21.5"));
+  snapshot.set(2, "fan", std::string("{\"setpoint\":30,\"hysteresis\":1}"));
+  snapshot.publish();
+  snapshot.set(0, "shelf_temp", std::string("null"));
+  snapshot.publish();
+  TEST_ASSERT_EQUAL_STRING("{\"shelf_temp\":null,\"fan\":{\"setpoint\":30,\"hysteresis\":1}}", snapshot.get()->c_str());
+  TEST_ASSERT_EQUAL(2, snapshot.getPublishCount());
+  // Publishing with nothing new is free.
+  snapshot.publish();
+  TEST_ASSERT_EQUAL(2, snapshot.getPublishCount());
+}
+
+void test_snapshots_being_sent_stay_alive() {
+  JsonObjectSnapshot snapshot;
+  snapshot.set(0, "heater", std::string("false"));
+  snapshot.publish();
+  std::shared_ptr<const std::string> beingSent = snapshot.get();
+  snapshot.set(0, "heater", std::string("true"));
+  snapshot.publish();
+  snapshot.set(0, "heater", std::string("false"));
+  snapshot.publish();
+  snapshot.set(0, "heater", std::string("true"));
+  snapshot.publish();
+  // Still the one it was when the request got it, even though it's been published over three times.
+  TEST_ASSERT_EQUAL_STRING("{\"heater\":false}", beingSent->c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"heater\":true}", snapshot.get()->c_str());
+}
+
+void test_publishing_reuses_buffers_nobody_holds() {
+  JsonObjectSnapshot snapshot;
+  snapshot.set(0, "heater", std::string("false"));
+  snapshot.publish();
+  const std::string* first = snapshot.get().get();
+  snapshot.set(0, "heater", std::string("true"));
+  snapshot.publish();
+  snapshot.set(0, "heater", std::string("false"));
+  snapshot.publish();
+  TEST_ASSERT_TRUE(first == snapshot.get().get());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_starts_empty);
+  RUN_TEST(test_fields_come_out_in_slot_order);
+  RUN_TEST(test_patching_a_field_replaces_it);
+  RUN_TEST(test_snapshots_being_sent_stay_alive);
+  RUN_TEST(test_publishing_reuses_buffers_nobody_holds);
+  UNITY_END();
+}
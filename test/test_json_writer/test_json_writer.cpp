@@ -0,0 +1,174 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include <JsonWriter.h>
+#include <WebSocketMessages.h>
+
+#if __has_include(<ArduinoJson.h>)
+#include <ArduinoJson.h>
+#define HAVE_ARDUINOJSON 1
+#endif
+
+void test_commas_go_between_values() {
+  JsonWriter writer;
+  writer.beginObject();
+  writer.key("a");
+  writer.value(1);
+  writer.key("b");
+  writer.beginArray();
+  writer.value(true);
+  writer.value(nullptr);
+  writer.beginObject();
+  writer.endObject();
+  writer.endArray();
+  writer.key("c");
+  writer.value("x");
+  writer.endObject();
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1,\"b\":[true,null,{}],\"c\":\"x\"}", writer.str().c_str());
+}
+
+void test_numbers() {
+  JsonWriter writer;
+  writer.beginArray();
+  writer.value(-3);
+  writer.value(4000000000ul);
+  writer.value(21.5f);
+  writer.value(0.1f);
+  writer.value(1.0f / 0.0f);
+  writer.value(2.25);
+  writer.endArray();
+  TEST_ASSERT_EQUAL_STRING("[-3,4000000000,21.5,0.1,null,2.25]", writer.str().c_str());
+}
+
+void test_strings_get_escaped() {
+  JsonWriter writer;
+  writer.value("say \"hi\"\n\\\x01");
+  TEST_ASSERT_EQUAL_STRING("\"say \\\"hi\\\"\\n\\\\\\u0001\"", writer.str().c_str());
+}
+
+void test_clearing_keeps_the_memory() {
+  JsonWriter writer;
+  writer.beginArray();
+  writer.value("a fairly long string so that the buffer has to grow past the small string size");
+  writer.endArray();
+  const char* before = writer.data();
+  writer.clear();
+  writer.beginArray();
+  writer.value(1);
+  writer.endArray();
+  TEST_ASSERT_EQUAL_STRING("[1]", writer.str().c_str());
+  TEST_ASSERT_TRUE(before == writer.data());
+}
+
+void test_state_updated_message() {
+  std::vector<const char*> keys = { "temp_unit", "shelf_temp", "fan" };
+  std::vector<std::string> valuesJson = { "\"celsius\"", "21.5", "{\"setpoint\":30,\"hysteresis\":1}" };
+  JsonWriter writer;
+  writeStateUpdatedJson(writer, keys, valuesJson, { false, true, true });
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"type\":\"stateUpdated\",\"data\":{\"shelf_temp\":21.5,\"fan\":{\"setpoint\":30,\"hysteresis\":1}}}",
+    writer.str().c_str()
+  );
+  // The writer gets reused for the next message.
+  writeStateUpdatedJson(writer, keys, valuesJson, { true, false, false });
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"stateUpdated\",\"data\":{\"temp_unit\":\"celsius\"}}", writer.str().c_str());
+}
+
+void test_field_ids_message() {
+  JsonWriter writer;
+  writeFieldIdsJson(writer, { "temp_unit", "shelf_temp" });
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"fieldIds\",\"data\":[\"temp_unit\",\"shelf_temp\"]}", writer.str().c_str());
+}
+
+// Not a pass/fail test; it prints how long a typical frame takes to turn into a message.
+// With ArduinoJson available (pio test -e dev_machine), it compares against the old way,
+// which copied every value into a document, copied that into a message document,
+// then walked it twice: once to measure and once to serialise.
+void test_benchmark_state_updated_message() {
+  const int frames = 20000;
+  const char* keys[] = {
+    "shelf_temp", "shelf_hum", "shelf_light", "ground_temp", "ceiling_temp", "yuzu_temp",
+    "fan_status", "heater_status", "mat_1_temp", "mat_2_temp", "free_heap", "loop_duration_p99"
+  };
+  const size_t keyCount = sizeof(keys) / sizeof(keys[0]);
+  std::vector<char> sent;
+
+#ifdef HAVE_ARDUINOJSON
+  std::vector<FrameUpdate<JsonDocument>> updates;
+  for (size_t i = 0; i < keyCount; i ++) {
+    JsonDocument value;
+    if (i % 3 == 0) {
+      value = 20.0f + i * 0.37f;
+    } else if (i % 3 == 1) {
+      value = i % 2 == 0;
+    } else {
+      value["setpoint"] = 25.0f + i;
+      value["hysteresis"] = 1.5f;
+    }
+    updates.push_back({ keys[i], i, 0, std::nullopt, value });
+  }
+  ChangeFrame<JsonDocument> frame(updates.data(), updates.size());
+
+  auto oldStart = std::chrono::steady_clock::now();
+  for (int n = 0; n < frames; n ++) {
+    JsonDocument data;
+    for (const FrameUpdate<JsonDocument>& update : frame) {
+      data[update.key] = update.value;
+    }
+    JsonDocument message;
+    message["type"] = "stateUpdated";
+    message["data"] = data;
+    size_t len = measureJson(message);
+    sent.resize(len + 1);
+    serializeJson(message, sent.data(), len + 1);
+  }
+  auto oldTime = std::chrono::steady_clock::now() - oldStart;
+#endif
+
+  JsonWriter writer(1024);
+  std::vector<const char*> keysBySlot(keys, keys + keyCount);
+  std::vector<bool> slots(keyCount, true);
+  std::vector<std::string> valuesJson(keyCount);
+#ifndef HAVE_ARDUINOJSON
+  // Without ArduinoJson, the values come already serialised and only the message gets timed.
+  for (size_t i = 0; i < keyCount; i ++) {
+    valuesJson[i] = std::to_string(20.0f + i * 0.37f);
+  }
+#endif
+  auto newStart = std::chrono::steady_clock::now();
+  for (int n = 0; n < frames; n ++) {
+#ifdef HAVE_ARDUINOJSON
+    for (const FrameUpdate<JsonDocument>& update : frame) {
+      valuesJson[update.slot].clear();
+      serializeJson(update.value, valuesJson[update.slot]);
+    }
+#endif
+    writeStateUpdatedJson(writer, keysBySlot, valuesJson, slots);
+    sent.resize(writer.size());
+    memcpy(sent.data(), writer.data(), writer.size());
+  }
+  auto newTime = std::chrono::steady_clock::now() - newStart;
+
+  using std::chrono::nanoseconds;
+  printf("state message, %zu fields: streaming writer %lld ns/frame\n", keyCount, (long long)(std::chrono::duration_cast<nanoseconds>(newTime).count() / frames));
+#ifdef HAVE_ARDUINOJSON
+  printf("state message, %zu fields: JsonDocument + measureJson %lld ns/frame\n", keyCount, (long long)(std::chrono::duration_cast<nanoseconds>(oldTime).count() / frames));
+#endif
+  TEST_ASSERT_TRUE(writer.size() > 0);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_commas_go_between_values);
+  RUN_TEST(test_numbers);
+  RUN_TEST(test_strings_get_escaped);
+  RUN_TEST(test_clearing_keeps_the_memory);
+  RUN_TEST(test_state_updated_message);
+  RUN_TEST(test_field_ids_message);
+  RUN_TEST(test_benchmark_state_updated_message);
+  UNITY_END();
+}
@@ -0,0 +1,146 @@
+#include <functional>
+
+#include <unity.h>
+
+#include <Histogram.h>
+#include <LoopMonitor.h>
+#include <Runnable.h>
+#include <RunnableCost.h>
+#include <Timer.h>
+
+class SlowRunnable : public Runnable {
+  public:
+    unsigned long howSlow;
+
+    SlowRunnable(unsigned long howSlow) : howSlow(howSlow) { }
+
+    virtual void run() {
+      Timekeeper::tickMicros(howSlow);
+    }
+};
+
+void test_histogram_percentiles() {
+  LogBucketHistogram histogram;
+  TEST_ASSERT_EQUAL(0, histogram.percentile(0.5f));
+  for (uint32_t i = 1; i <= 100; i ++) {
+    histogram.record(i);
+  }
+  TEST_ASSERT_EQUAL(100, histogram.count());
+  TEST_ASSERT_EQUAL(1, histogram.min());
+  TEST_ASSERT_EQUAL(100, histogram.max());
+  TEST_ASSERT_EQUAL(50, histogram.mean());
+  // Percentiles are approximate, but never under the real value and never more than 25% over.
+  uint32_t p50 = histogram.percentile(0.5f);
+  TEST_ASSERT_TRUE(p50 >= 50 && p50 <= 63);
+  uint32_t p99 = histogram.percentile(0.99f);
+  TEST_ASSERT_TRUE(p99 >= 99 && p99 <= 100);
+  TEST_ASSERT_EQUAL(100, histogram.percentile(1.0f));
+  histogram.reset();
+  TEST_ASSERT_EQUAL(0, histogram.count());
+}
+
+void test_histogram_handles_huge_values() {
+  LogBucketHistogram histogram;
+  histogram.record(0);
+  histogram.record(UINT32_MAX);
+  TEST_ASSERT_EQUAL(0, histogram.percentile(0.5f));
+  TEST_ASSERT_EQUAL(UINT32_MAX, histogram.percentile(1.0f));
+}
+
+void test_tick_observers_are_nested() {
+  std::vector<int> calls;
+  class RecordingObserver : public TickObserver {
+    public:
+      int id;
+      std::vector<int>* calls;
+      RecordingObserver(int id, std::vector<int>* calls) : id(id), calls(calls) { }
+      virtual void beforeTick() { calls->push_back(id); }
+      virtual void afterTick() { calls->push_back(-id); }
+  };
+  RecordingObserver outer(1, &calls);
+  RecordingObserver inner(2, &calls);
+  Runner::registerTickObserver(&outer);
+  Runner::registerTickObserver(&inner);
+  Runner::run();
+  TEST_ASSERT_EQUAL(4, calls.size());
+  TEST_ASSERT_EQUAL(1, calls[0]);
+  TEST_ASSERT_EQUAL(2, calls[1]);
+  TEST_ASSERT_EQUAL(-2, calls[2]);
+  TEST_ASSERT_EQUAL(-1, calls[3]);
+}
+
+void test_loop_monitor_measures_durations_intervals_and_jitter() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  LoopMonitor monitor;
+  SlowRunnable slow(100);
+  for (int i = 0; i < 10; i ++) {
+    monitor.beforeTick();
+    slow.run();
+    monitor.afterTick();
+    // Something outside the loop, like WiFi, takes a bit of time, and it takes longer every time.
+    Timekeeper::tickMicros(i * 10);
+  }
+  TEST_ASSERT_EQUAL(100, monitor.readChannel(LoopStat::tickDurationMax));
+  TEST_ASSERT_EQUAL(100, monitor.readChannel(LoopStat::tickDurationP50));
+  // The intervals go 100, 110, 120... 180.
+  TEST_ASSERT_EQUAL(9, monitor.getIntervals().count());
+  TEST_ASSERT_EQUAL(100, monitor.getIntervals().min());
+  TEST_ASSERT_EQUAL(180, monitor.readChannel(LoopStat::tickIntervalMax));
+  // So the jitter is always 10.
+  TEST_ASSERT_EQUAL(8, monitor.getJitters().count());
+  TEST_ASSERT_EQUAL(10, monitor.readChannel(LoopStat::tickJitterP99));
+  TEST_ASSERT_EQUAL(10, monitor.readChannel(LoopStat::tickJitterMax));
+}
+
+void test_loop_monitor_watchdog_emits_on_overrun() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  LoopMonitor monitor(150);
+  SlowRunnable slow(100);
+  int overruns = 0;
+  unsigned long overrunDuration = 0;
+  monitor.registerSubscriber([&overruns, &overrunDuration](Event<LoopOverrun> e) {
+    overruns ++;
+    overrunDuration = e.value.tickDuration;
+  });
+  monitor.beforeTick();
+  slow.run();
+  monitor.afterTick();
+  TEST_ASSERT_EQUAL(0, overruns);
+  slow.howSlow = 200;
+  monitor.beforeTick();
+  slow.run();
+  monitor.afterTick();
+  TEST_ASSERT_EQUAL(1, overruns);
+  TEST_ASSERT_EQUAL(200, overrunDuration);
+  TEST_ASSERT_EQUAL(1, monitor.getOverrunCount());
+  monitor.setBudget(std::nullopt);
+  monitor.beforeTick();
+  slow.run();
+  monitor.afterTick();
+  TEST_ASSERT_EQUAL(1, overruns);
+}
+
+void test_costed_runnable_says_who_the_time_went_to() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  SlowRunnable slow(100);
+  CostedRunnable costed("slow", &slow);
+  costed.run();
+  slow.howSlow = 300;
+  costed.run();
+  std::shared_ptr<RunnableCost> cost = costed.getCost();
+  TEST_ASSERT_EQUAL(2, cost->runs);
+  TEST_ASSERT_EQUAL(400, cost->totalMicros);
+  TEST_ASSERT_EQUAL(300, cost->maxMicros);
+  TEST_ASSERT_TRUE(RunnableCost::all().back() == cost);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_histogram_percentiles);
+  RUN_TEST(test_histogram_handles_huge_values);
+  RUN_TEST(test_tick_observers_are_nested);
+  RUN_TEST(test_loop_monitor_measures_durations_intervals_and_jitter);
+  RUN_TEST(test_loop_monitor_watchdog_emits_on_overrun);
+  RUN_TEST(test_costed_runnable_says_who_the_time_went_to);
+  UNITY_END();
+}
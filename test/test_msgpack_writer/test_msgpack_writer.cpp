@@ -0,0 +1,98 @@
+#include <vector>
+
+#include <unity.h>
+
+#include <MsgPackWriter.h>
+
+std::vector<uint8_t> written(MsgPackWriter& writer, uint8_t* buffer) {
+  return std::vector<uint8_t>(buffer, buffer + writer.size());
+}
+
+void assertBytes(std::vector<uint8_t> expected, std::vector<uint8_t> actual) {
+  TEST_ASSERT_EQUAL(expected.size(), actual.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), actual.data(), expected.size());
+}
+
+void test_integers_take_the_fewest_bytes() {
+  uint8_t buffer[64];
+  MsgPackWriter writer(buffer, sizeof(buffer));
+  writer.writeUint(5);
+  writer.writeUint(200);
+  writer.writeUint(1000);
+  writer.writeUint(70000);
+  writer.writeInt(-3);
+  writer.writeInt(-100);
+  writer.writeInt(-1000);
+  writer.writeInt(42);
+  assertBytes({
+    0x05,
+    0xcc, 0xc8,
+    0xcd, 0x03, 0xe8,
+    0xce, 0x00, 0x01, 0x11, 0x70,
+    0xfd,
+    0xd0, 0x9c,
+    0xd1, 0xfc, 0x18,
+    0x2a
+  }, written(writer, buffer));
+}
+
+void test_floats_are_32_bits() {
+  uint8_t buffer[8];
+  MsgPackWriter writer(buffer, sizeof(buffer));
+  writer.writeFloat(1.5f);
+  assertBytes({ 0xca, 0x3f, 0xc0, 0x00, 0x00 }, written(writer, buffer));
+}
+
+void test_strings_and_containers() {
+  uint8_t buffer[64];
+  MsgPackWriter writer(buffer, sizeof(buffer));
+  writer.writeArrayHeader(2);
+  writer.writeUint(0);
+  writer.writeMapHeader(2);
+  writer.writeUint(3);
+  writer.writeString("on");
+  writer.writeUint(4);
+  writer.writeNil();
+  writer.writeBool(true);
+  assertBytes({ 0x92, 0x00, 0x82, 0x03, 0xa2, 'o', 'n', 0x04, 0xc0, 0xc3 }, written(writer, buffer));
+}
+
+void test_long_strings_get_a_length_byte() {
+  std::string key(40, 'k');
+  uint8_t buffer[64];
+  MsgPackWriter writer(buffer, sizeof(buffer));
+  writer.writeString(key);
+  TEST_ASSERT_EQUAL(42, writer.size());
+  TEST_ASSERT_EQUAL_HEX8(0xd9, buffer[0]);
+  TEST_ASSERT_EQUAL(40, buffer[1]);
+}
+
+void test_measuring_without_a_buffer() {
+  MsgPackWriter measurer;
+  measurer.writeMapHeader(1);
+  measurer.writeUint(300);
+  measurer.writeFloat(21.5f);
+  TEST_ASSERT_EQUAL(9, measurer.size());
+  TEST_ASSERT_FALSE(measurer.overflowed());
+}
+
+void test_overflow_stops_writing() {
+  uint8_t buffer[4] = { 0, 0, 0, 0xee };
+  MsgPackWriter writer(buffer, 3);
+  writer.writeFloat(1.0f);
+  TEST_ASSERT_TRUE(writer.overflowed());
+  TEST_ASSERT_EQUAL(5, writer.size());
+  // It didn't write past the end.
+  TEST_ASSERT_EQUAL_HEX8(0xee, buffer[3]);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_integers_take_the_fewest_bytes);
+  RUN_TEST(test_floats_are_32_bits);
+  RUN_TEST(test_strings_and_containers);
+  RUN_TEST(test_long_strings_get_a_length_byte);
+  RUN_TEST(test_measuring_without_a_buffer);
+  RUN_TEST(test_overflow_stops_writing);
+  UNITY_END();
+}
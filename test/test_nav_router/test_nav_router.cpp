@@ -0,0 +1,194 @@
+#include <vector>
+
+#include <unity.h>
+
+#include <Timer.h>
+#include <event_stream/EventStream.h>
+#include <event_stream/FancyPushbutton.h>
+#include <ui/NavButtonCluster.h>
+#include <ui/NavRouter.h>
+
+// Captures the buttons it cares about, and lets everything else bubble.
+class FakeWidget {
+  public:
+    uint8_t captures;
+    std::vector<NavButton> seen;
+
+    FakeWidget(uint8_t captures) : captures(captures) { }
+
+    bool handleNavEvent(const Event<NavButtonClusterEvent>& event) {
+      seen.push_back(event.value.button);
+      return !event.value.isPressed(captures);
+    }
+};
+
+// Only ever wants to hear about OK.
+class OkOnlyWidget : public FakeWidget {
+  public:
+    static constexpr uint8_t navButtons = navbutton_ok;
+
+    OkOnlyWidget() : FakeWidget(navbutton_ok) { }
+};
+
+Event<NavButtonClusterEvent> press(NavButton button) {
+  return Event<NavButtonClusterEvent>(Timekeeper::nowMillis(), NavButtonClusterEvent(button, button_press));
+}
+
+void test_is_pressed_checks_the_button() {
+  NavButtonClusterEvent event(navbutton_left, button_press);
+  TEST_ASSERT_TRUE(event.isPressed(navbutton_left));
+  TEST_ASSERT_TRUE(event.isPressed(navbutton_down | navbutton_left));
+  TEST_ASSERT_FALSE(event.isPressed(navbutton_up | navbutton_right));
+  NavButtonClusterEvent down(navbutton_left, button_down);
+  TEST_ASSERT_FALSE(down.isPressed(navbutton_left));
+}
+
+void test_chain_stops_at_the_first_handler_that_captures() {
+  FakeWidget spinBox(navbutton_up | navbutton_down);
+  FakeWidget menu(navbutton_up | navbutton_down | navbutton_back);
+  NavChain chain(spinBox, menu);
+  TEST_ASSERT_FALSE(chain.handleNavEvent(press(navbutton_up)));
+  TEST_ASSERT_EQUAL(1, spinBox.seen.size());
+  TEST_ASSERT_EQUAL(0, menu.seen.size());
+  TEST_ASSERT_FALSE(chain.handleNavEvent(press(navbutton_back)));
+  TEST_ASSERT_EQUAL(2, spinBox.seen.size());
+  TEST_ASSERT_EQUAL(1, menu.seen.size());
+  // Nobody wants this one, so it bubbles out the top.
+  TEST_ASSERT_TRUE(chain.handleNavEvent(press(navbutton_ok)));
+}
+
+void test_handlers_only_see_the_buttons_they_ask_for() {
+  OkOnlyWidget checkBox;
+  FakeWidget catchAll(0);
+  NavChain chain(checkBox, catchAll);
+  TEST_ASSERT_EQUAL(navbutton_all, chain.navButtons);
+  chain.handleNavEvent(press(navbutton_up));
+  TEST_ASSERT_EQUAL(0, checkBox.seen.size());
+  TEST_ASSERT_EQUAL(1, catchAll.seen.size());
+  chain.handleNavEvent(press(navbutton_ok));
+  TEST_ASSERT_EQUAL(1, checkBox.seen.size());
+  TEST_ASSERT_EQUAL(1, catchAll.seen.size());
+}
+
+void test_focus_only_reaches_the_focused_child() {
+  FakeWidget first(navbutton_all);
+  OkOnlyWidget second;
+  FakeWidget third(navbutton_all);
+  NavFocus menuItems(first, second, third);
+  TEST_ASSERT_EQUAL(3, menuItems.size());
+  menuItems.handleNavEvent(press(navbutton_ok));
+  TEST_ASSERT_EQUAL(1, first.seen.size());
+  menuItems.focus(2);
+  menuItems.handleNavEvent(press(navbutton_ok));
+  TEST_ASSERT_EQUAL(1, first.seen.size());
+  TEST_ASSERT_EQUAL(0, second.seen.size());
+  TEST_ASSERT_EQUAL(1, third.seen.size());
+  menuItems.focus(7);
+  TEST_ASSERT_EQUAL(2, menuItems.getFocus());
+  // The second one doesn't want up, so it bubbles.
+  menuItems.focus(1);
+  TEST_ASSERT_TRUE(menuItems.handleNavEvent(press(navbutton_up)));
+  TEST_ASSERT_EQUAL(0, second.seen.size());
+}
+
+void test_long_press() {
+  Timekeeper::setNowSim(0);
+  DumbEventStream<bool> pin;
+  FancyPushbutton button(&pin, 200, 400, 200);
+  std::vector<Event<FancyPushbuttonEvent>> events;
+  button.registerSubscriber([&events](const Event<FancyPushbuttonEvent>& e) { events.push_back(e); });
+
+  pin.emit(true);
+  Timekeeper::tick(300);
+  button.run();
+  TEST_ASSERT_EQUAL(2, events.size());
+  TEST_ASSERT_EQUAL(button_holdStart, events[1].value);
+  // Stamped with when the short press time ran out, not when run() noticed.
+  TEST_ASSERT_EQUAL(200, events[1].timestamp);
+  pin.emit(false);
+  TEST_ASSERT_EQUAL(6, events.size());
+  TEST_ASSERT_EQUAL(button_press, events[2].value);
+  TEST_ASSERT_EQUAL(button_longPress, events[3].value);
+  TEST_ASSERT_EQUAL(button_holdDone, events[4].value);
+  TEST_ASSERT_EQUAL(button_up, events[5].value);
+}
+
+void test_hold_past_long_press_repeats() {
+  Timekeeper::setNowSim(0);
+  DumbEventStream<bool> pin;
+  FancyPushbutton button(&pin, 200, 400, 200);
+  std::vector<Event<FancyPushbuttonEvent>> events;
+  button.registerSubscriber([&events](const Event<FancyPushbuttonEvent>& e) { events.push_back(e); });
+
+  pin.emit(true);
+  // Past the long press time before run() gets a look in, so it catches up all at once.
+  Timekeeper::tick(450);
+  button.run();
+  TEST_ASSERT_EQUAL(4, events.size());
+  TEST_ASSERT_EQUAL(button_down, events[0].value);
+  TEST_ASSERT_EQUAL(button_holdStart, events[1].value);
+  TEST_ASSERT_EQUAL(button_press, events[2].value);
+  TEST_ASSERT_EQUAL(button_holdRepeatPress, events[3].value);
+  TEST_ASSERT_EQUAL(400, events[3].timestamp);
+  // Nothing more until the repeat interval's up.
+  Timekeeper::tick(100);
+  button.run();
+  TEST_ASSERT_EQUAL(4, events.size());
+  Timekeeper::tick(100);
+  button.run();
+  TEST_ASSERT_EQUAL(6, events.size());
+  TEST_ASSERT_EQUAL(button_press, events[4].value);
+  TEST_ASSERT_EQUAL(button_holdRepeatPress, events[5].value);
+  TEST_ASSERT_EQUAL(600, events[5].timestamp);
+
+  Timekeeper::tick(50);
+  pin.emit(false);
+  // A hold that's been repeating doesn't count as a long press as well.
+  TEST_ASSERT_EQUAL(8, events.size());
+  TEST_ASSERT_EQUAL(button_holdDone, events[6].value);
+  TEST_ASSERT_EQUAL(button_up, events[7].value);
+}
+
+void test_buttons_route_through_the_cluster() {
+  Timekeeper::setNowSim(0);
+  std::vector<DumbEventStream<bool>> pins(6);
+  std::vector<FancyPushbutton> buttons;
+  buttons.reserve(6);
+  for (auto& pin : pins) {
+    buttons.emplace_back(&pin);
+  }
+  NavButtonCluster cluster(&buttons[0], &buttons[1], &buttons[2], &buttons[3], &buttons[4], &buttons[5]);
+  FakeWidget spinBox(navbutton_up | navbutton_down);
+  FakeWidget screen(navbutton_all);
+  NavChain root(spinBox, screen);
+  routeNavEvents(&cluster, &root);
+
+  // Press and release the down button.
+  pins[1].emit(true);
+  Timekeeper::tick(50);
+  pins[1].emit(false);
+  // It emits down, press, shortPress and up; the spin box only captures the press.
+  TEST_ASSERT_EQUAL(4, spinBox.seen.size());
+  TEST_ASSERT_EQUAL(navbutton_down, spinBox.seen[0]);
+  TEST_ASSERT_EQUAL(3, screen.seen.size());
+
+  // And the back button gets through to the screen.
+  pins[5].emit(true);
+  Timekeeper::tick(50);
+  pins[5].emit(false);
+  TEST_ASSERT_EQUAL(7, screen.seen.size());
+  TEST_ASSERT_EQUAL(navbutton_back, screen.seen.back());
+}
+
+int main(int argc, char **argv) {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  UNITY_BEGIN();
+  RUN_TEST(test_is_pressed_checks_the_button);
+  RUN_TEST(test_chain_stops_at_the_first_handler_that_captures);
+  RUN_TEST(test_handlers_only_see_the_buttons_they_ask_for);
+  RUN_TEST(test_focus_only_reaches_the_focused_child);
+  RUN_TEST(test_long_press);
+  RUN_TEST(test_hold_past_long_press_repeats);
+  RUN_TEST(test_buttons_route_through_the_cluster);
+  UNITY_END();
+}
@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include <unity.h>
+
+#include <PrometheusWriter.h>
+
+struct StringSink {
+  std::string text;
+
+  size_t write(const uint8_t* data, size_t length) {
+    text.append((const char*)data, length);
+    return length;
+  }
+};
+
+void test_family_and_plain_samples() {
+  StringSink sink;
+  PrometheusWriter<StringSink> writer(&sink);
+  writer.family("greenhouse_free_heap_bytes", "gauge", "Free heap.");
+  writer.sample("greenhouse_free_heap_bytes", (size_t)143212);
+  writer.sample("greenhouse_temperature", -3);
+  writer.sample("greenhouse_big", (uint64_t)18446744073709551615ull);
+  writer.sample("greenhouse_zero", 0u);
+  TEST_ASSERT_EQUAL_STRING(
+    "# HELP greenhouse_free_heap_bytes Free heap.\n"
+    "# TYPE greenhouse_free_heap_bytes gauge\n"
+    "greenhouse_free_heap_bytes 143212\n"
+    "greenhouse_temperature -3\n"
+    "greenhouse_big 18446744073709551615\n"
+    "greenhouse_zero 0\n",
+    sink.text.c_str()
+  );
+}
+
+void test_floats() {
+  StringSink sink;
+  PrometheusWriter<StringSink> writer(&sink);
+  writer.sample("a", 0.000125);
+  writer.sample("b", 21.5f);
+  writer.sample("c", NAN);
+  writer.sample("d", -INFINITY);
+  TEST_ASSERT_EQUAL_STRING("a 0.000125\nb 21.5\nc NaN\nd -Inf\n", sink.text.c_str());
+}
+
+void test_labels_get_escaped() {
+  StringSink sink;
+  PrometheusWriter<StringSink> writer(&sink);
+  writer.sample("greenhouse_websocket_client_outbox_depth", { { "client", "3" }, { "encoding", "json" } }, 2);
+  writer.sample("greenhouse_odd", { { "name", "a \"quoted\\path\"\nnext" } }, 1);
+  TEST_ASSERT_EQUAL_STRING(
+    "greenhouse_websocket_client_outbox_depth{client=\"3\",encoding=\"json\"} 2\n"
+    "greenhouse_odd{name=\"a \\\"quoted\\\\path\\\"\\nnext\"} 1\n",
+    sink.text.c_str()
+  );
+}
+
+// A whole /metrics page's worth of samples, to see what it costs the web server's task.
+void test_benchmark() {
+  StringSink sink;
+  sink.text.reserve(16384);
+  PrometheusWriter<StringSink> writer(&sink);
+  const int pages = 1000;
+  auto start = std::chrono::steady_clock::now();
+  for (int page = 0; page < pages; page ++) {
+    sink.text.clear();
+    writer.family("greenhouse_runnable_runs_total", "counter", "How many times each runnable has run.");
+    for (int i = 0; i < 40; i ++) {
+      writer.sample("greenhouse_runnable_runs_total", { { "runnable", "mat_1_control" } }, (uint32_t)(page * 40 + i));
+      writer.sample("greenhouse_runnable_seconds_total", { { "runnable", "mat_1_control" } }, (page * 40 + i) / 1e6);
+    }
+  }
+  double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  printf("%d samples, %zu bytes: %.1f us per page\n", 80, sink.text.size(), micros / pages);
+  TEST_ASSERT_TRUE(sink.text.size() > 0);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_family_and_plain_samples);
+  RUN_TEST(test_floats);
+  RUN_TEST(test_labels_get_escaped);
+  RUN_TEST(test_benchmark);
+  UNITY_END();
+}
@@ -0,0 +1,156 @@
+#include <cmath>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include <HistoryExport.h>
+#include <SampleHistory.h>
+#include <Timer.h>
+
+// Reads the whole export a few bytes at a time, the way a chunked response would, but in smaller bites.
+std::string readAll(HistoryExport& historyExport, size_t chunkSize) {
+  std::string text;
+  uint8_t buffer[64];
+  size_t length;
+  while ((length = historyExport.read(buffer, chunkSize)) > 0) {
+    text.append((const char*)buffer, length);
+  }
+  return text;
+}
+
+// Three fields, recorded once a minute; the heater's on for every other row,
+// and the temperature's missing for the second.
+void recordMinutes(SampleHistory& history, float* temp, bool* heater, int minutes) {
+  for (int minute = 0; minute < minutes; minute ++) {
+    *temp = minute == 1 ? NAN : 20.0f + minute;
+    *heater = minute % 2;
+    history.record(minute * 60000);
+  }
+}
+
+void test_sampling_on_an_interval() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  Timekeeper::setNowSim(0);
+  EventStream<std::optional<float>> stream;
+  SampleHistory history(4, 1000);
+  history.track("temp", &stream);
+  history.run();
+  Timekeeper::tick(500);
+  history.run();
+  TEST_ASSERT_EQUAL(1, history.getEndRow());
+  Timekeeper::tick(500);
+  history.run();
+  TEST_ASSERT_EQUAL(2, history.getEndRow());
+  float value;
+  unsigned long timestamp;
+  TEST_ASSERT_TRUE(history.readRow(1, timestamp, &value) == SampleHistoryRead::read);
+  TEST_ASSERT_EQUAL(1000, timestamp);
+  // Nothing's been emitted yet.
+  TEST_ASSERT_TRUE(std::isnan(value));
+}
+
+void test_oldest_rows_get_replaced() {
+  float temp;
+  bool heater;
+  SampleHistory history(3, 60000);
+  history.track("temp", [&temp]() { return temp; });
+  history.track("heater", [&heater]() { return (float)heater; });
+  recordMinutes(history, &temp, &heater, 5);
+  TEST_ASSERT_EQUAL(2, history.getFirstRow());
+  TEST_ASSERT_EQUAL(5, history.getEndRow());
+  float values[2];
+  unsigned long timestamp;
+  TEST_ASSERT_TRUE(history.readRow(1, timestamp, values) == SampleHistoryRead::evicted);
+  TEST_ASSERT_TRUE(history.readRow(5, timestamp, values) == SampleHistoryRead::notRecorded);
+  TEST_ASSERT_TRUE(history.readRow(4, timestamp, values) == SampleHistoryRead::read);
+  TEST_ASSERT_EQUAL(240000, timestamp);
+  TEST_ASSERT_EQUAL_FLOAT(24.0f, values[0]);
+}
+
+void test_csv_in_small_chunks() {
+  float temp;
+  bool heater;
+  SampleHistory history(10, 60000);
+  history.track("temp", [&temp]() { return temp; });
+  history.track("heater", [&heater]() { return (float)heater; });
+  recordMinutes(history, &temp, &heater, 3);
+  HistoryExport historyExport(&history, HistoryFormat::csv, HistoryExport::fieldsFromList(history.getKeys(), nullptr));
+  TEST_ASSERT_EQUAL_STRING(
+    "timestamp,temp,heater\n"
+    "0,20,0\n"
+    "60000,,1\n"
+    "120000,22,0\n",
+    readAll(historyExport, 5).c_str()
+  );
+}
+
+void test_ndjson_with_fields_and_time_range() {
+  float temp;
+  bool heater;
+  SampleHistory history(10, 60000);
+  history.track("temp", [&temp]() { return temp; });
+  history.track("heater", [&heater]() { return (float)heater; });
+  recordMinutes(history, &temp, &heater, 4);
+  std::vector<size_t> fields = HistoryExport::fieldsFromList(history.getKeys(), "temp,no_such_field");
+  TEST_ASSERT_EQUAL(1, fields.size());
+  TEST_ASSERT_EQUAL(0, HistoryExport::fieldsFromList(history.getKeys(), "no_such_field").size());
+  TEST_ASSERT_EQUAL(2, HistoryExport::fieldsFromList(history.getKeys(), "").size());
+  HistoryExport historyExport(&history, HistoryFormat::ndjson, fields, 60000, 120000);
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"timestamp\":60000,\"temp\":null}\n"
+    "{\"timestamp\":120000,\"temp\":22}\n",
+    readAll(historyExport, 64).c_str()
+  );
+}
+
+void test_downsampling_averages_each_bucket() {
+  float temp;
+  bool heater;
+  SampleHistory history(10, 60000);
+  history.track("temp", [&temp]() { return temp; });
+  history.track("heater", [&heater]() { return (float)heater; });
+  recordMinutes(history, &temp, &heater, 5);
+  // Two-minute buckets: minutes 0 and 1, 2 and 3, then 4 on its own.
+  HistoryExport historyExport(&history, HistoryFormat::csv, HistoryExport::fieldsFromList(history.getKeys(), ""), 0, ULONG_MAX, 120000);
+  TEST_ASSERT_EQUAL_STRING(
+    "timestamp,temp,heater\n"
+    // The missing temperature gets left out of the average, rather than counting as 0.
+    "0,20,0.5\n"
+    "120000,22.5,0.5\n"
+    "240000,24,0\n",
+    readAll(historyExport, 7).c_str()
+  );
+}
+
+void test_rows_overwritten_during_an_export_get_skipped() {
+  float temp;
+  bool heater;
+  SampleHistory history(3, 60000);
+  history.track("temp", [&temp]() { return temp; });
+  history.track("heater", [&heater]() { return (float)heater; });
+  recordMinutes(history, &temp, &heater, 3);
+  HistoryExport historyExport(&history, HistoryFormat::csv, HistoryExport::fieldsFromList(history.getKeys(), "temp"));
+  uint8_t buffer[64];
+  // Just the header and the first row.
+  size_t length = historyExport.read(buffer, 17);
+  TEST_ASSERT_EQUAL_STRING("timestamp,temp\n0,", std::string((const char*)buffer, length).c_str());
+  // Two more rows push out the ones the export hasn't got to yet.
+  temp = 30.0f;
+  history.record(180000);
+  history.record(240000);
+  // Rows recorded since the export started are left out, too.
+  TEST_ASSERT_EQUAL_STRING("20\n120000,22\n", readAll(historyExport, 64).c_str());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sampling_on_an_interval);
+  RUN_TEST(test_oldest_rows_get_replaced);
+  RUN_TEST(test_csv_in_small_chunks);
+  RUN_TEST(test_ndjson_with_fields_and_time_range);
+  RUN_TEST(test_downsampling_averages_each_bucket);
+  RUN_TEST(test_rows_overwritten_during_an_export_get_skipped);
+  UNITY_END();
+}
@@ -0,0 +1,100 @@
+#include <unity.h>
+
+#include <SampleTrace.h>
+#include <Timer.h>
+#include <event_stream/EventStream.h>
+#include <event_stream/EventStreamProcesses.h>
+#include <input/Input.h>
+#include <input/TranslatingProcesses.h>
+#include <input/CombiningProcesses.h>
+
+// Stands in for a sensor that took its sample at a known time.
+class StampedInput : public Input<float> {
+  public:
+    float value;
+    unsigned long sampledAt;
+
+    StampedInput(float value, unsigned long sampledAt) : value(value), sampledAt(sampledAt) { }
+
+    virtual float read() {
+      SampleTrace::stamp(sampledAt);
+      return value;
+    }
+};
+
+void test_trace_keeps_oldest_origin() {
+  TEST_ASSERT_FALSE(SampleTrace::currentOrigin().has_value());
+  SampleTrace trace;
+  TEST_ASSERT_FALSE(trace.getOrigin().has_value());
+  SampleTrace::stamp(500);
+  SampleTrace::stamp(300);
+  SampleTrace::stamp(700);
+  TEST_ASSERT_EQUAL(300, trace.getOrigin().value());
+}
+
+void test_nested_traces_hand_origin_outward() {
+  SampleTrace outer;
+  SampleTrace::stamp(500);
+  {
+    SampleTrace inner;
+    SampleTrace::stamp(200);
+    TEST_ASSERT_EQUAL(200, inner.getOrigin().value());
+    TEST_ASSERT_EQUAL(500, outer.getOrigin().value());
+  }
+  TEST_ASSERT_EQUAL(200, outer.getOrigin().value());
+}
+
+void test_stamping_without_trace_does_nothing() {
+  SampleTrace::stamp(100);
+  TEST_ASSERT_FALSE(SampleTrace::currentOrigin().has_value());
+}
+
+void test_origin_survives_translating_and_merging() {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  Timekeeper::setNowSim(10);
+  StampedInput fresh(20.0f, 9000);
+  StampedInput stale(30.0f, 4000);
+  TranslatingProcess<float, float> doubled(&fresh, [](float v) { return v * 2; });
+  Merging2Process<float, float, float> sum(&doubled, &stale, [](float a, float b) { return a + b; });
+  SampleTrace trace;
+  TEST_ASSERT_EQUAL_FLOAT(70.0f, sum.read());
+  TEST_ASSERT_EQUAL(4000, trace.getOrigin().value());
+  TEST_ASSERT_EQUAL(6000, trace.getAge().value());
+}
+
+void test_origin_rides_along_on_events() {
+  StampedInput sensor(20.0f, 1234);
+  InputToEventStream<float> stream(&sensor);
+  EventStreamTranslator<float, int> rounded(&stream, [](float v) { return (int)v; });
+  std::optional<unsigned long> streamOrigin;
+  std::optional<unsigned long> roundedOrigin;
+  std::optional<unsigned long> originInSubscriber;
+  stream.registerSubscriber([&streamOrigin](Event<float> e) { streamOrigin = e.origin; });
+  rounded.registerSubscriber([&roundedOrigin, &originInSubscriber](Event<int> e) {
+    roundedOrigin = e.origin;
+    originInSubscriber = SampleTrace::currentOrigin();
+  });
+  stream.run();
+  TEST_ASSERT_EQUAL(1234, streamOrigin.value());
+  TEST_ASSERT_EQUAL(1234, roundedOrigin.value());
+  TEST_ASSERT_EQUAL(1234, originInSubscriber.value());
+}
+
+void test_untraced_events_have_no_origin() {
+  DumbEventStream<int> stream;
+  std::optional<unsigned long> origin = 1;
+  stream.registerSubscriber([&origin](Event<int> e) { origin = e.origin; });
+  stream.emit(1);
+  TEST_ASSERT_FALSE(origin.has_value());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_trace_keeps_oldest_origin);
+  RUN_TEST(test_nested_traces_hand_origin_outward);
+  RUN_TEST(test_stamping_without_trace_does_nothing);
+  RUN_TEST(test_origin_survives_translating_and_merging);
+  RUN_TEST(test_origin_rides_along_on_events);
+  RUN_TEST(test_untraced_events_have_no_origin);
+  UNITY_END();
+}
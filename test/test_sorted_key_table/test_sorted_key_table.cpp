@@ -0,0 +1,85 @@
+#include <unity.h>
+
+#include <Range.h>
+#include <SortedKeyTable.h>
+
+struct FakeState {
+  Range<float> alarm = Range<float>(0, 40);
+  int setCount = 0;
+};
+
+typedef void (*FakeSetter)(FakeState*, float);
+
+template <float Range<float>::*part>
+void setAlarmPart(FakeState* state, float value) {
+  state->alarm.*part = value;
+  state->setCount ++;
+}
+
+static constexpr auto fakeSetters = makeSortedKeyTable<FakeSetter>({
+  { "alarm_max", setAlarmPart<&Range<float>::max> },
+  { "alarm_min", setAlarmPart<&Range<float>::min> },
+  { "alarm", [](FakeState* state, float value) { state->alarm = Range<float>(value, value); state->setCount ++; } },
+});
+
+void test_rows_get_sorted() {
+  static constexpr auto table = makeSortedKeyTable<int>({ { "c", 3 }, { "a", 1 }, { "b", 2 } });
+  static_assert(table.begin()[0].key == "a", "sorted when it's compiled");
+  int expected = 1;
+  for (const KeyedRow<int>& row : table) {
+    TEST_ASSERT_EQUAL(expected, row.value);
+    expected ++;
+  }
+}
+
+void test_finds_every_key() {
+  static constexpr auto table = makeSortedKeyTable<int>({
+    { "temp_unit", 0 }, { "fan_control_setpoint", 1 }, { "fan_control_hysteresis", 2 },
+    { "mat_1_temp_calibration_low_raw", 3 }, { "mat_1_temp_calibration_low_reference", 4 }, { "alarm", 5 }
+  });
+  static_assert(*table.find("fan_control_hysteresis") == 2, "lookups work in a constexpr too");
+  for (const KeyedRow<int>& row : table) {
+    TEST_ASSERT_NOT_NULL(table.find(row.key));
+    TEST_ASSERT_EQUAL(row.value, *table.find(row.key));
+  }
+}
+
+void test_missing_keys_arent_found() {
+  // Including ones that are a prefix or an extension of a real key.
+  TEST_ASSERT_NULL(fakeSetters.find("alar"));
+  TEST_ASSERT_NULL(fakeSetters.find("alarm_maximum"));
+  TEST_ASSERT_NULL(fakeSetters.find(""));
+  TEST_ASSERT_NULL(fakeSetters.find("zzz"));
+}
+
+void test_setters_get_dispatched() {
+  FakeState state;
+  (*fakeSetters.find("alarm_min"))(&state, 5);
+  (*fakeSetters.find("alarm_max"))(&state, 35);
+  TEST_ASSERT_EQUAL_FLOAT(5, state.alarm.min);
+  TEST_ASSERT_EQUAL_FLOAT(35, state.alarm.max);
+  (*fakeSetters.find("alarm"))(&state, 20);
+  TEST_ASSERT_EQUAL_FLOAT(20, state.alarm.min);
+  TEST_ASSERT_EQUAL(3, state.setCount);
+}
+
+void test_duplicate_keys_throw() {
+  // In a constexpr this wouldn't compile; at runtime it throws.
+  bool threw = false;
+  try {
+    makeSortedKeyTable<int>({ { "a", 1 }, { "b", 2 }, { "a", 3 } });
+  } catch (std::invalid_argument& e) {
+    threw = true;
+  }
+  TEST_ASSERT_TRUE(threw);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rows_get_sorted);
+  RUN_TEST(test_finds_every_key);
+  RUN_TEST(test_missing_keys_arent_found);
+  RUN_TEST(test_setters_get_dispatched);
+  RUN_TEST(test_duplicate_keys_throw);
+  UNITY_END();
+}
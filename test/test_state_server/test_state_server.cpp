@@ -0,0 +1,156 @@
+#include <set>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include <StateServer.h>
+
+// Remembers what went out instead of sending it anywhere.
+class FakeTransport : public WebSocketTransport {
+  public:
+    struct Sent {
+      std::vector<uint32_t> clientIds;
+      std::string message;
+      bool binary;
+    };
+
+    std::vector<Sent> sent;
+    std::set<uint32_t> busy;
+
+    bool isReady(uint32_t clientId) {
+      return !busy.count(clientId);
+    }
+
+    size_t send(const std::vector<uint32_t>& clientIds, const uint8_t* message, size_t length, bool binary) {
+      sent.push_back({ clientIds, std::string((const char*)message, length), binary });
+      return length * clientIds.size();
+    }
+};
+
+static std::vector<const char*> keys = { "temp_unit", "shelf_temp", "fan_status" };
+
+void setJson(StateServer& stateServer, size_t slot, const char* json) {
+  stateServer.setField(slot, [json](std::string& valueJson, std::string& valueMsgPack) {
+    valueJson = json;
+    // Stands in for whatever it is; these tests only check the JSON.
+    valueMsgPack = "\xc0";
+  });
+}
+
+void test_clients_with_the_same_fields_share_a_message() {
+  FakeTransport transport;
+  StateServer stateServer(&keys, &transport);
+  stateServer.connect(1, WebSocketEncoding::json);
+  stateServer.connect(2, WebSocketEncoding::json);
+  setJson(stateServer, 1, "21.5");
+  stateServer.publish();
+  TEST_ASSERT_EQUAL(1, transport.sent.size());
+  std::vector<uint32_t> expectedIds = { 1, 2 };
+  TEST_ASSERT_TRUE(expectedIds == transport.sent[0].clientIds);
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"stateUpdated\",\"data\":{\"shelf_temp\":21.5}}", transport.sent[0].message.c_str());
+  TEST_ASSERT_FALSE(transport.sent[0].binary);
+  TEST_ASSERT_EQUAL(2 * transport.sent[0].message.size(), stateServer.readChannel(StateServerStat::bytesSent));
+  TEST_ASSERT_EQUAL(2, stateServer.readChannel(StateServerStat::messagesSent));
+}
+
+void test_subscribers_only_get_their_fields() {
+  FakeTransport transport;
+  StateServer stateServer(&keys, &transport);
+  stateServer.connect(1, WebSocketEncoding::json);
+  stateServer.subscribe(1, { "fan_status" }, {});
+  setJson(stateServer, 1, "21.5");
+  stateServer.publish();
+  TEST_ASSERT_EQUAL(0, transport.sent.size());
+  setJson(stateServer, 1, "22");
+  setJson(stateServer, 2, "true");
+  stateServer.publish();
+  TEST_ASSERT_EQUAL(1, transport.sent.size());
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"stateUpdated\",\"data\":{\"fan_status\":true}}", transport.sent[0].message.c_str());
+}
+
+void test_a_busy_client_catches_up_with_the_latest_values() {
+  FakeTransport transport;
+  StateServer stateServer(&keys, &transport);
+  stateServer.connect(1, WebSocketEncoding::json);
+  transport.busy.insert(1);
+  setJson(stateServer, 1, "21.5");
+  stateServer.publish();
+  setJson(stateServer, 1, "22");
+  stateServer.publish();
+  TEST_ASSERT_EQUAL(0, transport.sent.size());
+  TEST_ASSERT_EQUAL(1, stateServer.readChannel(StateServerStat::superseded));
+
+  transport.busy.clear();
+  setJson(stateServer, 2, "false");
+  stateServer.publish();
+  TEST_ASSERT_EQUAL(1, transport.sent.size());
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"stateUpdated\",\"data\":{\"shelf_temp\":22,\"fan_status\":false}}", transport.sent[0].message.c_str());
+}
+
+void test_a_busy_client_catches_up_after_the_state_goes_quiet() {
+  FakeTransport transport;
+  StateServer stateServer(&keys, &transport);
+  stateServer.connect(1, WebSocketEncoding::json);
+  transport.busy.insert(1);
+  setJson(stateServer, 1, "21.5");
+  stateServer.publish();
+  stateServer.run();
+  TEST_ASSERT_EQUAL(0, transport.sent.size());
+
+  // Nothing else changes, but it still gets what it's owed once it's ready.
+  transport.busy.clear();
+  stateServer.run();
+  TEST_ASSERT_EQUAL(1, transport.sent.size());
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"stateUpdated\",\"data\":{\"shelf_temp\":21.5}}", transport.sent[0].message.c_str());
+  // And only once.
+  stateServer.run();
+  TEST_ASSERT_EQUAL(1, transport.sent.size());
+}
+
+void test_msgpack_clients_get_field_ids_then_binary() {
+  FakeTransport transport;
+  StateServer stateServer(&keys, &transport);
+  stateServer.connect(7, WebSocketEncoding::msgpack);
+  TEST_ASSERT_EQUAL(1, transport.sent.size());
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"fieldIds\",\"data\":[\"temp_unit\",\"shelf_temp\",\"fan_status\"]}", transport.sent[0].message.c_str());
+  setJson(stateServer, 0, "\"celsius\"");
+  stateServer.publish();
+  TEST_ASSERT_EQUAL(2, transport.sent.size());
+  TEST_ASSERT_TRUE(transport.sent[1].binary);
+  // [stateUpdated, {0: nil}]
+  std::string expected("\x92\x00\x81\x00\xc0", 5);
+  TEST_ASSERT_TRUE(expected == transport.sent[1].message);
+}
+
+void test_all_state_and_disconnects() {
+  FakeTransport transport;
+  StateServer stateServer(&keys, &transport);
+  setJson(stateServer, 0, "\"celsius\"");
+  setJson(stateServer, 1, "21.5");
+  stateServer.publish();
+  TEST_ASSERT_EQUAL_STRING("{\"temp_unit\":\"celsius\",\"shelf_temp\":21.5}", stateServer.getAllState()->c_str());
+
+  stateServer.connect(1, WebSocketEncoding::json);
+  stateServer.connect(2, WebSocketEncoding::msgpack);
+  TEST_ASSERT_EQUAL(2, stateServer.readChannel(StateServerStat::clients));
+  stateServer.disconnect(1);
+  int clients = 0;
+  stateServer.forEachClient([&clients](uint32_t id, WebSocketEncoding encoding, const ClientOutbox& outbox) {
+    TEST_ASSERT_EQUAL(2, id);
+    TEST_ASSERT_TRUE(encoding == WebSocketEncoding::msgpack);
+    clients ++;
+  });
+  TEST_ASSERT_EQUAL(1, clients);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_clients_with_the_same_fields_share_a_message);
+  RUN_TEST(test_subscribers_only_get_their_fields);
+  RUN_TEST(test_a_busy_client_catches_up_with_the_latest_values);
+  RUN_TEST(test_a_busy_client_catches_up_after_the_state_goes_quiet);
+  RUN_TEST(test_msgpack_clients_get_field_ids_then_binary);
+  RUN_TEST(test_all_state_and_disconnects);
+  UNITY_END();
+}
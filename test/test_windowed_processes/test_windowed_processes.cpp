@@ -0,0 +1,197 @@
+#include <vector>
+
+#include <unity.h>
+
+#include <TickClock.h>
+#include <Timer.h>
+#include <event_stream/EventStream.h>
+#include <event_stream/WindowedProcesses.h>
+
+class CountingListener : public ClockListener {
+  public:
+    std::vector<unsigned long> wakeups;
+
+    virtual void onClockDeadline(unsigned long now) {
+      wakeups.push_back(now);
+    }
+};
+
+// Move the sim clock forward and let the tick clock see it.
+void tickTo(TickClock& clock, unsigned long now) {
+  Timekeeper::setNowSim(now);
+  clock.beforeTick();
+}
+
+void test_tick_clock_reads_once_per_tick() {
+  Timekeeper::setNowSim(0);
+  TickClock clock;
+  tickTo(clock, 5);
+  Timekeeper::tick(10);
+  // Still the time the tick started.
+  TEST_ASSERT_EQUAL(5, clock.nowMillis());
+}
+
+void test_tick_clock_wakes_listeners_when_due() {
+  Timekeeper::setNowSim(0);
+  TickClock clock;
+  CountingListener early;
+  CountingListener late;
+  size_t earlySlot = clock.addListener(&early);
+  size_t lateSlot = clock.addListener(&late);
+  clock.wakeAt(earlySlot, 10);
+  clock.wakeAt(lateSlot, 20);
+  tickTo(clock, 9);
+  TEST_ASSERT_EQUAL(0, early.wakeups.size());
+  tickTo(clock, 15);
+  TEST_ASSERT_EQUAL(1, early.wakeups.size());
+  TEST_ASSERT_EQUAL(15, early.wakeups[0]);
+  TEST_ASSERT_EQUAL(0, late.wakeups.size());
+  // Deadlines are one-shot.
+  tickTo(clock, 25);
+  TEST_ASSERT_EQUAL(1, early.wakeups.size());
+  TEST_ASSERT_EQUAL(1, late.wakeups.size());
+  clock.wakeAt(earlySlot, 30);
+  clock.removeListener(earlySlot);
+  tickTo(clock, 30);
+  TEST_ASSERT_EQUAL(1, early.wakeups.size());
+}
+
+void test_tumbling_window() {
+  Timekeeper::setNowSim(0);
+  TickClock clock;
+  DumbEventStream<int> stream;
+  TumblingWindow<int> window(&stream, 100, &clock);
+  std::vector<WindowAggregate<int>> windows;
+  window.registerSubscriber([&windows](const Event<WindowAggregate<int>>& e) { windows.push_back(e.value); });
+  tickTo(clock, 10);
+  stream.emit(5);
+  tickTo(clock, 50);
+  stream.emit(2);
+  stream.emit(9);
+  tickTo(clock, 99);
+  TEST_ASSERT_EQUAL(0, windows.size());
+  tickTo(clock, 100);
+  TEST_ASSERT_EQUAL(1, windows.size());
+  TEST_ASSERT_EQUAL(0, windows[0].start);
+  TEST_ASSERT_EQUAL(3, windows[0].count);
+  TEST_ASSERT_EQUAL(5, windows[0].first.value());
+  TEST_ASSERT_EQUAL(9, windows[0].last.value());
+  TEST_ASSERT_EQUAL(2, windows[0].min.value());
+  TEST_ASSERT_EQUAL(9, windows[0].max.value());
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, windows[0].ratePerSecond());
+  // Empty windows don't get emitted...
+  tickTo(clock, 350);
+  TEST_ASSERT_EQUAL(1, windows.size());
+  // ...and the ones that were skipped don't throw the grid off.
+  stream.emit(1);
+  tickTo(clock, 400);
+  TEST_ASSERT_EQUAL(2, windows.size());
+  TEST_ASSERT_EQUAL(300, windows[1].start);
+  TEST_ASSERT_EQUAL(1, windows[1].count);
+}
+
+void test_tumbling_window_can_emit_empty_windows() {
+  Timekeeper::setNowSim(0);
+  TickClock clock;
+  DumbEventStream<int> stream;
+  TumblingWindow<int> window(&stream, 100, &clock, true);
+  std::vector<uint32_t> counts;
+  window.registerSubscriber([&counts](const Event<WindowAggregate<int>>& e) { counts.push_back(e.value.count); });
+  tickTo(clock, 100);
+  tickTo(clock, 200);
+  TEST_ASSERT_EQUAL(2, counts.size());
+  TEST_ASSERT_EQUAL(0, counts[0]);
+}
+
+void test_sliding_window() {
+  Timekeeper::setNowSim(0);
+  TickClock clock;
+  DumbEventStream<float> stream;
+  // The last 300 ms, every 100 ms.
+  SlidingWindow<float> window(&stream, 300, 100, &clock);
+  std::vector<WindowAggregate<float>> windows;
+  window.registerSubscriber([&windows](const Event<WindowAggregate<float>>& e) { windows.push_back(e.value); });
+  stream.emit(1.0f);
+  tickTo(clock, 100);
+  stream.emit(3.0f);
+  tickTo(clock, 200);
+  tickTo(clock, 300);
+  TEST_ASSERT_EQUAL(3, windows.size());
+  TEST_ASSERT_EQUAL(0, windows[2].start);
+  TEST_ASSERT_EQUAL(300, windows[2].length);
+  TEST_ASSERT_EQUAL(2, windows[2].count);
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, windows[2].min.value());
+  TEST_ASSERT_EQUAL_FLOAT(3.0f, windows[2].max.value());
+  // The first event slides out.
+  tickTo(clock, 400);
+  TEST_ASSERT_EQUAL(4, windows.size());
+  TEST_ASSERT_EQUAL(100, windows[3].start);
+  TEST_ASSERT_EQUAL(1, windows[3].count);
+  TEST_ASSERT_EQUAL_FLOAT(3.0f, windows[3].first.value());
+  // Then the second one does, and there's nothing left to emit.
+  tickTo(clock, 500);
+  TEST_ASSERT_EQUAL(4, windows.size());
+}
+
+void test_sliding_window_counts_missed_hops() {
+  Timekeeper::setNowSim(0);
+  TickClock clock;
+  DumbEventStream<int> stream;
+  SlidingWindow<int> window(&stream, 300, 100, &clock, true);
+  std::vector<WindowAggregate<int>> windows;
+  window.registerSubscriber([&windows](const Event<WindowAggregate<int>>& e) { windows.push_back(e.value); });
+  stream.emit(1);
+  // The clock doesn't get a look in until well after the first hop.
+  tickTo(clock, 250);
+  TEST_ASSERT_EQUAL(1, windows.size());
+  TEST_ASSERT_EQUAL(0, windows[0].start);
+  TEST_ASSERT_EQUAL(200, windows[0].length);
+  TEST_ASSERT_EQUAL(1, windows[0].count);
+  stream.emit(2);
+  tickTo(clock, 300);
+  TEST_ASSERT_EQUAL(2, windows[1].count);
+  tickTo(clock, 1000);
+  TEST_ASSERT_EQUAL(0, windows[2].count);
+  TEST_ASSERT_EQUAL(700, windows[2].start);
+}
+
+void test_sliding_window_length_must_be_a_multiple_of_hop() {
+  Timekeeper::setNowSim(0);
+  TickClock clock;
+  DumbEventStream<int> stream;
+  bool threw = false;
+  try {
+    SlidingWindow<int> window(&stream, 250, 100, &clock);
+  } catch (std::invalid_argument& e) {
+    threw = true;
+  }
+  TEST_ASSERT_TRUE(threw);
+}
+
+void test_destroyed_windows_unsubscribe() {
+  Timekeeper::setNowSim(0);
+  TickClock clock;
+  DumbEventStream<int> stream;
+  {
+    TumblingWindow<int> tumbling(&stream, 100, &clock);
+    SlidingWindow<int> sliding(&stream, 200, 100, &clock);
+    TEST_ASSERT_EQUAL(2, stream.getSubscriberCount());
+  }
+  TEST_ASSERT_EQUAL(0, stream.getSubscriberCount());
+  // Nothing left to call back into the windows that are gone.
+  stream.emit(1);
+}
+
+int main(int argc, char **argv) {
+  Timekeeper::setSource(TimekeeperSource::simTime);
+  UNITY_BEGIN();
+  RUN_TEST(test_tick_clock_reads_once_per_tick);
+  RUN_TEST(test_tick_clock_wakes_listeners_when_due);
+  RUN_TEST(test_tumbling_window);
+  RUN_TEST(test_tumbling_window_can_emit_empty_windows);
+  RUN_TEST(test_sliding_window);
+  RUN_TEST(test_sliding_window_counts_missed_hops);
+  RUN_TEST(test_sliding_window_length_must_be_a_multiple_of_hop);
+  RUN_TEST(test_destroyed_windows_unsubscribe);
+  UNITY_END();
+}